@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "fpga/assembler-server.h"
+#include "fpga/memory-mapped-file.h"
+
+ABSL_FLAG(std::string, socket, "",
+          "Unix domain socket of the fpga-as --serve daemon.");
+
+ABSL_FLAG(std::string, part, "",
+          R"(FPGA part name, e.g. "xc7a35tcsg324-1". If empty, the daemon
+uses the part it was started with.)");
+
+static inline std::string Usage(std::string_view name) {
+  return absl::StrFormat(R"(usage: %s --socket=<path> [input.fasm] > output.bit
+
+Send fasm to a running "fpga-as --serve" daemon and write the assembled
+bitstream to stdout. Reads stdin if no input file is given.)",
+                         name);
+}
+
+int main(int argc, char *argv[]) {
+  absl::SetProgramUsageMessage(Usage(argv[0]));
+  const std::vector<char *> args = absl::ParseCommandLine(argc, argv);
+  const std::string socket = absl::GetFlag(FLAGS_socket);
+  if (args.size() > 2 || socket.empty()) {
+    std::cerr << absl::ProgramUsageMessage() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::string fasm;
+  if (args.size() == 2 && std::string_view(args[1]) != "-") {
+    const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> input =
+      fpga::MemoryMapFile(std::string_view(args[1]));
+    if (!input.ok()) {
+      std::cerr << absl::StrFormat("cannot open fasm file: %s",
+                                   input.status().message())
+                << '\n';
+      return EXIT_FAILURE;
+    }
+    fasm = std::string(input.value()->AsStringView());
+  } else {
+    fasm.assign(std::istreambuf_iterator<char>(std::cin),
+                std::istreambuf_iterator<char>());
+  }
+
+  const absl::StatusOr<std::string> bitstream =
+    fpga::AssembleRemote(socket, absl::GetFlag(FLAGS_part), fasm);
+  if (!bitstream.ok()) {
+    std::cerr << absl::StrFormat("could not assemble: %s",
+                                 bitstream.status().message())
+              << '\n';
+    return EXIT_FAILURE;
+  }
+  std::cout.write(bitstream->data(), bitstream->size());
+  return std::cout.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,310 @@
+#include "fpga/assembler-server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/time.h"
+#include "fpga/thread-pool.h"
+
+namespace fpga {
+namespace {
+// Upper bounds for frames, to reject garbled lengths early. Part names are
+// short; FASM and bitstreams of the largest parts stay well below 1 GiB.
+constexpr uint64_t kMaxPartFrameSize = 256;
+constexpr uint64_t kMaxFrameSize = uint64_t(1) << 30;
+
+// Frame payloads are read in chunks of this size, so memory is only
+// allocated for data that actually arrived, not for the length claimed.
+constexpr uint64_t kReadChunkSize = uint64_t(1) << 20;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Don't get killed by SIGPIPE if the peer went away.
+void DisableSigPipe(int fd) {
+#ifdef SO_NOSIGPIPE
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+// Make reads on "fd" fail once nothing arrived for "timeout".
+void SetReceiveTimeout(int fd, absl::Duration timeout) {
+  const timeval tv = absl::ToTimeval(timeout);
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+absl::Status WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const ssize_t written = send(fd, data.data(), data.size(), kSendFlags);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return absl::ErrnoToStatus(errno, "socket write");
+    }
+    data.remove_prefix(written);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadAll(int fd, char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t r = read(fd, data, size);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return absl::DeadlineExceededError("socket read timed out");
+      }
+      return absl::ErrnoToStatus(errno, "socket read");
+    }
+    if (r == 0) {
+      return absl::UnavailableError("connection closed");
+    }
+    data += r;
+    size -= r;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status WriteFrame(int fd, std::string_view payload) {
+  char header[8];
+  uint64_t size = payload.size();
+  for (char &c : header) {
+    c = static_cast<char>(size & 0xff);
+    size >>= 8;
+  }
+  const absl::Status status = WriteAll(fd, std::string_view(header, 8));
+  if (!status.ok()) {
+    return status;
+  }
+  return WriteAll(fd, payload);
+}
+
+// Read a frame of at most "max_size" bytes.
+absl::StatusOr<std::string> ReadFrame(int fd, uint64_t max_size) {
+  char header[8];
+  const absl::Status status = ReadAll(fd, header, sizeof(header));
+  if (!status.ok()) {
+    return status;
+  }
+  uint64_t size = 0;
+  for (int i = 7; i >= 0; --i) {
+    size = (size << 8) | static_cast<uint8_t>(header[i]);
+  }
+  if (size > max_size) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+      "frame of %u bytes exceeds limit of %u", size, max_size));
+  }
+  std::string payload;
+  while (payload.size() < size) {
+    const size_t offset = payload.size();
+    const size_t chunk = std::min(size - offset, kReadChunkSize);
+    payload.resize(offset + chunk);
+    const absl::Status chunk_status =
+      ReadAll(fd, payload.data() + offset, chunk);
+    if (!chunk_status.ok()) {
+      return chunk_status;
+    }
+  }
+  return payload;
+}
+
+absl::StatusOr<sockaddr_un> SocketAddress(std::string_view socket_path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("invalid socket path \"%s\"", socket_path));
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  return address;
+}
+}  // namespace
+
+AssemblerServer::AssemblerServer(std::string socket_path, int listen_fd,
+                                 int stop_read_fd, int stop_write_fd,
+                                 AssembleHandler handler, int threads,
+                                 absl::Duration receive_timeout)
+    : socket_path_(std::move(socket_path)),
+      listen_fd_(listen_fd),
+      stop_read_fd_(stop_read_fd),
+      stop_write_fd_(stop_write_fd),
+      handler_(std::move(handler)),
+      receive_timeout_(receive_timeout),
+      pool_(threads) {}
+
+AssemblerServer::~AssemblerServer() {
+  pool_.Wait();
+  close(listen_fd_);
+  close(stop_read_fd_);
+  close(stop_write_fd_);
+  unlink(socket_path_.c_str());
+}
+
+absl::StatusOr<std::unique_ptr<AssemblerServer>> AssemblerServer::Create(
+  std::string_view socket_path, AssembleHandler handler, int threads,
+  absl::Duration receive_timeout) {
+  const absl::StatusOr<sockaddr_un> address = SocketAddress(socket_path);
+  if (!address.ok()) {
+    return address.status();
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "socket");
+  }
+  // Replace a socket left behind by a previous server.
+  unlink(address->sun_path);
+  if (bind(fd, reinterpret_cast<const sockaddr *>(&address.value()),
+           sizeof(sockaddr_un)) != 0 ||
+      listen(fd, 16) != 0) {
+    const int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(
+      error, absl::StrFormat("cannot listen on \"%s\"", socket_path));
+  }
+  int stop_pipe[2];
+  if (pipe(stop_pipe) != 0) {
+    const int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(error, "pipe");
+  }
+  return std::unique_ptr<AssemblerServer>(new AssemblerServer(
+    std::string(socket_path), fd, stop_pipe[0], stop_pipe[1],
+    std::move(handler), threads, receive_timeout));
+}
+
+absl::Status AssemblerServer::Serve() {
+  for (;;) {
+    pollfd fds[2] = {
+      {.fd = listen_fd_, .events = POLLIN, .revents = 0},
+      {.fd = stop_read_fd_, .events = POLLIN, .revents = 0},
+    };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      return absl::ErrnoToStatus(errno, "poll");
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+    if (fds[0].revents == 0) {
+      continue;
+    }
+    const int connection = accept(listen_fd_, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return absl::ErrnoToStatus(errno, "accept");
+    }
+    DisableSigPipe(connection);
+    SetReceiveTimeout(connection, receive_timeout_);
+    pool_.Schedule([this, connection] {
+      HandleConnection(connection);
+      close(connection);
+    });
+  }
+  pool_.Wait();
+  return absl::OkStatus();
+}
+
+void AssemblerServer::Stop() {
+  const char c = 0;
+  while (write(stop_write_fd_, &c, 1) < 0 && errno == EINTR) {
+  }
+}
+
+void AssemblerServer::HandleConnection(int fd) {
+  const absl::StatusOr<std::string> part = ReadFrame(fd, kMaxPartFrameSize);
+  if (!part.ok()) {
+    return;
+  }
+  const absl::StatusOr<std::string> fasm = ReadFrame(fd, kMaxFrameSize);
+  if (!fasm.ok()) {
+    return;
+  }
+  const absl::StatusOr<std::string> bitstream = handler_(*part, *fasm);
+  const absl::Status status = bitstream.status();
+  if (!WriteFrame(fd, absl::StrFormat("%d", static_cast<int>(status.code())))
+         .ok()) {
+    return;
+  }
+  if (status.ok()) {
+    WriteFrame(fd, *bitstream).IgnoreError();
+  } else {
+    WriteFrame(fd, status.message()).IgnoreError();
+  }
+}
+
+namespace {
+absl::StatusOr<std::string> Exchange(int fd, std::string_view part,
+                                     std::string_view fasm) {
+  absl::Status status = WriteFrame(fd, part);
+  if (!status.ok()) {
+    return status;
+  }
+  status = WriteFrame(fd, fasm);
+  if (!status.ok()) {
+    return status;
+  }
+  const absl::StatusOr<std::string> code_frame = ReadFrame(fd, kMaxFrameSize);
+  if (!code_frame.ok()) {
+    return code_frame.status();
+  }
+  int code;
+  if (!absl::SimpleAtoi(*code_frame, &code)) {
+    return absl::InternalError("invalid response from server");
+  }
+  absl::StatusOr<std::string> payload = ReadFrame(fd, kMaxFrameSize);
+  if (!payload.ok()) {
+    return payload.status();
+  }
+  if (code != static_cast<int>(absl::StatusCode::kOk)) {
+    return absl::Status(static_cast<absl::StatusCode>(code), *payload);
+  }
+  return payload;
+}
+}  // namespace
+
+absl::StatusOr<std::string> AssembleRemote(std::string_view socket_path,
+                                           std::string_view part,
+                                           std::string_view fasm) {
+  const absl::StatusOr<sockaddr_un> address = SocketAddress(socket_path);
+  if (!address.ok()) {
+    return address.status();
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "socket");
+  }
+  DisableSigPipe(fd);
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&address.value()),
+              sizeof(sockaddr_un)) != 0) {
+    const int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(
+      error, absl::StrFormat("cannot connect to \"%s\"", socket_path));
+  }
+  absl::StatusOr<std::string> result = Exchange(fd, part, fasm);
+  close(fd);
+  return result;
+}
+}  // namespace fpga
@@ -0,0 +1,75 @@
+#ifndef FPGA_ASSEMBLER_SERVER_H
+#define FPGA_ASSEMBLER_SERVER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "fpga/thread-pool.h"
+
+namespace fpga {
+// Simple protocol to request assembly of FASM content over a local Unix
+// domain socket. One request per connection.
+//
+// Every message is a sequence of frames; a frame is a 64 bit little endian
+// length followed by that many bytes.
+//  - Request: part name frame of at most 256 bytes, FASM content frame of
+//    at most 1 GiB.
+//  - Response: status code frame (absl::StatusCode as decimal number), then
+//    the bitstream frame if the code is OK or the error message otherwise.
+
+// Produces the bitstream for "fasm" content assembled for "part".
+using AssembleHandler = std::function<absl::StatusOr<std::string>(
+  std::string_view part, std::string_view fasm)>;
+
+class AssemblerServer {
+ public:
+  // Create a server listening on "socket_path"; a stale socket file at that
+  // path is replaced. Requests are handled by "handler" on "threads" workers,
+  // so the handler needs to be thread-safe if there is more than one.
+  // A client that sends nothing for "receive_timeout" while its request is
+  // read is disconnected, so it cannot keep a worker forever.
+  static absl::StatusOr<std::unique_ptr<AssemblerServer>> Create(
+    std::string_view socket_path, AssembleHandler handler, int threads,
+    absl::Duration receive_timeout = absl::Seconds(30));
+  ~AssemblerServer();
+
+  AssemblerServer(const AssemblerServer &) = delete;
+  AssemblerServer &operator=(const AssemblerServer &) = delete;
+
+  // Accept and handle connections until Stop() is called.
+  absl::Status Serve();
+
+  // Make Serve() return once requests in flight are done. Can be called from
+  // any thread.
+  void Stop();
+
+ private:
+  AssemblerServer(std::string socket_path, int listen_fd, int stop_read_fd,
+                  int stop_write_fd, AssembleHandler handler, int threads,
+                  absl::Duration receive_timeout);
+
+  void HandleConnection(int fd);
+
+  const std::string socket_path_;
+  const int listen_fd_;
+  // Self-pipe to wake up Serve() from Stop().
+  const int stop_read_fd_;
+  const int stop_write_fd_;
+  const AssembleHandler handler_;
+  const absl::Duration receive_timeout_;
+  ThreadPool pool_;
+};
+
+// Send "fasm" to the server listening at "socket_path" to be assembled for
+// "part" and return the bitstream. Errors reported by the server are
+// returned with their original status code.
+absl::StatusOr<std::string> AssembleRemote(std::string_view socket_path,
+                                           std::string_view part,
+                                           std::string_view fasm);
+}  // namespace fpga
+#endif  // FPGA_ASSEMBLER_SERVER_H
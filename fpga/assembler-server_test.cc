@@ -0,0 +1,177 @@
+#include "fpga/assembler-server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+std::string TestSocketPath(std::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name, ".", getpid(), ".sock");
+}
+
+class AssemblerServerTest : public testing::Test {
+ protected:
+  void StartServer(std::string_view name, AssembleHandler handler,
+                   int threads = 2,
+                   absl::Duration receive_timeout = absl::Seconds(30)) {
+    socket_path_ = TestSocketPath(name);
+    absl::StatusOr<std::unique_ptr<AssemblerServer>> server =
+      AssemblerServer::Create(socket_path_, std::move(handler), threads,
+                              receive_timeout);
+    ASSERT_TRUE(server.ok()) << server.status();
+    server_ = std::move(server.value());
+    serve_thread_ = std::thread([this] { EXPECT_TRUE(server_->Serve().ok()); });
+  }
+
+  void TearDown() override {
+    if (server_) {
+      server_->Stop();
+      serve_thread_.join();
+    }
+  }
+
+  std::string socket_path_;
+  std::unique_ptr<AssemblerServer> server_;
+  std::thread serve_thread_;
+};
+
+TEST_F(AssemblerServerTest, ReturnsHandlerResult) {
+  StartServer("result",
+              [](std::string_view part,
+                 std::string_view fasm) -> absl::StatusOr<std::string> {
+                return absl::StrCat(part, ":", fasm);
+              });
+  const absl::StatusOr<std::string> result =
+    AssembleRemote(socket_path_, "xc7a35tcsg324-1", "CLBLL_L_X2Y0.A\n");
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, "xc7a35tcsg324-1:CLBLL_L_X2Y0.A\n");
+}
+
+TEST_F(AssemblerServerTest, BinaryAndEmptyPayloads) {
+  StartServer("binary",
+              [](std::string_view part,
+                 std::string_view fasm) -> absl::StatusOr<std::string> {
+                return std::string(fasm);
+              });
+  const std::string binary("\0\xff\x01\n\0", 5);
+  absl::StatusOr<std::string> result = AssembleRemote(socket_path_, "", binary);
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, binary);
+
+  const std::string large(1 << 20, 'x');
+  result = AssembleRemote(socket_path_, "part", large);
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, large);
+
+  result = AssembleRemote(socket_path_, "part", "");
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, "");
+}
+
+TEST_F(AssemblerServerTest, PropagatesErrorStatus) {
+  StartServer("error",
+              [](std::string_view part,
+                 std::string_view fasm) -> absl::StatusOr<std::string> {
+                return absl::NotFoundError(absl::StrCat("unknown part ", part));
+              });
+  const absl::StatusOr<std::string> result =
+    AssembleRemote(socket_path_, "nonexistent", "");
+  ASSERT_FALSE(result.ok());
+  EXPECT_EQ(result.status().code(), absl::StatusCode::kNotFound);
+  EXPECT_EQ(result.status().message(), "unknown part nonexistent");
+}
+
+TEST_F(AssemblerServerTest, HandlesManyClients) {
+  std::atomic<int> requests = 0;
+  StartServer("many",
+              [&requests](std::string_view part,
+                          std::string_view fasm) -> absl::StatusOr<std::string> {
+                ++requests;
+                return std::string(fasm);
+              });
+  std::thread clients[8];
+  for (int i = 0; i < 8; ++i) {
+    clients[i] = std::thread([this, i] {
+      const std::string fasm = absl::StrCat("FEATURE_", i);
+      const absl::StatusOr<std::string> result =
+        AssembleRemote(socket_path_, "part", fasm);
+      ASSERT_TRUE(result.ok()) << result.status();
+      EXPECT_EQ(*result, fasm);
+    });
+  }
+  for (std::thread &client : clients) {
+    client.join();
+  }
+  EXPECT_EQ(requests, 8);
+}
+
+TEST_F(AssemblerServerTest, DisconnectsClientsThatSendNothing) {
+  StartServer(
+    "idle",
+    [](std::string_view part,
+       std::string_view fasm) -> absl::StatusOr<std::string> {
+      return std::string(fasm);
+    },
+    /*threads=*/1, /*receive_timeout=*/absl::Milliseconds(100));
+  // Takes the only worker without ever sending a request.
+  const int idle = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(idle, 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, socket_path_.data(), socket_path_.size());
+  ASSERT_EQ(connect(idle, reinterpret_cast<const sockaddr *>(&address),
+                    sizeof(address)),
+            0);
+
+  const absl::StatusOr<std::string> result =
+    AssembleRemote(socket_path_, "part", "FEATURE");
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, "FEATURE");
+  char c;
+  EXPECT_EQ(read(idle, &c, 1), 0);
+  close(idle);
+}
+
+TEST_F(AssemblerServerTest, RejectsOverlongPartName) {
+  std::atomic<int> requests = 0;
+  StartServer("overlong-part",
+              [&requests](std::string_view part,
+                          std::string_view fasm) -> absl::StatusOr<std::string> {
+                ++requests;
+                return std::string(fasm);
+              });
+  const absl::StatusOr<std::string> result =
+    AssembleRemote(socket_path_, std::string(1000, 'x'), "FEATURE");
+  EXPECT_FALSE(result.ok());
+  EXPECT_EQ(requests, 0);
+  // Requests within the limits are still served.
+  EXPECT_TRUE(AssembleRemote(socket_path_, "part", "FEATURE").ok());
+}
+
+TEST(AssemblerServer, ConnectWithoutServerFails) {
+  const absl::StatusOr<std::string> result =
+    AssembleRemote(TestSocketPath("nobody"), "part", "");
+  EXPECT_FALSE(result.ok());
+}
+
+TEST(AssemblerServer, RejectsOverlongSocketPath) {
+  const absl::StatusOr<std::unique_ptr<AssemblerServer>> server =
+    AssemblerServer::Create(std::string(200, 'x'), {}, 1);
+  EXPECT_EQ(server.status().code(), absl::StatusCode::kInvalidArgument);
+}
+}  // namespace
+}  // namespace fpga
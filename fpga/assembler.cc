@@ -1,18 +1,27 @@
 #include <sys/types.h>
 
+#include <algorithm>
 #include <array>
-#include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <optional>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/cleanup/cleanup.h"
+#include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
@@ -20,54 +29,82 @@
 #include "absl/flags/usage.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "fpga/assembler-server.h"
 #include "fpga/database-parsers.h"
+#include "fpga/database-snapshot.h"
 #include "fpga/database.h"
+#include "fpga/fasm-parallel-parser.h"
 #include "fpga/fasm-parser.h"
+#include "fpga/feature-index.h"
+#include "fpga/incremental-state.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/memory-mapped-file.h"
+#include "fpga/region-of-interest.h"
+#include "fpga/symbol-table.h"
+#include "fpga/thread-pool.h"
 #include "fpga/xilinx/arch-types.h"
+#include "fpga/xilinx/bitstream-reader.h"
 #include "fpga/xilinx/bitstream.h"
+#include "fpga/xilinx/configuration.h"
+#include "fpga/xilinx/dense-frames.h"
 
 struct TileSiteInfo {
   std::string tile;
   std::string site;
 };
 
-bool FindPUDCBTileSite(const fpga::TileGrid &tilegrid, TileSiteInfo &info) {
-  for (const auto &p : tilegrid) {
-    const std::string &tile = p.first;
-    const fpga::Tile &tileinfo = p.second;
-    int y_coord;
-    for (const auto &functions_kv : tileinfo.pin_functions) {
-      const std::string &site = functions_kv.first;
-      const std::string &pin_function = functions_kv.second;
-      if (absl::StrContains(pin_function, "PUDC_B")) {
-        // https://github.com/chipsalliance/
-        // f4pga-xc-fasm/blob/25dc605c9c0896204f0c3425b52a332034cf5e5c/xc_fasm/fasm2frames.py#L100
-        const std::string value = std::to_string(site[site.size() - 1]);
-        if (!absl::SimpleAtoi(value, &y_coord)) {
-          return false;
+bool FindPUDCBTileSite(const fpga::LazyTileGrid &tilegrid,
+                       TileSiteInfo &info) {
+  bool found = false;
+  bool ok = true;
+  // Only the tiles mentioning it need to be decoded. Tiles that cannot be
+  // decoded are reported when their features are resolved.
+  const absl::Status decoded = tilegrid.ForEachMentioning(
+    "PUDC_B", [&](const std::string &tile, const fpga::Tile &tileinfo) {
+      if (found) {
+        return;
+      }
+      int y_coord;
+      for (const auto &functions_kv : tileinfo.pin_functions) {
+        const std::string_view site = functions_kv.first.str();
+        const std::string_view pin_function = functions_kv.second.str();
+        if (absl::StrContains(pin_function, "PUDC_B")) {
+          // https://github.com/chipsalliance/
+          // f4pga-xc-fasm/blob/25dc605c9c0896204f0c3425b52a332034cf5e5c/xc_fasm/fasm2frames.py#L100
+          const std::string value = std::to_string(site[site.size() - 1]);
+          found = true;
+          if (!absl::SimpleAtoi(value, &y_coord)) {
+            ok = false;
+            return;
+          }
+          info = TileSiteInfo{
+            .tile = tile,
+            .site = absl::StrFormat("IOB_Y%d", y_coord % 2),
+          };
+          return;
         }
-        info = TileSiteInfo{
-          .tile = tile,
-          .site = absl::StrFormat("IOB_Y%d", y_coord % 2),
-        };
-        return true;
       }
-    }
-  }
-  return false;
+    });
+  decoded.IgnoreError();
+  return found && ok;
 }
 
-std::vector<std::string> GetIOBSites(const fpga::TileGrid &grid,
-                                     const std::string &tile_name) {
+std::vector<std::string> GetIOBSites(const fpga::LazyTileGrid &grid,
+                                     fpga::TileId tile_id) {
   std::vector<std::string> out;
-  const fpga::Tile &tile = grid.at(tile_name);
+  const fpga::Tile &tile = grid.tile(tile_id);
   uint32_t site_y;
   for (const auto &site_pair : tile.sites) {
-    const std::string_view site_name = site_pair.first;
+    const std::string_view site_name = site_pair.first.str();
     const std::string site_y_value =
       std::to_string(site_name[site_name.size() - 1]);
     CHECK(absl::SimpleAtoi(site_y_value, &site_y));
@@ -76,6 +113,10 @@ std::vector<std::string> GetIOBSites(const fpga::TileGrid &grid,
   return out;
 }
 
+using DenseFrames =
+  fpga::xilinx::DenseFrames<fpga::xilinx::Architecture::kXC7>;
+using FrameAddress = DenseFrames::FrameAddress;
+
 struct FasmFeature {
   int64_t line;
   std::string name;
@@ -89,62 +130,155 @@ struct TileGridInfoAndSegbits {
   fpga::Bits bits;
 };
 
+// Receives the frame bits of resolved features and writes them to frames.
+class DenseFramesSink {
+ public:
+  explicit DenseFramesSink(DenseFrames &frames) : frames_(frames) {}
+
+  void Touch(uint32_t address) { frames_.Touch(FrameAddress(address)); }
+  void SetBit(uint32_t address, uint32_t word, uint32_t index) {
+    frames_.Touch(FrameAddress(address))[word] |= (1 << index);
+  }
+
+ private:
+  DenseFrames &frames_;
+};
+
+// Resolve the frame bits of a single feature into "sink", which provides
+// Touch(address) to mark a frame as used and SetBit(address, word, index).
+template <typename FrameSink>
+static absl::Status ResolveFasmFeature(std::string_view feature_name,
+                                       int start_bit, int width, uint64_t bits,
+                                       fpga::PartDatabase &db,
+                                       FrameSink &sink) {
+  // Get first segment of feature name. That's the tile name.
+  // The rest is the feature of that specific tile. For instance:
+  //  [tile name   ] [feature          ][e, s] [value ]
+  //  CLBLM_R_X33Y38.SLICEM_X0.ALUT.INIT[31:0]=32'b11111111111111110000000000000000
+  std::vector<std::string> tile_feature_segments =
+    absl::StrSplit(feature_name, absl::MaxSplits('.', 1));
+  if (tile_feature_segments.size() != 2) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("cannot split feature name %s", feature_name));
+  }
+  const std::string &tile_name = tile_feature_segments[0];
+  const std::string &feature = tile_feature_segments[1];
+  // The tile name is only hashed here, the tile id is used from now on.
+  const fpga::LazyTileGrid &grid = db.tiles().grid;
+  const std::optional<fpga::TileId> tile = grid.FindId(tile_name);
+  if (!tile.has_value()) {
+    // Only an error if the feature would set bits in it.
+    if (bits == 0) {
+      return absl::OkStatus();
+    }
+    return absl::InvalidArgumentError(
+      absl::StrFormat("unknown tile %s", tile_name));
+  }
+  // Tiles are decoded on first use, so this is where a malformed one shows.
+  if (absl::Status status = grid.status(*tile); !status.ok()) {
+    return status;
+  }
+  absl::flat_hash_set<fpga::ConfigBusType> used_config_buses;
+  // Select only bit addresses with value bit set to 1.
+  for (int addr = 0; addr < width; ++addr) {
+    const unsigned feature_addr = (addr + start_bit);
+    const bool value = bits & (uint64_t(1) << addr);
+    if (value) {
+      db.ConfigBits(
+        *tile, feature, feature_addr,
+        [&sink, &used_config_buses](
+          fpga::ConfigBusType bus, uint32_t address,
+          const fpga::PartDatabase::FrameBit &bit, bool value) {
+          // Update the list of tile segbits buses used.
+          // So we can use it later on to mark all the frames that have been
+          // used.
+          used_config_buses.insert(bus);
+
+          // Mark the frame at address as used and enable the right bit.
+          if (value) {
+            sink.SetBit(address, bit.word, bit.index);
+          } else {
+            sink.Touch(address);
+          }
+        });
+    }
+  }
+  if (used_config_buses.empty()) {
+    return absl::OkStatus();
+  }
+  // Get tilegrid info.
+  const fpga::Tile &tile_info = grid.tile(*tile);
+  for (const auto &bus : used_config_buses) {
+    const fpga::BitsBlock &info = tile_info.bits.at(bus);
+    for (unsigned i = 0; i < info.frames; ++i) {
+      sink.Touch(info.base_address + i);
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Set the frame bits of a single feature.
+static absl::Status ProcessFasmFeature(std::string_view feature_name,
+                                       int start_bit, int width, uint64_t bits,
+                                       fpga::PartDatabase &db,
+                                       DenseFrames &frames) {
+  DenseFramesSink sink(frames);
+  return ResolveFasmFeature(feature_name, start_bit, width, bits, db, sink);
+}
+
 static absl::Status ProcessFasmFeatures(
   const std::vector<FasmFeature> &features, fpga::PartDatabase &db,
-  fpga::Frames &frames) {
+  DenseFrames &frames) {
   for (const auto &tile_feature : features) {
-    // Get first segment of feature name. That's the tile name.
-    // The rest is the feature of that specific tile. For instance:
-    //  [tile name   ] [feature          ][e, s] [value ]
-    //  CLBLM_R_X33Y38.SLICEM_X0.ALUT.INIT[31:0]=32'b11111111111111110000000000000000
-    std::vector<std::string> tile_feature_segments =
-      absl::StrSplit(tile_feature.name, absl::MaxSplits('.', 1));
-    if (tile_feature_segments.size() != 2) {
-      return absl::InvalidArgumentError(
-        absl::StrFormat("cannot split feature name %s", tile_feature.name));
-    }
-    const std::string tile_name = tile_feature_segments[0];
-    const std::string feature = tile_feature_segments[1];
-    const uint64_t bits = tile_feature.bits;
-    absl::flat_hash_set<fpga::ConfigBusType> used_config_buses;
-    // Select only bit addresses with value bit set to 1.
-    for (int addr = 0; addr < tile_feature.width; ++addr) {
-      const unsigned feature_addr = (addr + tile_feature.start_bit);
-      const bool value = bits & (uint64_t(1) << addr);
-      if (value) {
-        db.ConfigBits(
-          tile_name, feature, feature_addr,
-          [&frames, &used_config_buses](
-            fpga::ConfigBusType bus, uint32_t address,
-            const fpga::PartDatabase::FrameBit &bit, bool value) {
-            // Update the list of tile segbits buses used.
-            // So we can use it later on to mark all the frames that have been
-            // used.
-            used_config_buses.insert(bus);
-
-            // Insert the frames at address and enable the right bit.
-            if (!frames.contains(address)) {
-              frames.insert({address, {}});
-            }
-            if (value) {
-              std::array<fpga::word_t, fpga::kFrameWordCount> &frame =
-                frames[address];
-              frame[bit.word] |= (1 << bit.index);
-            }
-          });
-      }
-    }
-    if (used_config_buses.empty()) {
-      continue;
+    const absl::Status status =
+      ProcessFasmFeature(tile_feature.name, tile_feature.start_bit,
+                         tile_feature.width, tile_feature.bits, db, frames);
+    if (!status.ok()) {
+      return status;
     }
-    // Get tilegrid info.
-    const fpga::Tile &tile_info = db.tiles().grid.at(tile_name);
-    for (const auto &bus : used_config_buses) {
-      const fpga::BitsBlock &info = tile_info.bits.at(bus);
-      for (unsigned i = 0; i < info.frames; ++i) {
-        frames.insert({info.base_address + i, {}});
+  }
+  return absl::OkStatus();
+}
+
+// Same as above, but the features are resolved concurrently on "pool".
+// Each worker resolves a contiguous slice of the features into its own frame
+// shard; the shards are OR-ed into "frames" at the end. As resolving a
+// feature only ever sets bits, the result is the same as resolving all
+// features in order. Errors are reported for the first failing feature.
+static absl::Status ProcessFasmFeatures(
+  const std::vector<FasmFeature> &features, fpga::PartDatabase &db,
+  DenseFrames &frames, fpga::ThreadPool &pool) {
+  const size_t shard_count =
+    std::min(static_cast<size_t>(pool.size()), features.size());
+  if (shard_count <= 1) {
+    return ProcessFasmFeatures(features, db, frames);
+  }
+  std::vector<DenseFrames> shards;
+  shards.reserve(shard_count);
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards.push_back(frames.EmptyCopy());
+  }
+  std::vector<absl::Status> statuses(shard_count);
+  pool.ParallelFor(shard_count, [&](size_t shard) {
+    const size_t begin = features.size() * shard / shard_count;
+    const size_t end = features.size() * (shard + 1) / shard_count;
+    for (size_t i = begin; i < end; ++i) {
+      const FasmFeature &feature = features[i];
+      statuses[shard] =
+        ProcessFasmFeature(feature.name, feature.start_bit, feature.width,
+                           feature.bits, db, shards[shard]);
+      if (!statuses[shard].ok()) {
+        return;
       }
     }
+  });
+  for (const absl::Status &status : statuses) {
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  for (const DenseFrames &shard : shards) {
+    frames.MergeFrom(shard);
   }
   return absl::OkStatus();
 }
@@ -157,7 +291,7 @@ constexpr std::string_view kPUDCBPullUpFASMLinesTemplate[] = {
   "%s.%s.PULLTYPE.PULLUP",
 };
 
-bool AddPUDCBFeatures(const fpga::TileGrid &tilegrid,
+bool AddPUDCBFeatures(const fpga::LazyTileGrid &tilegrid,
                       std::vector<FasmFeature> &features) {
   TileSiteInfo info;
   if (!FindPUDCBTileSite(tilegrid, info)) {
@@ -183,114 +317,420 @@ bool AddPUDCBFeatures(const fpga::TileGrid &tilegrid,
   return true;
 }
 
-static void AddStepDownFeatures(const fpga::BanksTilesRegistry &banks,
-                                const fpga::TileGrid &grid,
-                                std::vector<FasmFeature> &features) {
-  // Stores a set of strings <tile-type>.<site>
-  absl::flat_hash_set<std::string> used_iob_sites;
-  absl::flat_hash_map<uint32_t, absl::flat_hash_set<std::string>>
-    stepdown_banks_tags;
-  for (const auto &feature : features) {
-    if (feature.bits == 0) {
-      continue;
+// Keeps track of what is needed to derive the step-down features: the
+// IOB33 sites in use and the STEPDOWN tags per bank. Nothing else about the
+// observed features is retained.
+class StepDownFeaturesCollector {
+ public:
+  StepDownFeaturesCollector(const fpga::BanksTilesRegistry &banks,
+                            const fpga::LazyTileGrid &grid)
+      : banks_(banks), grid_(grid) {}
+
+  void Observe(std::string_view feature_name, uint64_t bits) {
+    if (bits == 0) {
+      return;
     }
-    std::vector<std::string> tile_feature_segments =
-      absl::StrSplit(feature.name, absl::MaxSplits('.', 3));
+    std::vector<std::string_view> tile_feature_segments =
+      absl::StrSplit(feature_name, absl::MaxSplits('.', 3));
     if (tile_feature_segments.size() < 3) {
-      continue;
+      return;
     }
     const std::string_view tile = tile_feature_segments[0];
     const std::string_view site = tile_feature_segments[1];
     const std::string_view tag = tile_feature_segments[2];
-    if (absl::StrContains(tile, "IOB33")) {
-      used_iob_sites.insert(absl::StrFormat("%s.%s", tile, site));
+    const bool iob = absl::StrContains(tile, "IOB33");
+    const bool stepdown = absl::StrContains(tag, "STEPDOWN");
+    if (!iob && !stepdown) {
+      return;
+    }
+    const std::optional<fpga::TileId> tile_id = grid_.FindId(tile);
+    if (!tile_id.has_value()) {
+      return;
+    }
+    if (iob) {
+      used_iob_sites_.emplace(*tile_id, site);
     }
 
-    if (absl::StrContains(tag, "STEPDOWN")) {
-      const std::vector<uint32_t> bank_values =
-        banks.TileBanks(std::string(tile));
+    if (stepdown) {
+      const std::vector<uint32_t> bank_values = banks_.TileBanks(*tile_id);
       CHECK(!bank_values.empty());
       const uint32_t bank = bank_values.front();
-      if (!stepdown_banks_tags.contains(bank)) {
-        stepdown_banks_tags.insert({bank, {}});
-      }
-      stepdown_banks_tags.at(bank).insert(std::string(tag));
+      stepdown_banks_tags_[bank].insert(std::string(tag));
     }
   }
 
-  for (const auto &bank_tags_pair : stepdown_banks_tags) {
-    const uint32_t &bank = bank_tags_pair.first;
-    const absl::flat_hash_set<std::string> &tags = bank_tags_pair.second;
-    const auto maybe_tiles = banks.Tiles(bank);
-    CHECK(maybe_tiles.has_value());
-    for (const auto &tile : maybe_tiles.value()) {
-      if (absl::StrContains(tile, "IOB33")) {
-        for (const auto &site : GetIOBSites(grid, tile)) {
-          const std::string tile_site = absl::StrFormat("%s.%s", tile, site);
-          if (used_iob_sites.contains(tile_site)) {
-            continue;
-          }
-          for (const auto &tag : tags) {
-            const FasmFeature feature = {
-              .line = -1,
-              .name = absl::StrFormat("%s.%s", tile_site, tag),
-              .start_bit = 0,
-              .width = 1,
-              .bits = 1,
-            };
-            features.push_back(feature);
+  // Append the features implied by the observed STEPDOWN tags.
+  void AddStepDownFeatures(std::vector<FasmFeature> &features) const {
+    for (const auto &bank_tags_pair : stepdown_banks_tags_) {
+      const uint32_t &bank = bank_tags_pair.first;
+      const absl::flat_hash_set<std::string> &tags = bank_tags_pair.second;
+      const auto maybe_tiles = banks_.Tiles(bank);
+      CHECK(maybe_tiles.has_value());
+      for (const fpga::TileId tile_id : maybe_tiles.value()) {
+        const std::string &tile = grid_.name(tile_id);
+        if (absl::StrContains(tile, "IOB33")) {
+          for (const auto &site : GetIOBSites(grid_, tile_id)) {
+            if (used_iob_sites_.contains(std::make_pair(tile_id, site))) {
+              continue;
+            }
+            const std::string tile_site = absl::StrFormat("%s.%s", tile, site);
+            for (const auto &tag : tags) {
+              const FasmFeature feature = {
+                .line = -1,
+                .name = absl::StrFormat("%s.%s", tile_site, tag),
+                .start_bit = 0,
+                .width = 1,
+                .bits = 1,
+              };
+              features.push_back(feature);
+            }
           }
         }
-      }
 
-      if (absl::StrContains(tile, "HCLK_IOI3")) {
-        const FasmFeature feature = {
-          .line = -1,
-          .name = absl::StrFormat("%s.STEPDOWN", tile),
-          .start_bit = 0,
-          .width = 1,
-          .bits = 1,
-        };
-        features.push_back(feature);
+        if (absl::StrContains(tile, "HCLK_IOI3")) {
+          const FasmFeature feature = {
+            .line = -1,
+            .name = absl::StrFormat("%s.STEPDOWN", tile),
+            .start_bit = 0,
+            .width = 1,
+            .bits = 1,
+          };
+          features.push_back(feature);
+        }
       }
     }
   }
+
+ private:
+  const fpga::BanksTilesRegistry &banks_;
+  const fpga::LazyTileGrid &grid_;
+  // Stores a set of <tile>, <site> pairs.
+  absl::flat_hash_set<std::pair<fpga::TileId, std::string>> used_iob_sites_;
+  absl::flat_hash_map<uint32_t, absl::flat_hash_set<std::string>>
+    stepdown_banks_tags_;
+};
+
+static void AddStepDownFeatures(const fpga::BanksTilesRegistry &banks,
+                                const fpga::LazyTileGrid &grid,
+                                std::vector<FasmFeature> &features) {
+  StepDownFeaturesCollector collector(banks, grid);
+  for (const auto &feature : features) {
+    collector.Observe(feature.name, feature.bits);
+  }
+  collector.AddStepDownFeatures(features);
+}
+
+// Drop the features that do not set bits in the frames of "roi", if any.
+static void FilterFeatures(const fpga::RegionFrames *roi,
+                           std::vector<FasmFeature> &features) {
+  if (roi == nullptr) {
+    return;
+  }
+  std::erase_if(features, [roi](const FasmFeature &feature) {
+    return !roi->ContainsFeature(feature.name);
+  });
+}
+
+// Resolves features into frames as soon as they are handed over instead of
+// collecting them first, so memory use does not grow with the input size.
+// Only the step-down bookkeeping is kept until Finish().
+// If "roi" is given, features not setting bits in its frames are skipped.
+class StreamingAssembler {
+ public:
+  StreamingAssembler(fpga::PartDatabase &db, DenseFrames &frames,
+                     const fpga::RegionFrames *roi = nullptr)
+      : db_(db),
+        frames_(frames),
+        roi_(roi),
+        stepdown_(db.tiles().banks, db.tiles().grid) {}
+
+  // Resolve feature. Returns false if it failed; see status().
+  bool AddFeature(std::string_view feature_name, int start_bit, int width,
+                  uint64_t bits) {
+    // Step-down features depend on the IO standards of the whole bank, so
+    // features outside of the region still count.
+    stepdown_.Observe(feature_name, bits);
+    if (roi_ != nullptr && !roi_->ContainsFeature(feature_name)) {
+      return true;
+    }
+    status_ =
+      ProcessFasmFeature(feature_name, start_bit, width, bits, db_, frames_);
+    return status_.ok();
+  }
+
+  // Resolve the step-down features implied by all features added so far.
+  absl::Status Finish() {
+    std::vector<FasmFeature> features;
+    stepdown_.AddStepDownFeatures(features);
+    FilterFeatures(roi_, features);
+    return ProcessFasmFeatures(features, db_, frames_);
+  }
+
+  const absl::Status &status() const { return status_; }
+
+ private:
+  fpga::PartDatabase &db_;
+  DenseFrames &frames_;
+  const fpga::RegionFrames *roi_;
+  StepDownFeaturesCollector stepdown_;
+  absl::Status status_;
+};
+
+// Load the segbits of the tiles of "features" on "pool" upfront, instead of
+// one tile type at a time when its first feature is resolved.
+static void PrefetchSegbits(const std::vector<FasmFeature> &features,
+                            fpga::PartDatabase &db, fpga::ThreadPool &pool) {
+  const fpga::LazyTileGrid &grid = db.tiles().grid;
+  absl::flat_hash_set<fpga::TileId> tiles;
+  for (const FasmFeature &feature : features) {
+    const std::optional<fpga::TileId> tile = grid.FindId(
+      std::string_view(feature.name).substr(0, feature.name.find('.')));
+    if (tile.has_value()) {
+      tiles.insert(*tile);
+    }
+  }
+  db.PrefetchSegbits(tiles, pool);
+}
+
+// Resolve "features" and the step-down features they imply with "threads"
+// workers, skipping those not setting bits in the frames of "roi" if given.
+static absl::Status AssembleFeatures(std::vector<FasmFeature> &features,
+                                     int threads, fpga::PartDatabase &db,
+                                     DenseFrames &frames,
+                                     const fpga::RegionFrames *roi) {
+  AddStepDownFeatures(db.tiles().banks, db.tiles().grid, features);
+  FilterFeatures(roi, features);
+  fpga::ThreadPool pool(threads);
+  PrefetchSegbits(features, db, pool);
+  if (threads <= 1) {
+    return ProcessFasmFeatures(features, db, frames);
+  }
+  return ProcessFasmFeatures(features, db, frames, pool);
+}
+
+static absl::Status ParseResultToStatus(fasm::ParseResult result,
+                                        const StreamingAssembler &assembler) {
+  if (!assembler.status().ok()) {
+    return assembler.status();
+  }
+  if (result == fasm::ParseResult::kUserAbort ||
+      result == fasm::ParseResult::kError) {
+    return absl::InternalError("internal error");
+  }
+  return absl::OkStatus();
 }
 
-static absl::Status AssembleFrames(FILE *input_stream, fpga::PartDatabase &db,
-                                   fpga::Frames &frames) {
-  // For now store everything in here.
+// Start the streaming assembly with the features always required.
+static absl::Status AddRequiredFeatures(StreamingAssembler &assembler,
+                                        fpga::PartDatabase &db) {
   std::vector<FasmFeature> features;
   // TODO: add required features.
-  // TODO: add roi.
   AddPUDCBFeatures(db.tiles().grid, features);
+  for (const FasmFeature &feature : features) {
+    if (!assembler.AddFeature(feature.name, feature.start_bit, feature.width,
+                              feature.bits)) {
+      return assembler.status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Resolve the features of "input_stream" with "threads" workers. With a single
+// thread, features are resolved while reading.
+static absl::Status AssembleFrames(FILE *input_stream, int threads,
+                                   fpga::PartDatabase &db, DenseFrames &frames,
+                                   const fpga::RegionFrames *roi = nullptr) {
+  StreamingAssembler assembler(db, frames, roi);
+  std::vector<FasmFeature> features;
+  absl::Status status;
+  if (threads <= 1) {
+    status = AddRequiredFeatures(assembler, db);
+    if (!status.ok()) {
+      return status;
+    }
+  } else {
+    AddPUDCBFeatures(db.tiles().grid, features);
+  }
 
   // Parse fasm.
   size_t buf_size = 8192;
   char *buffer = (char *)malloc(buf_size);
   const absl::Cleanup buffer_freer = [&buffer] { free(buffer); };
   ssize_t read_count;
+  uint32_t line_number = 1;
   // NOLINTNEXTLINE(misc-include-cleaner)
   while ((read_count = getline(&buffer, &buf_size, input_stream)) > 0) {
     const std::string_view content(buffer, read_count);
     const fasm::ParseResult result = fasm::Parse(
       content, stderr,
-      [&features](uint32_t line, std::string_view feature_name, int start_bit,
-                  int width, uint64_t bits) -> bool {
+      [&](uint32_t line, std::string_view feature_name, int start_bit,
+          int width, uint64_t bits) -> bool {
+        if (threads <= 1) {
+          return assembler.AddFeature(feature_name, start_bit, width, bits);
+        }
         features.push_back(
           FasmFeature{line, std::string(feature_name), start_bit, width, bits});
         return true;
       },
       [](uint32_t, std::string_view, std::string_view name,
-         std::string_view value) {});
+         std::string_view value) {},
+      line_number++);
+    status = ParseResultToStatus(result, assembler);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  if (threads <= 1) {
+    return assembler.Finish();
+  }
+  return AssembleFeatures(features, threads, db, frames, roi);
+}
 
-    if (result == fasm::ParseResult::kUserAbort ||
-        result == fasm::ParseResult::kError) {
-      return absl::InternalError("internal error");
+// Chunks handed out to each parsing thread; a few per thread so that a chunk
+// with long lines does not keep everyone else waiting.
+constexpr size_t kFasmChunksPerThread = 4;
+
+// Same as above, but "content" holds the whole fasm file.
+// With more than one parse thread, it is split in newline-aligned chunks
+// parsed concurrently by "parse_threads" workers. The features are collected
+// and merged in chunk order, so their order does not depend on the number of
+// threads.
+static absl::Status AssembleFrames(std::string_view content, int parse_threads,
+                                   int threads, fpga::PartDatabase &db,
+                                   DenseFrames &frames,
+                                   const fpga::RegionFrames *roi = nullptr) {
+  if (parse_threads <= 1 && threads <= 1) {
+    StreamingAssembler assembler(db, frames, roi);
+    const absl::Status status = AddRequiredFeatures(assembler, db);
+    if (!status.ok()) {
+      return status;
+    }
+    const fasm::ParseResult result = fasm::Parse(
+      content, stderr,
+      [&assembler](uint32_t, std::string_view feature_name, int start_bit,
+                   int width, uint64_t bits) -> bool {
+        return assembler.AddFeature(feature_name, start_bit, width, bits);
+      });
+    const absl::Status parse_status = ParseResultToStatus(result, assembler);
+    if (!parse_status.ok()) {
+      return parse_status;
     }
+    return assembler.Finish();
+  }
+
+  std::vector<FasmFeature> features;
+  AddPUDCBFeatures(db.tiles().grid, features);
+
+  fpga::ThreadPool pool(parse_threads);
+  const std::vector<fpga::FasmChunk> chunks =
+    fpga::SplitFasmChunks(content, pool.size() * kFasmChunksPerThread, pool);
+  std::vector<std::vector<FasmFeature>> chunks_features(chunks.size());
+  const fasm::ParseResult result = fpga::ParseFasmChunks(
+    chunks, pool, stderr,
+    [&chunks_features](size_t chunk, uint32_t line,
+                       std::string_view feature_name, int start_bit, int width,
+                       uint64_t bits) -> bool {
+      chunks_features[chunk].push_back(
+        FasmFeature{line, std::string(feature_name), start_bit, width, bits});
+      return true;
+    });
+  if (result == fasm::ParseResult::kUserAbort ||
+      result == fasm::ParseResult::kError) {
+    return absl::InternalError("internal error");
+  }
+  for (std::vector<FasmFeature> &chunk_features : chunks_features) {
+    std::move(chunk_features.begin(), chunk_features.end(),
+              std::back_inserter(features));
+  }
+  return AssembleFeatures(features, threads, db, frames, roi);
+}
+
+// Assemble "content" into "frames" reusing the contributions in "state" of
+// the features seen in the previous run; only features that are new are
+// resolved through the database, and only the frames touched by features
+// added or removed since are updated in "state". Afterwards, "state" holds
+// the contributions of exactly the features of "content" setting bits in the
+// frames of "roi", if given.
+static absl::Status AssembleIncrementally(std::string_view content,
+                                          fpga::PartDatabase &db,
+                                          fpga::IncrementalState &state,
+                                          DenseFrames &frames,
+                                          const fpga::RegionFrames *roi) {
+  std::vector<FasmFeature> features;
+  AddPUDCBFeatures(db.tiles().grid, features);
+  const fasm::ParseResult result = fasm::Parse(
+    content, stderr,
+    [&features](uint32_t line, std::string_view feature_name, int start_bit,
+                int width, uint64_t bits) -> bool {
+      features.push_back(
+        FasmFeature{line, std::string(feature_name), start_bit, width, bits});
+      return true;
+    });
+  if (result == fasm::ParseResult::kUserAbort ||
+      result == fasm::ParseResult::kError) {
+    return absl::InternalError("internal error");
   }
   AddStepDownFeatures(db.tiles().banks, db.tiles().grid, features);
-  return ProcessFasmFeatures(features, db, frames);
+  FilterFeatures(roi, features);
+
+  absl::flat_hash_set<std::string> keys;
+  keys.reserve(features.size());
+  for (const FasmFeature &feature : features) {
+    std::string key = fpga::FeatureKey(feature.name, feature.start_bit,
+                                       feature.width, feature.bits);
+    if (!keys.insert(key).second || state.Find(key) != nullptr) {
+      continue;  // Repeated, or resolved in a previous run.
+    }
+    fpga::FeatureContribution contribution;
+    const absl::Status status =
+      ResolveFasmFeature(feature.name, feature.start_bit, feature.width,
+                         feature.bits, db, contribution);
+    if (!status.ok()) {
+      return status;
+    }
+    contribution.Finalize();
+    state.Add(std::move(key), std::move(contribution));
+  }
+  state.Retain(keys);
+
+  for (const auto &[address, words] : state.frames()) {
+    DenseFrames::FrameWords &frame = frames.Touch(FrameAddress(address));
+    for (size_t i = 0; i < words.size() && i < frame.size(); ++i) {
+      frame[i] |= words[i];
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Incremental assembly with the state kept in the file "state_path", which
+// is created if missing. A state of another database or part, one whose
+// "sources" changed since, or one that cannot be read, is discarded.
+static absl::Status AssembleIncrementally(
+  std::string_view content, const std::string &state_path,
+  const std::string &fingerprint, const std::vector<std::string> &sources,
+  fpga::PartDatabase &db, DenseFrames &frames,
+  const fpga::RegionFrames *roi) {
+  absl::StatusOr<fpga::IncrementalState> state =
+    fpga::IncrementalState::Load(state_path, fingerprint);
+  if (!state.ok()) {
+    if (std::filesystem::exists(state_path)) {
+      std::cerr << absl::StrFormat("discarding incremental state: %s\n",
+                                   state.status().message());
+    }
+    absl::StatusOr<std::vector<fpga::SnapshotSource>> stat_sources =
+      fpga::StatSnapshotSources(sources);
+    if (!stat_sources.ok()) {
+      return stat_sources.status();
+    }
+    state = fpga::IncrementalState(fingerprint,
+                                   std::move(stat_sources.value()));
+  }
+  const absl::Status status =
+    AssembleIncrementally(content, db, state.value(), frames, roi);
+  if (!status.ok()) {
+    return status;
+  }
+  return state->Save(state_path);
 }
 
 ABSL_FLAG(
@@ -300,6 +740,66 @@ If not present, it must be provided via PRJXRAY_DB_PATH.)");
 
 ABSL_FLAG(std::string, part, "", R"(FPGA part name, e.g. "xc7a35tcsg324-1".)");
 
+ABSL_FLAG(int, parse_threads, 1,
+          R"(Number of threads parsing the fasm input. Only applies when the
+input is given as a file, which is then memory mapped and split in chunks.)");
+
+ABSL_FLAG(int, threads, 1,
+          R"(Number of threads resolving the fasm features into frames.
+The output does not depend on the number of threads. In --batch mode, the
+number of jobs run concurrently.)");
+
+ABSL_FLAG(std::string, batch, "",
+          R"(Manifest file with one "<input.fasm> <output.bit>" pair per line
+(empty lines and lines starting with '#' are ignored). All pairs are
+assembled with the database loaded once, instead of a single fasm input.)");
+
+ABSL_FLAG(std::string, serve, "",
+          R"(Run as daemon listening on this Unix domain socket path, assembling
+the fasm sent by fpga-as-client. The database of --part, if given, is loaded
+upfront, other parts on their first request. Requests are handled by --threads
+workers.)");
+
+ABSL_FLAG(std::string, incremental, "",
+          R"(State file to reassemble incrementally. The frame bits of every
+feature are stored in it, so that the next run only needs to resolve the
+features that changed. Created if missing; discarded if the database or
+--feature_index changed since.)");
+
+ABSL_FLAG(std::string, base, "",
+          R"(Bitstream the device is currently configured with. If given, a
+partial bitstream is written that only contains the frames that differ from
+it.)");
+
+ABSL_FLAG(std::string, compile_index, "",
+          R"(Compile the feature index of --part to this file and exit. It maps
+every feature of every tile to the frame bits it sets, see --feature_index.)");
+
+ABSL_FLAG(std::string, feature_index, "",
+          R"(Feature index compiled with --compile_index for the same database
+and part. Features found in it are resolved with a single lookup. It is
+rejected once any of the database files it was compiled from changed.)");
+
+ABSL_FLAG(std::string, roi, "",
+          R"(Region of interest, either "tiles:X<x>Y<y>:X<x>Y<y>" or
+"clock_regions:X<x>Y<y>:X<x>Y<y>", the opposite corners of a rectangle. If
+given, a partial bitstream with only the frames of the region is written,
+assembled from the features setting bits in these frames. Frames span whole
+clock region rows, so this includes tiles above and below the region. Not
+available with --batch or --serve.)");
+
+ABSL_FLAG(std::string, roi_buses, "",
+          R"(Comma separated configuration buses of the frames of --roi, e.g.
+"CLB_IO_CLK,BLOCK_RAM". All buses if empty.)");
+
+ABSL_FLAG(std::string, cache_dir, "",
+          R"(Directory to keep binary snapshots of parsed part databases in.
+A snapshot is rebuilt whenever a database file it was derived from changes.)");
+
+ABSL_FLAG(bool, verify_cache, false,
+          R"(Verify the checksum of the snapshots read from --cache_dir, which
+reads them whole instead of only the parts that are used.)");
+
 static inline std::string Usage(std::string_view name) {
   return absl::StrFormat(R"(usage: %s [options] < input.fasm > output.bit
 
@@ -314,6 +814,406 @@ static std::string StatusToErrorMessage(std::string_view message,
   return absl::StrFormat("%s: %s", message, status.message());
 }
 
+// Identifies the database and part that persisted data was derived from.
+static std::string DatabaseFingerprint(
+  const std::filesystem::path &prjxray_db_path, std::string_view part) {
+  return absl::StrFormat(
+    "%s\n%s", std::filesystem::absolute(prjxray_db_path).string(), part);
+}
+
+// Parse the database of "part", through a snapshot in --cache_dir if set.
+static absl::StatusOr<fpga::PartDatabase> ParseDatabase(
+  const std::filesystem::path &prjxray_db_path, std::string_view part) {
+  const std::filesystem::path cache_dir = absl::GetFlag(FLAGS_cache_dir);
+  if (cache_dir.empty()) {
+    return fpga::PartDatabase::Parse(prjxray_db_path.string(), part);
+  }
+  std::error_code error;
+  std::filesystem::create_directories(cache_dir, error);
+  if (error) {
+    return absl::InternalError(absl::StrFormat(
+      "cannot create \"%s\": %s", cache_dir.string(), error.message()));
+  }
+  // Several databases may share a cache directory.
+  const std::string snapshot_name = absl::StrFormat(
+    "%s-%016x.snapshot", part,
+    std::hash<std::string>()(
+      std::filesystem::absolute(prjxray_db_path).string()));
+  return fpga::PartDatabase::ParseWithSnapshot(
+    prjxray_db_path.string(), part, (cache_dir / snapshot_name).string(),
+    absl::GetFlag(FLAGS_verify_cache));
+}
+
+// Resolve every feature of the part and write them as feature index to
+// "index_path".
+static absl::Status CompileFeatureIndex(fpga::PartDatabase &db,
+                                        const std::string &index_path,
+                                        const std::string &fingerprint) {
+  fpga::FeatureIndexBuilder builder;
+  db.ForEachFeatureBits([&builder](const std::string &tile_name,
+                                   const std::string &feature,
+                                   uint32_t address,
+                                   const std::vector<fpga::IndexedBit> &bits) {
+    builder.Add(tile_name, feature, address, bits);
+  });
+  // The index is only valid as long as the database files it was resolved
+  // from are unchanged.
+  const absl::StatusOr<std::vector<fpga::SnapshotSource>> sources =
+    fpga::StatSnapshotSources(db.sources());
+  if (!sources.ok()) {
+    return sources.status();
+  }
+  const absl::Status status =
+    builder.Write(index_path, fingerprint, sources.value());
+  if (!status.ok()) {
+    return status;
+  }
+  std::cerr << absl::StrFormat("feature index: %d feature addresses\n",
+                               builder.size());
+  return absl::OkStatus();
+}
+
+static absl::Status WriteBitstream(const DenseFrames &frames,
+                                   std::ostream &out) {
+  return fpga::xilinx::BitStream<fpga::xilinx::Architecture::kXC7>::Encode(
+    frames, "fasm", "fpga-source", out);
+}
+
+// Write a partial bitstream with only the frames in "roi_frames", if given,
+// that differ from the bitstream in the file "base_path", if not empty.
+static absl::Status WritePartialBitstream(
+  const DenseFrames &frames, std::string_view base_path,
+  const absl::btree_set<uint32_t> *roi_frames, std::ostream &out) {
+  constexpr fpga::xilinx::Architecture kArch =
+    fpga::xilinx::Architecture::kXC7;
+  using BitStream = fpga::xilinx::BitStream<kArch>;
+  const auto in_roi = [roi_frames](FrameAddress address) {
+    return roi_frames == nullptr ||
+           roi_frames->contains(static_cast<uint32_t>(address));
+  };
+  absl::StatusOr<size_t> selected_frames;
+  if (base_path.empty()) {
+    selected_frames = BitStream::EncodeSelected(
+      frames,
+      [&in_roi](FrameAddress address, const DenseFrames::FrameWords &) {
+        return in_roi(address);
+      },
+      "fasm", "fpga-source", out);
+    if (!selected_frames.ok()) {
+      return selected_frames.status();
+    }
+    std::cerr << absl::StrFormat("partial bitstream: %d of %d frames\n",
+                                 selected_frames.value(),
+                                 frames.frame_count());
+    return absl::OkStatus();
+  }
+  const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> base_content =
+    fpga::MemoryMapFile(base_path);
+  if (!base_content.ok()) {
+    return base_content.status();
+  }
+  auto reader = fpga::xilinx::BitstreamReader<kArch>::InitWithBytes(
+    base_content.value()->AsBytesView());
+  if (!reader.has_value()) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("\"%s\" is not a bitstream", base_path));
+  }
+  const auto base = fpga::xilinx::Configuration<kArch>::InitWithPackets(
+    frames.part(), reader.value());
+  if (!base.has_value()) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("\"%s\" is not a bitstream for this part", base_path));
+  }
+  selected_frames = BitStream::EncodeSelected(
+    frames,
+    [&](FrameAddress address, const DenseFrames::FrameWords &words) {
+      return in_roi(address) &&
+             BitStream::FrameDiffers(base.value(), address, words);
+    },
+    "fasm", "fpga-source", out);
+  if (!selected_frames.ok()) {
+    return selected_frames.status();
+  }
+  std::cerr << absl::StrFormat("partial bitstream: %d of %d frames changed\n",
+                               selected_frames.value(), frames.frame_count());
+  return absl::OkStatus();
+}
+
+struct BatchJob {
+  std::string input;
+  std::string output;
+};
+
+// Parse the batch manifest with one "<input> <output>" pair per line.
+static absl::StatusOr<std::vector<BatchJob>> ParseBatchManifest(
+  std::string_view content) {
+  std::vector<BatchJob> jobs;
+  int line_number = 0;
+  for (const std::string_view line : absl::StrSplit(content, '\n')) {
+    ++line_number;
+    const std::string_view stripped = absl::StripAsciiWhitespace(line);
+    if (stripped.empty() || stripped.front() == '#') {
+      continue;
+    }
+    const std::vector<std::string_view> fields =
+      absl::StrSplit(stripped, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    if (fields.size() != 2) {
+      return absl::InvalidArgumentError(
+        absl::StrFormat("manifest line %d: expected \"<input.fasm> "
+                        "<output.bit>\", got \"%s\"",
+                        line_number, stripped));
+    }
+    jobs.push_back({std::string(fields[0]), std::string(fields[1])});
+  }
+  return jobs;
+}
+
+// Assemble a single batch job into "frames", which are expected to be empty.
+static absl::Status RunBatchJob(const BatchJob &job, fpga::PartDatabase &db,
+                                DenseFrames &frames) {
+  const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> input =
+    fpga::MemoryMapFile(std::string_view(job.input));
+  if (!input.ok()) {
+    return input.status();
+  }
+  absl::Status status = AssembleFrames(input.value()->AsStringView(),
+                                       /*parse_threads=*/1, /*threads=*/1, db,
+                                       frames);
+  if (!status.ok()) {
+    return status;
+  }
+  std::ofstream out(job.output, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot open output file \"%s\"", job.output));
+  }
+  status = WriteBitstream(frames, out);
+  if (!status.ok()) {
+    return status;
+  }
+  out.close();
+  if (out.fail()) {
+    return absl::InternalError(
+      absl::StrFormat("failed writing \"%s\"", job.output));
+  }
+  return absl::OkStatus();
+}
+
+// Resolved features kept by --batch and --serve for the next designs. Designs
+// for the same part share most of their features, so a small fraction of
+// those of the device is enough.
+constexpr size_t kResolutionCacheEntries = 1 << 18;
+
+// Assemble all jobs of the "manifest" file, running "threads" jobs at a time.
+// All jobs share the database, so its segbits are only loaded once and
+// resolved features are reused across jobs.
+// Returns the number of jobs that failed.
+static absl::StatusOr<int> RunBatch(std::string_view manifest, int threads,
+                                    fpga::PartDatabase &db,
+                                    const DenseFrames &empty_frames) {
+  const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> manifest_content =
+    fpga::MemoryMapFile(manifest);
+  if (!manifest_content.ok()) {
+    return manifest_content.status();
+  }
+  const absl::StatusOr<std::vector<BatchJob>> jobs =
+    ParseBatchManifest(manifest_content.value()->AsStringView());
+  if (!jobs.ok()) {
+    return jobs.status();
+  }
+
+  struct JobResult {
+    absl::Status status;
+    absl::Duration duration;
+  };
+  std::vector<JobResult> results(jobs->size());
+  db.EnableResolutionCache(kResolutionCacheEntries);
+  const absl::Time start = absl::Now();
+  {
+    fpga::ThreadPool pool(threads);
+    pool.ParallelFor(jobs->size(), [&](size_t i) {
+      const absl::Time job_start = absl::Now();
+      DenseFrames frames = empty_frames.EmptyCopy();
+      results[i].status = RunBatchJob((*jobs)[i], db, frames);
+      results[i].duration = absl::Now() - job_start;
+    });
+  }
+  const absl::Duration wall_time = absl::Now() - start;
+
+  int failed = 0;
+  absl::Duration total_job_time;
+  for (size_t i = 0; i < jobs->size(); ++i) {
+    const BatchJob &job = (*jobs)[i];
+    const JobResult &result = results[i];
+    total_job_time += result.duration;
+    if (result.status.ok()) {
+      std::cerr << absl::StrFormat("%s -> %s: ok (%s)\n", job.input,
+                                   job.output,
+                                   absl::FormatDuration(result.duration));
+    } else {
+      ++failed;
+      std::cerr << absl::StrFormat("%s -> %s: %s (%s)\n", job.input,
+                                   job.output, result.status.message(),
+                                   absl::FormatDuration(result.duration));
+    }
+  }
+  std::cerr << absl::StrFormat(
+    "%d jobs, %d failed; wall time %s, job time %s (avg %s) with %d threads\n",
+    jobs->size(), failed, absl::FormatDuration(wall_time),
+    absl::FormatDuration(total_job_time),
+    absl::FormatDuration(jobs->empty() ? absl::ZeroDuration()
+                                       : total_job_time / jobs->size()),
+    threads);
+  const fpga::PartDatabase::ResolutionCacheStats cache_stats =
+    db.resolution_cache_stats();
+  std::cerr << absl::StrFormat("resolution cache: %d hits, %d misses\n",
+                               cache_stats.hits, cache_stats.misses);
+  return failed;
+}
+
+// Database of a part kept loaded by the --serve daemon.
+struct LoadedPart {
+  fpga::PartDatabase db;
+  DenseFrames empty_frames;
+};
+
+static absl::StatusOr<std::unique_ptr<LoadedPart>> LoadPart(
+  const std::string &prjxray_db_path, std::string_view part) {
+  absl::StatusOr<fpga::PartDatabase> db = ParseDatabase(prjxray_db_path, part);
+  if (!db.ok()) {
+    return db.status();
+  }
+  absl::StatusOr<DenseFrames::Part> xilinx_part =
+    DenseFrames::Part::FromPart(db->tiles().part);
+  if (!xilinx_part.ok()) {
+    return xilinx_part.status();
+  }
+  db->PreloadSegbits();
+  db->EnableResolutionCache(kResolutionCacheEntries);
+  return std::unique_ptr<LoadedPart>(new LoadedPart{
+    std::move(db.value()), DenseFrames(std::move(xilinx_part.value()))});
+}
+
+// Most parts the --serve daemon keeps loaded, as each takes a lot of memory.
+constexpr size_t kMaxServedParts = 8;
+
+// Part names of requests become a directory of the database, so only names
+// of the part directories in it are accepted.
+static absl::Status CheckPartName(const std::string &prjxray_db_path,
+                                  std::string_view part) {
+  if (part.empty() || part == "." || part == ".." ||
+      part.find('/') != std::string_view::npos ||
+      part.find('\0') != std::string_view::npos) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("invalid part name \"%s\"", part));
+  }
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(
+        std::filesystem::path(prjxray_db_path) / part / "part.json", error)) {
+    return absl::NotFoundError(
+      absl::StrFormat("part \"%s\" not in the database", part));
+  }
+  return absl::OkStatus();
+}
+
+// Parts of the --serve daemon, loaded on first use and kept until exit. A part
+// that fails to load is not kept, so the next request for it tries again.
+class LoadedParts {
+ public:
+  explicit LoadedParts(std::string prjxray_db_path)
+      : prjxray_db_path_(std::move(prjxray_db_path)) {}
+
+  // Concurrent requests for a part that is being loaded wait for it instead
+  // of loading it again. The lock is not held while loading, so requests for
+  // parts already loaded are not held up by a load. Fails once
+  // kMaxServedParts are loaded.
+  absl::StatusOr<LoadedPart *> Get(std::string_view part) {
+    if (absl::Status status = CheckPartName(prjxray_db_path_, part);
+        !status.ok()) {
+      return status;
+    }
+    const std::string name(part);
+    {
+      const absl::MutexLock lock(&mu_);
+      while (loading_.contains(name)) {
+        loaded_.Wait(&mu_);
+      }
+      if (const auto found = parts_.find(name); found != parts_.end()) {
+        return found->second.get();
+      }
+      if (parts_.size() + loading_.size() >= kMaxServedParts) {
+        return absl::ResourceExhaustedError(absl::StrFormat(
+          "cannot load \"%s\", already serving %d parts", name,
+          kMaxServedParts));
+      }
+      loading_.insert(name);
+    }
+    absl::StatusOr<std::unique_ptr<LoadedPart>> loaded =
+      LoadPart(prjxray_db_path_, name);
+    const absl::MutexLock lock(&mu_);
+    loading_.erase(name);
+    loaded_.SignalAll();
+    if (!loaded.ok()) {
+      return loaded.status();
+    }
+    LoadedPart *const result = loaded->get();
+    parts_.emplace(name, std::move(loaded.value()));
+    return result;
+  }
+
+ private:
+  const std::string prjxray_db_path_;
+  absl::Mutex mu_;
+  // Signaled whenever a part is done loading, successfully or not.
+  absl::CondVar loaded_;
+  absl::flat_hash_set<std::string> loading_ ABSL_GUARDED_BY(mu_);
+  // Parts are never removed, so they can be used without the lock.
+  absl::flat_hash_map<std::string, std::unique_ptr<LoadedPart>> parts_
+    ABSL_GUARDED_BY(mu_);
+};
+
+// Serve assembly requests on "socket_path" until killed. Requests without
+// part name are assembled for "default_part".
+static absl::Status Serve(std::string_view socket_path,
+                          const std::string &prjxray_db_path,
+                          const std::string &default_part, int threads) {
+  LoadedParts parts(prjxray_db_path);
+  if (!default_part.empty()) {
+    const absl::StatusOr<LoadedPart *> preloaded = parts.Get(default_part);
+    if (!preloaded.ok()) {
+      return preloaded.status();
+    }
+  }
+  const auto handler =
+    [&](std::string_view part,
+        std::string_view fasm) -> absl::StatusOr<std::string> {
+    const absl::StatusOr<LoadedPart *> loaded =
+      parts.Get(part.empty() ? std::string_view(default_part) : part);
+    if (!loaded.ok()) {
+      return loaded.status();
+    }
+    DenseFrames frames = (*loaded)->empty_frames.EmptyCopy();
+    absl::Status status = AssembleFrames(fasm, /*parse_threads=*/1,
+                                         /*threads=*/1, (*loaded)->db, frames);
+    if (!status.ok()) {
+      return status;
+    }
+    std::ostringstream bitstream;
+    status = WriteBitstream(frames, bitstream);
+    if (!status.ok()) {
+      return status;
+    }
+    return std::move(bitstream).str();
+  };
+  absl::StatusOr<std::unique_ptr<fpga::AssemblerServer>> server =
+    fpga::AssemblerServer::Create(socket_path, handler, threads);
+  if (!server.ok()) {
+    return server.status();
+  }
+  std::cerr << absl::StrFormat("listening on %s\n", socket_path);
+  return server.value()->Serve();
+}
+
 static absl::StatusOr<std::string> GetOptFlagOrFromEnv(
   const absl::Flag<std::optional<std::string>> &flag, const char *env_var) {
   const std::optional<std::string> flag_value = absl::GetFlag(flag);
@@ -358,17 +1258,17 @@ static void GetFrameLine(
   out << "\n";
 }
 
-static void PrintFrames(const fpga::Frames &frames, std::ostream &out,
+static void PrintFrames(const DenseFrames &frames, std::ostream &out,
                         bool pretty) {
-  for (const auto &frame : frames) {
-    const uint32_t &address = frame.first;
-    const std::array<fpga::word_t, fpga::kFrameWordCount> &bits = frame.second;
+  frames.ForEachFrame([&](FrameAddress frame_address,
+                          const DenseFrames::FrameWords &bits) {
+    const uint32_t address = static_cast<uint32_t>(frame_address);
     if (pretty) {
       GetPrettyFrameLine(address, bits, out);
     } else {
       GetFrameLine(address, bits, out);
     }
-  }
+  });
 }
 #endif
 
@@ -399,49 +1299,157 @@ int main(int argc, char *argv[]) {
   }
 
   const std::string part = absl::GetFlag(FLAGS_part);
+  const std::string serve_socket = absl::GetFlag(FLAGS_serve);
+  const std::string roi_region = absl::GetFlag(FLAGS_roi);
+  if (!roi_region.empty() &&
+      (!serve_socket.empty() || !absl::GetFlag(FLAGS_batch).empty())) {
+    std::cerr << "--roi cannot be combined with --serve or --batch" << '\n';
+    return EXIT_FAILURE;
+  }
+  if (!serve_socket.empty()) {
+    const absl::Status status =
+      Serve(serve_socket, prjxray_db_path.string(), part,
+            absl::GetFlag(FLAGS_threads));
+    if (!status.ok()) {
+      std::cerr << StatusToErrorMessage("serve failed", status) << '\n';
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
   if (part.empty()) {
     std::cerr << "no part provided" << '\n';
     std::cerr << absl::ProgramUsageMessage() << '\n';
     return EXIT_FAILURE;
   }
-  auto part_database_result =
-    fpga::PartDatabase::Parse(prjxray_db_path.string(), part);
+  auto part_database_result = ParseDatabase(prjxray_db_path, part);
   if (!part_database_result.ok()) {
     std::cerr << StatusToErrorMessage("part mapping parsing",
                                       part_database_result.status())
               << '\n';
     return EXIT_FAILURE;
   }
-  FILE *input_stream = stdin;
-  const absl::Cleanup file_closer = [input_stream] {
-    if (input_stream != stdin) {
-      std::fclose(input_stream);
+  const std::string index_path = absl::GetFlag(FLAGS_compile_index);
+  if (!index_path.empty()) {
+    const absl::Status status =
+      CompileFeatureIndex(part_database_result.value(), index_path,
+                          DatabaseFingerprint(prjxray_db_path, part));
+    if (!status.ok()) {
+      std::cerr << StatusToErrorMessage("could not compile feature index",
+                                        status)
+                << '\n';
+      return EXIT_FAILURE;
     }
-  };
-  if (args_count == 2) {
-    const std::string_view arg(args[1]);
-    if (arg != "-") {
-      input_stream = std::fopen(args[1], "r");
-      if (input_stream == nullptr) {
-        std::cerr << absl::ErrnoToStatus(errno, "cannot open fasm file")
+    return EXIT_SUCCESS;
+  }
+  const std::string feature_index_path = absl::GetFlag(FLAGS_feature_index);
+  if (!feature_index_path.empty()) {
+    absl::StatusOr<fpga::FeatureIndex> index = fpga::FeatureIndex::Open(
+      feature_index_path, DatabaseFingerprint(prjxray_db_path, part));
+    if (!index.ok()) {
+      std::cerr << StatusToErrorMessage("invalid feature index",
+                                        index.status())
+                << '\n';
+      return EXIT_FAILURE;
+    }
+    part_database_result->UseFeatureIndex(
+      std::make_shared<const fpga::FeatureIndex>(std::move(index.value())));
+  }
+  const fpga::Part &part_data = part_database_result->tiles().part;
+  absl::StatusOr<DenseFrames::Part> xilinx_part =
+    DenseFrames::Part::FromPart(part_data);
+  if (!xilinx_part.ok()) {
+    std::cerr << StatusToErrorMessage("invalid part", xilinx_part.status())
+              << '\n';
+    return EXIT_FAILURE;
+  }
+  DenseFrames frames(std::move(xilinx_part.value()));
+
+  const std::string batch_manifest = absl::GetFlag(FLAGS_batch);
+  if (!batch_manifest.empty()) {
+    const absl::StatusOr<int> failed =
+      RunBatch(batch_manifest, absl::GetFlag(FLAGS_threads),
+               part_database_result.value(), frames);
+    if (!failed.ok()) {
+      std::cerr << StatusToErrorMessage("batch failed", failed.status())
+                << '\n';
+      return EXIT_FAILURE;
+    }
+    return failed.value() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  std::optional<fpga::RegionFrames> roi;
+  if (!roi_region.empty()) {
+    const absl::StatusOr<fpga::RegionOfInterest> region =
+      fpga::RegionOfInterest::Parse(roi_region, absl::GetFlag(FLAGS_roi_buses));
+    if (!region.ok()) {
+      std::cerr << StatusToErrorMessage("invalid region of interest",
+                                        region.status())
+                << '\n';
+      return EXIT_FAILURE;
+    }
+    roi.emplace(region.value(), part_database_result->tiles().grid);
+  }
+  const fpga::RegionFrames *roi_ptr = roi ? &roi.value() : nullptr;
+
+  absl::Status assembler_result;
+  const std::string incremental_state = absl::GetFlag(FLAGS_incremental);
+  const bool input_is_file = args_count == 2 && std::string_view(args[1]) != "-";
+  if (!incremental_state.empty()) {
+    std::string stdin_content;
+    std::unique_ptr<fpga::MemoryBlock> input;
+    if (input_is_file) {
+      absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> input_result =
+        fpga::MemoryMapFile(std::string_view(args[1]));
+      if (!input_result.ok()) {
+        std::cerr << StatusToErrorMessage("cannot open fasm file",
+                                          input_result.status())
                   << "\n";
         return 1;
       }
+      input = std::move(input_result.value());
+    } else {
+      stdin_content.assign(std::istreambuf_iterator<char>(std::cin),
+                           std::istreambuf_iterator<char>());
     }
+    // Features are resolved through the feature index too, if given.
+    std::vector<std::string> sources = part_database_result->sources();
+    if (!feature_index_path.empty()) {
+      sources.push_back(feature_index_path);
+    }
+    assembler_result = AssembleIncrementally(
+      input ? input->AsStringView() : stdin_content, incremental_state,
+      DatabaseFingerprint(prjxray_db_path, part), sources,
+      part_database_result.value(), frames, roi_ptr);
+  } else if (input_is_file) {
+    const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> input_result =
+      fpga::MemoryMapFile(std::string_view(args[1]));
+    if (!input_result.ok()) {
+      std::cerr << StatusToErrorMessage("cannot open fasm file",
+                                        input_result.status())
+                << "\n";
+      return 1;
+    }
+    assembler_result = AssembleFrames(
+      input_result.value()->AsStringView(), absl::GetFlag(FLAGS_parse_threads),
+      absl::GetFlag(FLAGS_threads), part_database_result.value(), frames,
+      roi_ptr);
+  } else {
+    assembler_result =
+      AssembleFrames(stdin, absl::GetFlag(FLAGS_threads),
+                     part_database_result.value(), frames, roi_ptr);
   }
-  fpga::Frames frames;
-  const auto assembler_result =
-    AssembleFrames(input_stream, part_database_result.value(), frames);
   if (!assembler_result.ok()) {
     std::cerr << StatusToErrorMessage("could not assemble frames",
                                       assembler_result)
               << '\n';
     return EXIT_FAILURE;
   }
-  const fpga::Part &part_data = part_database_result->tiles().part;
+  const std::string base_bitstream = absl::GetFlag(FLAGS_base);
   const auto bitstream_status =
-    fpga::xilinx::BitStream<fpga::xilinx::Architecture::kXC7>::Encode<
-      fpga::Frames>(part_data, "fasm", "fpga-source", frames, std::cout);
+    base_bitstream.empty() && !roi.has_value()
+      ? WriteBitstream(frames, std::cout)
+      : WritePartialBitstream(frames, base_bitstream,
+                              roi ? &roi->frames() : nullptr, std::cout);
   if (!bitstream_status.ok()) {
     std::cerr << StatusToErrorMessage("could not generate bistream",
                                       bitstream_status)
@@ -0,0 +1,151 @@
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "fpga/assembler-server.h"
+#include "fpga/xilinx/arch-types.h"
+#include "fpga/xilinx/bitstream-reader.h"
+#include "fpga/xilinx/configuration.h"
+#include "gtest/gtest.h"
+
+extern char **environ;
+
+namespace fpga {
+namespace {
+constexpr char kAssembler[] = "fpga/fpga-as";
+constexpr char kDatabase[] = "fpga/testdata/prjxray-db";
+constexpr char kPart[] = "xc7test-1";
+// As in the part.json of kPart.
+constexpr uint32_t kIdcode = 56807571;
+
+constexpr xilinx::Architecture kArch = xilinx::Architecture::kXC7;
+using ArchType = xilinx::ArchitectureType<kArch>;
+using FrameAddress = ArchType::FrameAddress;
+using ConfigurationType = xilinx::Configuration<kArch>;
+
+// The configuration frames of kPart: one clock region row of two columns
+// at the top, one of a single column at the bottom.
+ArchType::Part TestPart() {
+  std::vector<FrameAddress> addresses;
+  const auto add_column = [&addresses](bool bottom, uint32_t column) {
+    for (uint32_t minor = 0; minor < 36; ++minor) {
+      addresses.emplace_back(xilinx::xc7::BlockType::kCLBIOCLK, bottom, 0,
+                             column, minor);
+    }
+  };
+  add_column(/*bottom=*/false, 0);
+  add_column(/*bottom=*/false, 1);
+  add_column(/*bottom=*/true, 0);
+  return ArchType::Part(kIdcode, addresses);
+}
+
+// Runs the fpga-as binary in --serve mode on the database in
+// testdata/prjxray-db and sends requests like fpga-as-client does.
+class AssemblerServeTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    socket_path_ =
+      absl::StrCat(testing::TempDir(), "/fpga-as.", getpid(), ".sock");
+    const std::string db_flag = absl::StrCat("--prjxray_db_path=", kDatabase);
+    const std::string part_flag = absl::StrCat("--part=", kPart);
+    const std::string serve_flag = absl::StrCat("--serve=", socket_path_);
+    char *const argv[] = {const_cast<char *>(kAssembler),
+                          const_cast<char *>(db_flag.c_str()),
+                          const_cast<char *>(part_flag.c_str()),
+                          const_cast<char *>(serve_flag.c_str()), nullptr};
+    ASSERT_EQ(posix_spawn(&pid_, kAssembler, nullptr, nullptr, argv, environ),
+              0);
+    // The part is loaded before the socket is listened on.
+    const absl::Time deadline = absl::Now() + absl::Seconds(30);
+    while (!AssembleRemote(socket_path_, "", "").ok()) {
+      ASSERT_EQ(waitpid(pid_, nullptr, WNOHANG), 0) << "fpga-as exited";
+      ASSERT_LT(absl::Now(), deadline) << "fpga-as is not serving";
+      absl::SleepFor(absl::Milliseconds(50));
+    }
+  }
+
+  void TearDown() override {
+    if (pid_ > 0) {
+      kill(pid_, SIGTERM);
+      waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  std::string socket_path_;
+  pid_t pid_ = 0;
+};
+
+// The words of "address" in the configuration loaded by "bitstream".
+std::optional<std::vector<uint32_t>> FrameWords(std::string_view bitstream,
+                                                uint32_t address) {
+  auto reader = xilinx::BitstreamReader<kArch>::InitWithBytes(
+    absl::MakeConstSpan(reinterpret_cast<const uint8_t *>(bitstream.data()),
+                        bitstream.size()));
+  if (!reader.has_value()) {
+    return std::nullopt;
+  }
+  const auto configuration =
+    ConfigurationType::InitWithPackets(TestPart(), reader.value());
+  if (!configuration.has_value()) {
+    return std::nullopt;
+  }
+  const auto found = configuration->frames().find(FrameAddress(address));
+  if (found == configuration->frames().end()) {
+    return std::nullopt;
+  }
+  return std::vector<uint32_t>(found->second.begin(), found->second.end());
+}
+
+TEST_F(AssemblerServeTest, AssemblesFeaturesOfThePart) {
+  const absl::StatusOr<std::string> bitstream =
+    AssembleRemote(socket_path_, kPart,
+                   "CLBLL_L_X2Y1.SLICEL_X0.AFF.ZINI\n"
+                   "CLBLL_L_X3Y1.SLICEL_X0.ALUT.INIT[1]=1'b1\n");
+  ASSERT_TRUE(bitstream.ok()) << bitstream.status();
+
+  // segbits_clbll_l.db: AFF.ZINI is 1_3, ALUT.INIT[1] is 0_33.
+  const std::optional<std::vector<uint32_t>> aff = FrameWords(*bitstream, 0x1);
+  ASSERT_TRUE(aff.has_value());
+  EXPECT_EQ((*aff)[0], uint32_t{1} << 3);
+  const std::optional<std::vector<uint32_t>> alut =
+    FrameWords(*bitstream, 0x80);
+  ASSERT_TRUE(alut.has_value());
+  EXPECT_EQ((*alut)[0], 0);
+  EXPECT_EQ((*alut)[1], uint32_t{1} << 1);
+}
+
+TEST_F(AssemblerServeTest, ReportsErrorsOfTheRequest) {
+  const absl::StatusOr<std::string> bitstream =
+    AssembleRemote(socket_path_, "", "CLBLL_L_X9Y9.SLICEL_X0.AFF.ZINI\n");
+  ASSERT_FALSE(bitstream.ok());
+  EXPECT_TRUE(absl::StrContains(bitstream.status().message(), "CLBLL_L_X9Y9"))
+    << bitstream.status();
+}
+
+TEST_F(AssemblerServeTest, RejectsPartsNotInTheDatabase) {
+  for (const char *part : {"xc7unknown", "../prjxray-db/xc7test-1", "..",
+                           "mapping"}) {
+    const absl::StatusOr<std::string> bitstream =
+      AssembleRemote(socket_path_, part, "");
+    EXPECT_FALSE(bitstream.ok()) << part;
+  }
+  // Loaded parts are still served.
+  EXPECT_TRUE(AssembleRemote(socket_path_, kPart, "").ok());
+}
+}  // namespace
+}  // namespace fpga
@@ -2,10 +2,12 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -14,6 +16,7 @@
 
 #include "absl/base/optimization.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/strings/ascii.h"
@@ -22,15 +25,21 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/strip.h"
+#include "absl/types/span.h"
+#include "fpga/symbol-table.h"
 
 #define RAPIDJSON_HAS_STDSTRING 1
 #include "rapidjson/document.h"
 #undef RAPIDJSON_HAS_STDSTRING
 
+#include "rapidjson/encodedstream.h"
+#include "rapidjson/encodings.h"
 #include "rapidjson/error/en.h"
 #include "rapidjson/error/error.h"
+#include "rapidjson/memorystream.h"
 #include "rapidjson/pointer.h"
 #include "rapidjson/rapidjson.h"
+#include "rapidjson/reader.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
@@ -65,12 +74,6 @@ absl::Status IsObject(const rapidjson::Value &json) {
                              absl::StrFormat("json value not an object"));
 }
 
-absl::Status IsArray(const rapidjson::Value &json) {
-  return json.IsArray() ? absl::OkStatus()
-                        : absl::InvalidArgumentError(
-                            absl::StrFormat("json value not an array"));
-}
-
 const char *JSONTypeString(const rapidjson::Type &type) {
   switch (type) {
   case rapidjson::kNullType: return "null";
@@ -89,6 +92,14 @@ static const absl::flat_hash_map<std::string, ConfigBusType>
                            {"CLB_IO_CLK", ConfigBusType::kCLBIOCLK},
                            {"CFG_CLB", ConfigBusType::kCFGCLB}};
 
+std::optional<ConfigBusType> ParseConfigBusType(std::string_view name) {
+  const auto found = StringToConfigBusType.find(name);
+  if (found == StringToConfigBusType.end()) {
+    return {};
+  }
+  return found->second;
+}
+
 std::string ValueAsString(const rapidjson::Value &json) {
   rapidjson::StringBuffer sb;
   rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
@@ -133,114 +144,18 @@ inline absl::StatusOr<std::optional<T>> OptGetMember(
   return Unmarshal<T>(itr->value);
 }
 
-template <>
-inline absl::StatusOr<absl::flat_hash_map<std::string, std::string>> Unmarshal(
-  const rapidjson::Value &json) {
-  OK_OR_RETURN(IsObject(json));
-  absl::flat_hash_map<std::string, std::string> value;
-  std::string k;
-  std::string v;
-  for (auto it = json.MemberBegin(); it != json.MemberEnd(); ++it) {
-    ASSIGN_OR_RETURN(k, Unmarshal<std::string>(it->name));
-    ASSIGN_OR_RETURN(v, Unmarshal<std::string>(it->value));
-    value.insert({k, v});
-  }
-  return value;
-}
-
-template <>
-inline absl::StatusOr<std::vector<std::string>> Unmarshal(
-  const rapidjson::Value &json) {
-  OK_OR_RETURN(IsArray(json));
-  std::vector<std::string> array;
-  for (const auto &item : json.GetArray()) {
-    if (!item.IsString()) {
-      return UnexpectedTypeError(item);
-    }
-    array.emplace_back(item.GetString());
-  }
-  return array;
-}
-
-inline absl::StatusOr<bits_addr_t> ParseBaseAddress(
-  absl::StatusOr<std::string> value) {
-  if (!value.ok()) return value.status();
+inline absl::StatusOr<bits_addr_t> ParseBaseAddress(const std::string &value) {
   errno = 0;
   char *end;
-  const bits_addr_t address = std::strtol(value.value().c_str(), &end, 0);
+  const bits_addr_t address = std::strtol(value.c_str(), &end, 0);
   const bool range_error = errno == ERANGE;
   if (range_error) {
     return absl::InvalidArgumentError(
-      absl::StrFormat("could not parse %s to bits address", value.value()));
+      absl::StrFormat("could not parse %s to bits address", value));
   }
   return address;
 }
 
-template <>
-inline absl::StatusOr<BitsBlockAlias> Unmarshal(const rapidjson::Value &json) {
-  BitsBlockAlias value;
-  ASSIGN_OR_RETURN(
-    value.sites,
-    (GetMember<absl::flat_hash_map<std::string, std::string>>(json, "sites")));
-  ASSIGN_OR_RETURN(value.start_offset,
-                   GetMember<uint32_t>(json, "start_offset"));
-  ASSIGN_OR_RETURN(value.type, GetMember<std::string>(json, "type"));
-  return value;
-}
-
-template <>
-inline absl::StatusOr<BitsBlock> Unmarshal(const rapidjson::Value &json) {
-  BitsBlock bits_block;
-  ASSIGN_OR_RETURN(bits_block.alias,
-                   OptGetMember<BitsBlockAlias>(json, "alias"));
-  ASSIGN_OR_RETURN(bits_block.base_address,
-                   ParseBaseAddress(GetMember<std::string>(json, "baseaddr")));
-
-  ASSIGN_OR_RETURN(bits_block.frames, GetMember<uint32_t>(json, "frames"));
-  ASSIGN_OR_RETURN(bits_block.offset, GetMember<int32_t>(json, "offset"));
-  ASSIGN_OR_RETURN(bits_block.words, GetMember<uint32_t>(json, "words"));
-  return bits_block;
-}
-
-template <>
-absl::StatusOr<Bits> Unmarshal(const rapidjson::Value &json) {
-  Bits bits;
-  for (auto it = json.MemberBegin(); it != json.MemberEnd(); ++it) {
-    const std::string block_type_string = it->name.GetString();
-    if (!StringToConfigBusType.contains(block_type_string)) {
-      return absl::InvalidArgumentError(
-        absl::StrFormat("unknown frame block type \"%s\"", block_type_string));
-    }
-    const ConfigBusType type = StringToConfigBusType.at(block_type_string);
-    BitsBlock bits_block;
-    ASSIGN_OR_RETURN(bits_block, Unmarshal<BitsBlock>(it->value));
-    bits.insert({type, bits_block});
-  }
-  return bits;
-}
-
-template <>
-absl::StatusOr<Tile> Unmarshal(const rapidjson::Value &json) {
-  struct Tile tile;
-  ASSIGN_OR_RETURN(tile.type, GetMember<std::string>(json, "type"));
-  ASSIGN_OR_RETURN(tile.coord.x, GetMember<uint32_t>(json, "grid_x"));
-  ASSIGN_OR_RETURN(tile.coord.y, GetMember<uint32_t>(json, "grid_y"));
-
-  ASSIGN_OR_RETURN(tile.clock_region,
-                   OptGetMember<std::string>(json, "clock_region"));
-  ASSIGN_OR_RETURN(tile.bits, GetMember<Bits>(json, "bits"));
-
-  ASSIGN_OR_RETURN(tile.pin_functions,
-                   (GetMember<absl::flat_hash_map<std::string, std::string>>(
-                     json, "pin_functions")));
-  ASSIGN_OR_RETURN(
-    tile.sites,
-    (GetMember<absl::flat_hash_map<std::string, std::string>>(json, "sites")));
-  ASSIGN_OR_RETURN(tile.prohibited_sites, (GetMember<std::vector<std::string>>(
-                                            json, "prohibited_sites")));
-  return tile;
-}
-
 template <>
 absl::StatusOr<absl::flat_hash_map<uint32_t, std::string>> Unmarshal(
   const rapidjson::Value &json) {
@@ -366,6 +281,349 @@ absl::StatusOr<Part> Unmarshal(const rapidjson::Value &json) {
                                                 json, "global_clock_regions")));
   return part;
 }
+
+// Members of the tilegrid.json objects, the required ones first and in the
+// order of the corresponding enum.
+enum TileMember {
+  kTileType,
+  kTileGridX,
+  kTileGridY,
+  kTileBits,
+  kTilePinFunctions,
+  kTileSites,
+  kTileProhibitedSites,
+  kTileClockRegion,
+};
+constexpr std::string_view kTileMembers[] = {
+  "type",  "grid_x",           "grid_y",      "bits", "pin_functions",
+  "sites", "prohibited_sites", "clock_region"};
+constexpr size_t kTileRequiredMembers = 7;
+
+enum BitsBlockMember {
+  kBitsBlockBaseAddress,
+  kBitsBlockFrames,
+  kBitsBlockOffset,
+  kBitsBlockWords,
+  kBitsBlockAlias,
+};
+constexpr std::string_view kBitsBlockMembers[] = {"baseaddr", "frames",
+                                                  "offset", "words", "alias"};
+constexpr size_t kBitsBlockRequiredMembers = 4;
+
+enum BitsBlockAliasMember {
+  kAliasSites,
+  kAliasStartOffset,
+  kAliasType,
+};
+constexpr std::string_view kBitsBlockAliasMembers[] = {"sites", "start_offset",
+                                                       "type"};
+constexpr size_t kBitsBlockAliasRequiredMembers = 3;
+
+// Builds the TileGrid straight from the SAX events of tilegrid.json, without
+// an intermediate document. Unknown members are skipped.
+class TileGridHandler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, TileGridHandler> {
+ public:
+  // Parse a whole tilegrid.json into "tilegrid".
+  explicit TileGridHandler(TileGrid &tilegrid) : tilegrid_(&tilegrid) {}
+
+  // Parse the object of the single tile "name" into "tile".
+  TileGridHandler(std::string_view name, Tile &tile)
+      : tile_name_(name), single_tile_(&tile) {}
+
+  // Why the handler stopped the parsing.
+  const absl::Status &status() const { return status_; }
+
+  bool StartObject() {
+    if (Skipping()) return Push(kSkipped);
+    if (stack_.empty()) {
+      if (single_tile_ == nullptr) return Push(kGridObject);
+      tile_ = Tile();
+      return Push(kTileObject);
+    }
+    switch (stack_.back().context) {
+    case kGridObject: tile_ = Tile(); return Push(kTileObject);
+    case kTileObject:
+      if (member_ == kTileBits) return Push(kBitsObject);
+      if (member_ == kTilePinFunctions) {
+        return PushStringMap(tile_.pin_functions);
+      }
+      if (member_ == kTileSites) return PushStringMap(tile_.sites);
+      break;
+    case kBitsObject: block_ = BitsBlock(); return Push(kBitsBlockObject);
+    case kBitsBlockObject:
+      if (member_ == kBitsBlockAlias) {
+        block_.alias.emplace();
+        return Push(kAliasObject);
+      }
+      break;
+    case kAliasObject:
+      if (member_ == kAliasSites) {
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        return PushStringMap(block_.alias->sites);
+      }
+      break;
+    default: break;
+    }
+    return UnexpectedType("object");
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    const Object &object = stack_.back();
+    switch (object.context) {
+    case kTileObject:
+      if (!HasRequiredMembers(object, kTileMembers, kTileRequiredMembers)) {
+        return false;
+      }
+      if (single_tile_ != nullptr) {
+        *single_tile_ = std::move(tile_);
+      } else {
+        tilegrid_->try_emplace(std::move(tile_name_), std::move(tile_));
+      }
+      break;
+    case kBitsBlockObject:
+      if (!HasRequiredMembers(object, kBitsBlockMembers,
+                              kBitsBlockRequiredMembers)) {
+        return false;
+      }
+      tile_.bits.try_emplace(bus_, std::move(block_));
+      break;
+    case kAliasObject:
+      if (!HasRequiredMembers(object, kBitsBlockAliasMembers,
+                              kBitsBlockAliasRequiredMembers)) {
+        return false;
+      }
+      break;
+    default: break;
+    }
+    stack_.pop_back();
+    return true;
+  }
+
+  bool StartArray() {
+    if (Skipping()) return Push(kSkipped);
+    if (Current() == kTileObject && member_ == kTileProhibitedSites) {
+      return Push(kStringArray);
+    }
+    return UnexpectedType("array");
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    stack_.pop_back();
+    return true;
+  }
+
+  bool Key(const char *str, rapidjson::SizeType length, bool) {
+    Object &object = stack_.back();
+    key_.assign(str, length);
+    switch (object.context) {
+    case kGridObject: tile_name_ = key_; break;
+    case kTileObject: SetMember(object, kTileMembers); break;
+    case kBitsBlockObject: SetMember(object, kBitsBlockMembers); break;
+    case kAliasObject: SetMember(object, kBitsBlockAliasMembers); break;
+    case kBitsObject: {
+      const std::optional<ConfigBusType> bus = ParseConfigBusType(key_);
+      if (!bus) {
+        return Fail(absl::StrFormat("unknown frame block type \"%s\"", key_));
+      }
+      bus_ = *bus;
+      break;
+    }
+    default: break;
+    }
+    return true;
+  }
+
+  bool String(const char *str, rapidjson::SizeType length, bool) {
+    if (Skipping()) return true;
+    const std::string_view value(str, length);
+    switch (Current()) {
+    case kTileObject:
+      if (member_ == kTileType) {
+        tile_.type = Symbol(value);
+        return true;
+      }
+      if (member_ == kTileClockRegion) {
+        tile_.clock_region.emplace(value);
+        return true;
+      }
+      break;
+    case kBitsBlockObject:
+      if (member_ == kBitsBlockBaseAddress) {
+        const absl::StatusOr<bits_addr_t> address =
+          ParseBaseAddress(std::string(value));
+        if (!address.ok()) return Fail(address.status().message());
+        block_.base_address = address.value();
+        return true;
+      }
+      break;
+    case kAliasObject:
+      if (member_ == kAliasType) {
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        block_.alias->type = Symbol(value);
+        return true;
+      }
+      break;
+    case kStringMap:
+      string_map_->try_emplace(Symbol(key_), Symbol(value));
+      return true;
+    case kStringArray: tile_.prohibited_sites.emplace_back(value); return true;
+    default: break;
+    }
+    return UnexpectedType("string");
+  }
+
+  bool Uint(unsigned value) {
+    if (Skipping()) return true;
+    switch (Current()) {
+    case kTileObject:
+      if (member_ == kTileGridX) {
+        tile_.coord.x = value;
+        return true;
+      }
+      if (member_ == kTileGridY) {
+        tile_.coord.y = value;
+        return true;
+      }
+      break;
+    case kBitsBlockObject:
+      if (member_ == kBitsBlockFrames) {
+        block_.frames = value;
+        return true;
+      }
+      if (member_ == kBitsBlockOffset &&
+          value <= std::numeric_limits<int32_t>::max()) {
+        block_.offset = static_cast<int32_t>(value);
+        return true;
+      }
+      if (member_ == kBitsBlockWords) {
+        block_.words = value;
+        return true;
+      }
+      break;
+    case kAliasObject:
+      if (member_ == kAliasStartOffset) {
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        block_.alias->start_offset = value;
+        return true;
+      }
+      break;
+    default: break;
+    }
+    return UnexpectedType("number");
+  }
+
+  // Only called for negative numbers.
+  bool Int(int value) {
+    if (Skipping()) return true;
+    if (Current() == kBitsBlockObject && member_ == kBitsBlockOffset) {
+      block_.offset = value;
+      return true;
+    }
+    return UnexpectedType("number");
+  }
+
+  // Any other value: null, booleans and numbers out of range.
+  bool Default() { return Skipping() || UnexpectedType("value"); }
+
+ private:
+  enum Context {
+    kNone,
+    kGridObject,
+    kTileObject,
+    kBitsObject,
+    kBitsBlockObject,
+    kAliasObject,
+    kStringMap,
+    kStringArray,
+    kSkipped,
+  };
+
+  struct Object {
+    Context context;
+    // Bit i is set if the i-th known member was seen.
+    uint32_t seen;
+  };
+
+  Context Current() const {
+    return stack_.empty() ? kNone : stack_.back().context;
+  }
+
+  bool Push(Context context) {
+    stack_.push_back({context, 0});
+    member_ = -1;
+    return true;
+  }
+
+  bool PushStringMap(absl::flat_hash_map<Symbol, Symbol> &map) {
+    string_map_ = &map;
+    return Push(kStringMap);
+  }
+
+  // True if the current value belongs to an unknown member.
+  bool Skipping() const {
+    switch (Current()) {
+    case kTileObject:
+    case kBitsBlockObject:
+    case kAliasObject: return member_ < 0;
+    case kSkipped: return true;
+    default: return false;
+    }
+  }
+
+  void SetMember(Object &object, absl::Span<const std::string_view> members) {
+    const auto found = std::find(members.begin(), members.end(), key_);
+    member_ =
+      found == members.end() ? -1 : static_cast<int>(found - members.begin());
+    if (member_ >= 0) {
+      object.seen |= 1u << member_;
+    }
+  }
+
+  bool HasRequiredMembers(const Object &object,
+                          absl::Span<const std::string_view> members,
+                          size_t required) {
+    for (size_t i = 0; i < required; ++i) {
+      if (!(object.seen & (1u << i))) {
+        return Fail(
+          absl::StrFormat("json attribute \"%s\" not found", members[i]));
+      }
+    }
+    return true;
+  }
+
+  bool UnexpectedType(std::string_view type) {
+    if (Current() == kNone || Current() == kGridObject) {
+      return Fail("json value not an object");
+    }
+    return Fail(absl::StrFormat(
+      "could not unmarshal \"%s\", unexpected type: %s", key_, type));
+  }
+
+  bool Fail(std::string_view message) {
+    // Anything below the top level object belongs to a tile.
+    status_ = absl::InvalidArgumentError(
+      Current() == kNone && single_tile_ == nullptr
+        ? std::string(message)
+        : absl::StrFormat("could not unmarshal tile %s: %s", tile_name_,
+                          message));
+    return false;
+  }
+
+  TileGrid *tilegrid_ = nullptr;
+  absl::Status status_;
+  std::vector<Object> stack_;
+  // Last key seen and its index in the members of its object, -1 if unknown.
+  std::string key_;
+  int member_ = -1;
+  std::string tile_name_;
+  Tile *single_tile_ = nullptr;
+  Tile tile_;
+  ConfigBusType bus_ = ConfigBusType::kCLBIOCLK;
+  BitsBlock block_;
+  // Where the members of a kStringMap go.
+  absl::flat_hash_map<Symbol, Symbol> *string_map_ = nullptr;
+};
 #undef OK_OR_RETURN
 #undef ASSIGN_OR_RETURN
 #undef ASSIGN_OR_RETURN_IMPL
@@ -373,31 +631,165 @@ absl::StatusOr<Part> Unmarshal(const rapidjson::Value &json) {
 #undef STATUS_MACROS_CONCAT_NAME_INNER
 }  // namespace
 
-absl::StatusOr<TileGrid> ParseTileGridJSON(const std::string_view content) {
-  rapidjson::Document json;
-  const rapidjson::ParseResult ok = json.Parse(content.data(), content.size());
+namespace {
+// Run "handler" over the JSON "content".
+absl::Status ParseJSON(std::string_view content, TileGridHandler &handler) {
+  rapidjson::MemoryStream stream(content.data(), content.size());
+  rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream>
+    input(stream);
+  rapidjson::Reader reader;
+  const rapidjson::ParseResult ok = reader.Parse(input, handler);
+  if (ok.Code() == rapidjson::kParseErrorTermination) {
+    return handler.status();
+  }
   if (!ok) {
     return absl::InvalidArgumentError(
       absl::StrFormat("json parsing error, %s (%u)",
                       rapidjson::GetParseError_En(ok.Code()), ok.Offset()));
   }
-  if (!json.IsObject()) {
+  return absl::OkStatus();
+}
+
+// Scans tilegrid.json only as far as needed to find where each tile object
+// starts and ends; strings are not unescaped and numbers not parsed.
+class TileGridScanner {
+ public:
+  explicit TileGridScanner(std::string_view content) : content_(content) {}
+
+  absl::StatusOr<TileGridJSONIndex> Scan() {
+    TileGridJSONIndex index;
+    if (!Consume('{')) return Error();
+    if (Consume('}')) return End(std::move(index));
+    do {
+      TileGridJSONIndex::Entry entry;
+      if (!Consume('"') || !String(entry.name) || !Consume(':')) {
+        return Error();
+      }
+      SkipWhitespace();
+      if (!Object(entry, index.types)) return Error();
+      index.tiles.push_back(entry);
+    } while (Consume(','));
+    if (!Consume('}')) return Error();
+    return End(std::move(index));
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (pos_ < content_.size() && absl::ascii_isspace(content_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  // Skip whitespace, then the character "c" if it is next.
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ < content_.size() && content_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // The rest of a string whose opening quote was consumed, as is.
+  bool String(std::string_view &value) {
+    const size_t begin = pos_;
+    while (pos_ < content_.size()) {
+      const char c = content_[pos_++];
+      if (c == '\\') {
+        ++pos_;
+      } else if (c == '"') {
+        value = content_.substr(begin, pos_ - 1 - begin);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // An unsigned integer if there is one at the current position, which is
+  // left as is otherwise.
+  void Uint(uint32_t &value) {
+    SkipWhitespace();
+    const size_t begin = pos_;
+    while (pos_ < content_.size() && absl::ascii_isdigit(content_[pos_])) {
+      ++pos_;
+    }
+    if (!absl::SimpleAtoi(content_.substr(begin, pos_ - begin), &value)) {
+      pos_ = begin;
+    }
+  }
+
+  // The tile object starting at the current position. The values of the
+  // "type" members at any depth are added to "types".
+  bool Object(TileGridJSONIndex::Entry &entry,
+              absl::flat_hash_set<std::string_view> &types) {
+    const size_t begin = pos_;
+    if (pos_ >= content_.size() || content_[pos_] != '{') return false;
+    int depth = 0;
+    while (pos_ < content_.size()) {
+      const char c = content_[pos_++];
+      if (c == '"') {
+        std::string_view key;
+        if (!String(key)) return false;
+        std::string_view type;
+        if (key == "type" && Consume(':') && Consume('"')) {
+          if (!String(type)) return false;
+          types.insert(type);
+        } else if (depth == 1 && key == "grid_x" && Consume(':')) {
+          Uint(entry.coord.x);
+        } else if (depth == 1 && key == "grid_y" && Consume(':')) {
+          Uint(entry.coord.y);
+        }
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        entry.json = content_.substr(begin, pos_ - begin);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  absl::StatusOr<TileGridJSONIndex> End(TileGridJSONIndex index) {
+    SkipWhitespace();
+    if (pos_ != content_.size()) return Error();
+    return index;
+  }
+
+  absl::Status Error() const {
     return absl::InvalidArgumentError(
-      absl::StrFormat("json value not an object"));
+      absl::StrFormat("json parsing error, invalid tile grid (%u)", pos_));
   }
+
+  const std::string_view content_;
+  size_t pos_ = 0;
+};
+}  // namespace
+
+absl::StatusOr<TileGrid> ParseTileGridJSON(const std::string_view content) {
   TileGrid tilegrid;
-  for (auto it = json.MemberBegin(); it != json.MemberEnd(); ++it) {
-    const std::string name = it->name.GetString();
-    const absl::StatusOr<Tile> tile = Unmarshal<Tile>(it->value);
-    if (!tile.ok()) {
-      return absl::InvalidArgumentError(absl::StrFormat(
-        "could not unmarshal tile %s: %s", name, tile.status().message()));
-    }
-    tilegrid.insert({name, tile.value()});
+  TileGridHandler handler(tilegrid);
+  const absl::Status status = ParseJSON(content, handler);
+  if (!status.ok()) {
+    return status;
   }
   return tilegrid;
 }
 
+absl::StatusOr<Tile> ParseTileJSON(std::string_view name,
+                                   std::string_view content) {
+  Tile tile;
+  TileGridHandler handler(name, tile);
+  const absl::Status status = ParseJSON(content, handler);
+  if (!status.ok()) {
+    return status;
+  }
+  return tile;
+}
+
+absl::StatusOr<TileGridJSONIndex> IndexTileGridJSON(std::string_view content) {
+  return TileGridScanner(content).Scan();
+}
+
 namespace {
 // [[unlikely]] only available since c++20, so use gcc/clang builtin here.
 #define unlikely(x) __builtin_expect((x), 0)
@@ -438,37 +830,69 @@ absl::Status MakeInvalidLineStatus(const uint32_t line_number,
     absl::StrFormat("%d: %s", line_number, message));
 }
 
-absl::Status ParsePseudoPIPTypeFromString(const std::string &value,
+// Hands out the whitespace separated tokens of a line as views into it.
+class LineTokenizer {
+ public:
+  explicit LineTokenizer(std::string_view line) : rest_(line) {}
+
+  // Next token; empty once the end of the line is reached.
+  std::string_view Next() {
+    size_t start = 0;
+    while (start < rest_.size() && absl::ascii_isspace(rest_[start])) ++start;
+    size_t end = start;
+    while (end < rest_.size() && !absl::ascii_isspace(rest_[end])) ++end;
+    const std::string_view token = rest_.substr(start, end - start);
+    rest_.remove_prefix(end);
+    return token;
+  }
+
+ private:
+  std::string_view rest_;
+};
+
+// Parse a non-empty sequence of decimal digits.
+bool ParseDecimal(std::string_view digits, uint32_t &value) {
+  if (digits.empty()) return false;
+  uint64_t result = 0;
+  for (const char c : digits) {
+    if (c < '0' || c > '9') return false;
+    result = result * 10 + (c - '0');
+    if (result > UINT32_MAX) return false;
+  }
+  value = result;
+  return true;
+}
+
+absl::Status ParsePseudoPIPTypeFromString(std::string_view value,
                                           PseudoPIPType *type) {
-  static const absl::flat_hash_map<std::string, PseudoPIPType>
-    pseudo_pip_type_string = {
-      {"always", PseudoPIPType::kAlways},
-      {"default", PseudoPIPType::kDefault},
-      {"hint", PseudoPIPType::kHint},
-    };
-  if (pseudo_pip_type_string.contains(value)) {
-    *type = pseudo_pip_type_string.at(value);
-    return absl::OkStatus();
+  if (value == "always") {
+    *type = PseudoPIPType::kAlways;
+  } else if (value == "default") {
+    *type = PseudoPIPType::kDefault;
+  } else if (value == "hint") {
+    *type = PseudoPIPType::kHint;
+  } else {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("invalid pseudo pip state \"%s\"", value));
   }
-  return absl::InvalidArgumentError(
-    absl::StrFormat("invalid pseudo pip state \"%s\"", value));
+  return absl::OkStatus();
 }
 
 absl::Status ParsePseudoPIPDatabaseLine(uint32_t line_count,
                                         const std::string_view line,
                                         PseudoPIPs &out) {
-  if (line.empty()) return absl::OkStatus();
-  std::vector<std::string> segments =
-    absl::StrSplit(line, absl::ByAsciiWhitespace(), absl::SkipEmpty());
-  if (segments.size() != 2) {
+  LineTokenizer tokens(line);
+  const std::string_view name = tokens.Next();
+  if (name.empty()) return absl::OkStatus();
+  const std::string_view type_name = tokens.Next();
+  if (type_name.empty() || !tokens.Next().empty()) {
     return MakeInvalidLineStatus(line_count,
                                  absl::StrFormat("invalid line \"%s\"", line));
   }
-  const std::string &name = segments[0];
   PseudoPIPType type = {};
-  absl::Status status = ParsePseudoPIPTypeFromString(segments[1], &type);
+  absl::Status status = ParsePseudoPIPTypeFromString(type_name, &type);
   if (!status.ok()) return status;
-  out.insert({name, type});
+  out.emplace(name, type);
   return absl::OkStatus();
 }
 }  // namespace
@@ -491,68 +915,62 @@ absl::StatusOr<PseudoPIPs> ParsePseudoPIPsDatabase(
 namespace {
 // Parse a string like "FOO.BASD.SDA#@@!@E!{]{]{}[231]".
 // The returned output will be "FOO.BASD.SDA#@@!@E!{]{]{}" with address 231.
-TileFeature ParseTileFeatureNameAndAddress(const std::string &value) {
-  TileFeature out{
-    .tile_feature = value,
-    .address = 0,
-  };
-  const char *const start = value.data();
-
+TileFeature ParseTileFeatureNameAndAddress(std::string_view value) {
+  uint32_t address = 0;
   // Start from the end, if there's a ']'
   // reverse iterate until you find the opening bracket.
   if (absl::EndsWith(value, "]")) {
     const size_t open_bracket_pos = value.rfind('[');
-    if (open_bracket_pos == std::string::npos) {
-      // Best effort, opening bracket not found, no matching, return.
-      return out;
-    }
-    const char *const start_address = start + open_bracket_pos + 1;
-    if (!absl::SimpleAtoi(
-          std::string_view(start_address, value.size() - open_bracket_pos - 2),
-          &out.address)) {
-      // Cannot parse integer, give up on parsing an address.
-      return out;
+    // Best effort: without an opening bracket or a valid integer, there is
+    // no address.
+    if (open_bracket_pos != std::string_view::npos &&
+        ParseDecimal(value.substr(open_bracket_pos + 1,
+                                  value.size() - open_bracket_pos - 2),
+                     address)) {
+      value = value.substr(0, open_bracket_pos);
     }
-    out.tile_feature = std::string(start, start + open_bracket_pos);
   }
-  return out;
+  return {.tile_feature = std::string(value), .address = address};
+}
+
+// Parse a "<column>_<bit>" coordinate, prefixed by '!' if the bit is unset.
+absl::Status ParseSegmentBit(uint32_t line_count, std::string_view line,
+                             std::string_view token, SegmentBit &bit) {
+  bit.is_set = token[0] != '!';
+  if (!bit.is_set) token.remove_prefix(1);
+  const size_t separator = token.find('_');
+  if (separator == std::string_view::npos ||
+      token.find('_', separator + 1) != std::string_view::npos) {
+    return MakeInvalidLineStatus(line_count,
+                                 absl::StrFormat("invalid line \"%s\"", line));
+  }
+  if (!ParseDecimal(token.substr(0, separator), bit.word_column) ||
+      !ParseDecimal(token.substr(separator + 1), bit.word_bit)) {
+    return MakeInvalidLineStatus(
+      line_count, absl::StrFormat("could not parse coordinate \"%s\"", line));
+  }
+  return absl::OkStatus();
 }
 
 absl::Status ParseSegmentsBitsDatabaseLine(uint32_t line_count,
                                            const std::string_view line,
                                            SegmentsBits &out) {
-  std::vector<std::string> segments =
-    absl::StrSplit(line, absl::ByAsciiWhitespace(), absl::SkipEmpty());
-  if (segments.empty()) return absl::OkStatus();
-  if (segments.size() == 1) {
+  LineTokenizer tokens(line);
+  const std::string_view name = tokens.Next();
+  if (name.empty()) return absl::OkStatus();
+  std::vector<SegmentBit> segment_bits;
+  for (std::string_view token = tokens.Next(); !token.empty();
+       token = tokens.Next()) {
+    SegmentBit &bit = segment_bits.emplace_back();
+    const absl::Status status = ParseSegmentBit(line_count, line, token, bit);
+    if (!status.ok()) return status;
+  }
+  if (segment_bits.empty()) {
     return MakeInvalidLineStatus(line_count,
                                  absl::StrFormat("invalid line \"%s\"", line));
   }
-  const std::string &name = segments[0];
-  const TileFeature name_and_address = ParseTileFeatureNameAndAddress(name);
-  std::vector<SegmentBit> segment_bits;
-  for (size_t i = 1; i < segments.size(); ++i) {
-    const std::string_view bit = segments[i];
-    const bool set = bit[0] != '!';
-    const std::vector<std::string> coordinates =
-      absl::StrSplit(set ? bit : bit.substr(1), '_');
-    if (coordinates.size() != 2) {
-      return MakeInvalidLineStatus(
-        line_count, absl::StrFormat("invalid line \"%s\"", line));
-    }
-    uint32_t word_column;
-    uint32_t word_bit;
-    if (!absl::SimpleAtoi(coordinates[0], &word_column)) {
-      return MakeInvalidLineStatus(
-        line_count, absl::StrFormat("could not parse coordinate \"%s\"", line));
-    }
-    if (!absl::SimpleAtoi(coordinates[1], &word_bit)) {
-      return MakeInvalidLineStatus(
-        line_count, absl::StrFormat("could not parse coordinate \"%s\"", line));
-    }
-    segment_bits.push_back({word_column, word_bit, set});
-  }
-  out.insert({name_and_address, segment_bits});
+  out.try_emplace(ParseTileFeatureNameAndAddress(name),
+                  std::move(segment_bits));
   return absl::OkStatus();
 }
 }  // namespace
@@ -615,15 +1033,15 @@ absl::Status ParsePackagePinCSVLine(uint32_t line_count,
                                  absl::StrFormat("invalid line \"%s\"", line));
   }
   PackagePin pp;
-  pp.pin = segments[0];
+  pp.pin = Symbol(segments[0]);
   if (!absl::SimpleAtoi(segments[1], &pp.bank)) {
     return MakeInvalidLineStatus(
       line_count,
       absl::StrFormat("could not parse bank (second column) \"%s\"", line));
   }
-  pp.site = segments[2];
-  pp.tile = segments[3];
-  pp.pin_function = segments[4];
+  pp.site = Symbol(segments[2]);
+  pp.tile = Symbol(segments[3]);
+  pp.pin_function = Symbol(segments[4]);
   out.push_back(pp);
   return absl::OkStatus();
 }
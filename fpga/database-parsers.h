@@ -8,7 +8,9 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
+#include "fpga/symbol-table.h"
 
 namespace fpga {
 enum class ConfigBusType {
@@ -22,12 +24,15 @@ struct Location {
   uint32_t y;
 };
 
+// Bus of a bus name as used in the database, e.g. "CLB_IO_CLK".
+std::optional<ConfigBusType> ParseConfigBusType(std::string_view name);
+
 using bits_addr_t = uint64_t;
 
 struct BitsBlockAlias {
-  absl::flat_hash_map<std::string, std::string> sites;
+  absl::flat_hash_map<Symbol, Symbol> sites;
   uint32_t start_offset;
-  std::string type;
+  Symbol type;
 };
 
 struct BitsBlock {
@@ -42,7 +47,7 @@ using Bits = absl::flat_hash_map<ConfigBusType, BitsBlock>;
 
 struct Tile {
   // Tile type.
-  std::string type;
+  Symbol type;
 
   // Grid coordinates.
   // x: column, increasing right.
@@ -50,7 +55,7 @@ struct Tile {
   Location coord;
 
   // Maybe repeated.
-  std::optional<std::string> clock_region;
+  std::optional<Symbol> clock_region;
 
   // Tile configuration bits.
   Bits bits;
@@ -58,13 +63,13 @@ struct Tile {
   // Indicates the special functions of the Tile pins.
   // Usually it is related to IOB blocks and indicates
   // i.e. differential output pins.
-  absl::flat_hash_map<std::string, std::string> pin_functions;
+  absl::flat_hash_map<Symbol, Symbol> pin_functions;
 
   // Maps <site-name> to <site-type>.
-  absl::flat_hash_map<std::string, std::string> sites;
+  absl::flat_hash_map<Symbol, Symbol> sites;
 
   // Which sites not to use in the tile.
-  std::vector<std::string> prohibited_sites;
+  std::vector<Symbol> prohibited_sites;
 };
 
 using TileGrid = absl::flat_hash_map<std::string, Tile>;
@@ -106,11 +111,11 @@ struct TileFeature {
 using SegmentsBits = absl::flat_hash_map<TileFeature, std::vector<SegmentBit>>;
 
 struct PackagePin {
-  std::string pin;
+  Symbol pin;
   uint32_t bank;
-  std::string site;
-  std::string tile;
-  std::string pin_function;
+  Symbol site;
+  Symbol tile;
+  Symbol pin_function;
 };
 
 using PackagePins = std::vector<PackagePin>;
@@ -169,5 +174,29 @@ absl::StatusOr<absl::flat_hash_map<std::string, PartInfo>> ParsePartsInfos(
   std::string_view parts_mapper_yaml, std::string_view devices_mapper_yaml);
 
 absl::StatusOr<TileGrid> ParseTileGridJSON(std::string_view content);
+
+// Parse the JSON object of a single tile of tilegrid.json. "name" is only
+// used in errors.
+absl::StatusOr<Tile> ParseTileJSON(std::string_view name,
+                                   std::string_view content);
+
+// Where the tiles are in tilegrid.json, found by a scan over the JSON
+// structure that does not decode the tiles.
+struct TileGridJSONIndex {
+  struct Entry {
+    std::string_view name;
+    // The tile object, to be decoded with ParseTileJSON().
+    std::string_view json;
+    // Its "grid_x" and "grid_y" members.
+    Location coord = {};
+  };
+  std::vector<Entry> tiles;
+  // The values of all "type" members of the tiles, i.e. the tile types and
+  // the alias tile types.
+  absl::flat_hash_set<std::string_view> types;
+};
+
+// Index the tiles of "content". The views in the index point into it.
+absl::StatusOr<TileGridJSONIndex> IndexTileGridJSON(std::string_view content);
 }  // namespace fpga
 #endif  // FPGA_DATABASE_PARSERS_H
@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "fpga/database-parsers.h"
+#include "fpga/memory-mapped-file.h"
+
+// Measures the throughput of the tilegrid, segbits and pseudo PIPs database
+// parsers. If PRJXRAY_DB_PATH points to a family directory of prjxray-db,
+// e.g. ".../prjxray-db/artix7", the tilegrid.json of its largest fabric and
+// all of its database files are parsed; otherwise synthetic ones with the
+// same structure are used.
+namespace {
+// Concatenation of the database files named <prefix>*.db in the family
+// directory, or "fallback" if there are none.
+std::string DatabaseContent(std::string_view prefix,
+                            const std::string &fallback) {
+  const char *const db_path = getenv("PRJXRAY_DB_PATH");
+  if (db_path == nullptr) {
+    return fallback;
+  }
+  std::string content;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(db_path, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (!absl::StartsWith(name, prefix) || !absl::EndsWith(name, ".db")) {
+      continue;
+    }
+    const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> file =
+      fpga::MemoryMapFile(entry.path());
+    if (file.ok()) {
+      content.append(file.value()->AsStringView());
+      content.append("\n");
+    }
+  }
+  return content.empty() ? fallback : content;
+}
+
+// The largest <fabric>/tilegrid.json of the family directory, or "fallback"
+// if there is none.
+std::string LargestTileGridContent(const std::string &fallback) {
+  const char *const db_path = getenv("PRJXRAY_DB_PATH");
+  if (db_path == nullptr) {
+    return fallback;
+  }
+  std::filesystem::path largest;
+  uintmax_t largest_size = 0;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(db_path, ec)) {
+    const std::filesystem::path tilegrid = entry.path() / "tilegrid.json";
+    const uintmax_t size = std::filesystem::file_size(tilegrid, ec);
+    if (!ec && size > largest_size) {
+      largest = tilegrid;
+      largest_size = size;
+    }
+  }
+  if (largest.empty()) {
+    return fallback;
+  }
+  const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> file =
+    fpga::MemoryMapFile(largest);
+  if (!file.ok()) {
+    return fallback;
+  }
+  return std::string(file.value()->AsStringView());
+}
+
+// A grid of CLB tiles shaped like the ones in tilegrid.json.
+const std::string &TileGridContent() {
+  static const std::string content = [] {
+    std::string result = "{";
+    char buf[512];
+    for (int x = 0; x < 200; ++x) {
+      for (int y = 0; y < 300; ++y) {
+        snprintf(buf, sizeof(buf), R"(%s
+  "CLBLL_L_X%dY%d": {
+    "bits": {
+      "CLB_IO_CLK": {
+        "baseaddr": "0x%08X",
+        "frames": 36,
+        "offset": %d,
+        "words": 2
+      }
+    },
+    "clock_region": "X%dY%d",
+    "grid_x": %d,
+    "grid_y": %d,
+    "pin_functions": {},
+    "prohibited_sites": [],
+    "sites": {
+      "SLICE_X%dY%d": "SLICEL",
+      "SLICE_X%dY%d": "SLICEL"
+    },
+    "type": "CLBLL_L"
+  })",
+                 x + y == 0 ? "" : ",", x, y, x << 7, (y % 50) * 2, x / 50,
+                 y / 50, x, y, 2 * x, y, 2 * x + 1, y);
+        result += buf;
+      }
+    }
+    result += "\n}\n";
+    return LargestTileGridContent(result);
+  }();
+  return content;
+}
+
+// Lines like "CLBLM_L.SLICEM_X0.ALUT.INIT[12] 31_14 !30_2", 1 to 6 bits each.
+const std::string &SegbitsContent() {
+  static const std::string content = [] {
+    std::mt19937_64 rnd(42);
+    std::string result;
+    char buf[64];
+    for (int i = 0; i < 100'000; ++i) {
+      snprintf(buf, sizeof(buf), "CLBLM_L.SLICEM_X%d.F%d.INIT[%d]",
+               int(rnd() % 2), int(rnd() % 5000), int(rnd() % 64));
+      result += buf;
+      for (int b = rnd() % 6; b >= 0; --b) {
+        snprintf(buf, sizeof(buf), " %s%d_%d", rnd() % 4 == 0 ? "!" : "",
+                 int(rnd() % 36), int(rnd() % 64));
+        result += buf;
+      }
+      result += "\n";
+    }
+    return DatabaseContent("segbits_", result);
+  }();
+  return content;
+}
+
+// Lines like "INT_L.EE2BEG0.LOGIC_OUTS_L12 always".
+const std::string &PseudoPIPsContent() {
+  static const std::string content = [] {
+    std::mt19937_64 rnd(42);
+    constexpr const char *kTypes[] = {"always", "default", "hint"};
+    std::string result;
+    char buf[96];
+    for (int i = 0; i < 100'000; ++i) {
+      snprintf(buf, sizeof(buf), "INT_L.EE2BEG%d.LOGIC_OUTS_L%d %s\n", i,
+               int(rnd() % 24), kTypes[rnd() % 3]);
+      result += buf;
+    }
+    return DatabaseContent("ppips_", result);
+  }();
+  return content;
+}
+
+void BM_ParseTileGridJSON(benchmark::State &state) {
+  const std::string &content = TileGridContent();
+  for (auto _ : state) {
+    absl::StatusOr<fpga::TileGrid> tilegrid = fpga::ParseTileGridJSON(content);
+    benchmark::DoNotOptimize(tilegrid);
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_ParseTileGridJSON);
+
+void BM_ParseSegmentsBitsDatabase(benchmark::State &state) {
+  const std::string &content = SegbitsContent();
+  for (auto _ : state) {
+    absl::StatusOr<fpga::SegmentsBits> segbits =
+      fpga::ParseSegmentsBitsDatabase(content);
+    benchmark::DoNotOptimize(segbits);
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_ParseSegmentsBitsDatabase);
+
+void BM_ParsePseudoPIPsDatabase(benchmark::State &state) {
+  const std::string &content = PseudoPIPsContent();
+  for (auto _ : state) {
+    absl::StatusOr<fpga::PseudoPIPs> pips =
+      fpga::ParsePseudoPIPsDatabase(content);
+    benchmark::DoNotOptimize(pips);
+  }
+  state.SetBytesProcessed(state.iterations() * content.size());
+}
+BENCHMARK(BM_ParsePseudoPIPsDatabase);
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -4,7 +4,9 @@
 #include <string_view>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -90,8 +92,8 @@ TEST(TileGridParser, SampleTileGrid) {
   const Tile &tile_b = tile_grid.at("TILE_B");
   EXPECT_EQ(tile_b.bits.contains(ConfigBusType::kCLBIOCLK), 1);
   EXPECT_EQ(tile_b.pin_functions.size(), 1);
-  EXPECT_EQ(tile_b.pin_functions.count("IOB_X0Y0"), 1);
-  EXPECT_EQ(tile_b.pin_functions.at("IOB_X0Y0"), "IO_25_14");
+  EXPECT_EQ(tile_b.pin_functions.count(Symbol("IOB_X0Y0")), 1);
+  EXPECT_EQ(tile_b.pin_functions.at(Symbol("IOB_X0Y0")), "IO_25_14");
 
   const BitsBlock &block = tile_b.bits.at(ConfigBusType::kCLBIOCLK);
   ASSERT_TRUE(block.alias.has_value());
@@ -119,6 +121,90 @@ TEST(TileGridParser, EmptyTileGrid) {
   }
 }
 
+TEST(TileGridParser, SkipsUnknownMembers) {
+  constexpr std::string_view kTileGrid = R"({
+  "TILE_A": {
+    "bits": {
+      "CLB_IO_CLK": {
+        "baseaddr": "0x00020E00",
+        "frames": 26,
+        "offset": -2,
+        "unknown": [{"a": [1, 2.5, null]}, true],
+        "words": 1
+      }
+    },
+    "grid_x": 72,
+    "grid_y": 26,
+    "pin_functions": {},
+    "prohibited_sites": ["SLICE_X0Y0"],
+    "sites": {"SLICE_X0Y0": "SLICEL"},
+    "type": "CLBLL_L",
+    "unknown": {"nested": {"object": "value"}}
+  }
+})";
+  const absl::StatusOr<TileGrid> tile_grid = ParseTileGridJSON(kTileGrid);
+  ASSERT_TRUE(tile_grid.ok()) << tile_grid.status();
+  const Tile &tile = tile_grid->at("TILE_A");
+  EXPECT_EQ(tile.type, "CLBLL_L");
+  EXPECT_FALSE(tile.clock_region.has_value());
+  EXPECT_EQ(tile.sites.at(Symbol("SLICE_X0Y0")), "SLICEL");
+  ASSERT_EQ(tile.prohibited_sites.size(), 1);
+  const BitsBlock &block = tile.bits.at(ConfigBusType::kCLBIOCLK);
+  EXPECT_FALSE(block.alias.has_value());
+  EXPECT_EQ(block.base_address, 0x20E00);
+  EXPECT_EQ(block.frames, 26);
+  EXPECT_EQ(block.offset, -2);
+  EXPECT_EQ(block.words, 1);
+}
+
+TEST(TileGridParser, InvalidTileNamesTile) {
+  constexpr std::string_view kTileGrids[] = {
+    R"({"TILE_A": 1})",
+    R"({"TILE_A": {"bits": {}, "grid_x": "72", "grid_y": 26,
+                   "pin_functions": {}, "prohibited_sites": [], "sites": {},
+                   "type": "T"}})",
+    R"({"TILE_A": {"bits": {}, "grid_x": 72, "grid_y": 26,
+                   "pin_functions": {"A": 1}, "prohibited_sites": [],
+                   "sites": {}, "type": "T"}})",
+    R"({"TILE_A": {"bits": {"UNKNOWN_BUS": {}}, "grid_x": 72, "grid_y": 26,
+                   "pin_functions": {}, "prohibited_sites": [], "sites": {},
+                   "type": "T"}})",
+    R"({"TILE_A": {"bits": {"CLB_IO_CLK": {"baseaddr": "0x0", "frames": 1,
+                                           "offset": 0}},
+                   "grid_x": 72, "grid_y": 26, "pin_functions": {},
+                   "prohibited_sites": [], "sites": {}, "type": "T"}})",
+  };
+  for (const std::string_view tile_grid : kTileGrids) {
+    const absl::StatusOr<TileGrid> result = ParseTileGridJSON(tile_grid);
+    ASSERT_FALSE(result.ok()) << tile_grid;
+    EXPECT_TRUE(absl::StrContains(result.status().message(), "TILE_A"))
+      << result.status();
+  }
+}
+
+TEST(TileGridParser, IndexedTilesDecodeLikeTheGrid) {
+  const absl::StatusOr<TileGridJSONIndex> index =
+    IndexTileGridJSON(kSampleTileGridJSON);
+  ASSERT_TRUE(index.ok()) << index.status();
+  ASSERT_EQ(index->tiles.size(), 2);
+  EXPECT_EQ(index->tiles[1].name, "TILE_B");
+  EXPECT_EQ(index->types,
+            (absl::flat_hash_set<std::string_view>{
+              "HCLK_L_BOT_UTURN", "HCLK_L", "LIOB33_SING", "LIOB33"}));
+
+  const absl::StatusOr<Tile> tile =
+    ParseTileJSON(index->tiles[1].name, index->tiles[1].json);
+  ASSERT_TRUE(tile.ok()) << tile.status();
+  EXPECT_EQ(tile->type, "LIOB33_SING");
+  EXPECT_EQ(tile->pin_functions.at(Symbol("IOB_X0Y0")), "IO_25_14");
+  EXPECT_EQ(index->tiles[1].coord.x, tile->coord.x);
+  EXPECT_EQ(index->tiles[1].coord.y, tile->coord.y);
+
+  const absl::StatusOr<Tile> invalid = ParseTileJSON("TILE_C", R"({"a": 1})");
+  ASSERT_FALSE(invalid.ok());
+  EXPECT_TRUE(absl::StrContains(invalid.status().message(), "TILE_C"));
+}
+
 struct PseudoPIPsParserTestCase {
   std::string_view db;
   PseudoPIPs expected_ppips;
@@ -143,6 +229,8 @@ TEST(PseudoPIPsParser, CanParseSimpleDatabases) {
     {.db = "P hint",
      .expected_ppips = {{"P", PseudoPIPType::kHint}},
      .expected_success = true},
+    {.db = "P always hint", .expected_ppips = {}, .expected_success = false},
+    {.db = "P sometimes", .expected_ppips = {}, .expected_success = false},
     {.db = "P  always   \n  A   default \n",
      .expected_ppips = {{"P", PseudoPIPType::kAlways},
                         {"A", PseudoPIPType::kDefault}},
@@ -190,6 +278,14 @@ TEST(SegmentsBitsParser, CanParseSimpleDatabases) {
     {"BAR[1] !1_23", {{{"BAR", 1}, {{1, 23, false}}}}, true},
     {"BAR[002] !1_23", {{{"BAR", 2}, {{1, 23, false}}}}, true},
     {"BAR[200] !1_23", {{{"BAR", 200}, {{1, 23, false}}}}, true},
+    {"BAR[x] 1_23", {{{"BAR[x]", 0}, {{1, 23, true}}}}, true},
+    {"BAR\t1_23\r\n", {{{"BAR", 0}, {{1, 23, true}}}}, true},
+    {"BAR", {}, false},
+    {"BAR 1_2_3", {}, false},
+    {"BAR 1_", {}, false},
+    {"BAR !_1", {}, false},
+    {"BAR x_1", {}, false},
+    {"BAR 1_99999999999", {}, false},
   };
   for (const auto &test : kTestCases) {
     const absl::StatusOr<SegmentsBits> res = ParseSegmentsBitsDatabase(test.db);
@@ -232,7 +328,8 @@ TEST(PackagePinsParser, CanParseSimpleDatabases) {
   const struct PackagePinsParserTestCase kTestCases[] = {
     {"pin,bank,site,tile,pin_function\nA1,35,IOB_X1Y81,RIOB33_X43Y81,IO_L9N_T1_"
      "DQS_AD7N_35",
-     {{"A1", 35, "IOB_X1Y81", "RIOB33_X43Y81", "IO_L9N_T1_DQS_AD7N_35"}},
+     {{Symbol("A1"), 35, Symbol("IOB_X1Y81"), Symbol("RIOB33_X43Y81"),
+       Symbol("IO_L9N_T1_DQS_AD7N_35")}},
      true},
     // Missing header.
     {
@@ -252,8 +349,10 @@ TEST(PackagePinsParser, CanParseSimpleDatabases) {
       "A1,35,IOB_X1Y81,RIOB33_X43Y81,  IO_L9N_T1_DQS_AD7N_35\n"
       "\n"
       "N6,  34,IOB_X1Y13,RIOB33_X43Y13,IO_L18N_T2_34\n",
-      {{"A1", 35, "IOB_X1Y81", "RIOB33_X43Y81", "IO_L9N_T1_DQS_AD7N_35"},
-       {"N6", 34, "IOB_X1Y13", "RIOB33_X43Y13", "IO_L18N_T2_34"}},
+      {{Symbol("A1"), 35, Symbol("IOB_X1Y81"), Symbol("RIOB33_X43Y81"),
+        Symbol("IO_L9N_T1_DQS_AD7N_35")},
+       {Symbol("N6"), 34, Symbol("IOB_X1Y13"), Symbol("RIOB33_X43Y13"),
+        Symbol("IO_L18N_T2_34")}},
       true,
     }};
   for (const auto &test : kTestCases) {
@@ -0,0 +1,618 @@
+#include "fpga/database-snapshot.h"
+
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/memory-mapped-file.h"
+#include "fpga/packed-segments-bits.h"
+#include "fpga/symbol-table.h"
+
+namespace fpga {
+namespace {
+// File layout, all integers little endian:
+//   magic, u32 version, u64 checksum of everything that follows, fingerprint,
+//   u32 source count, sources as (path, u64 mtime, u64 size), u64 payload
+//   size, payload.
+constexpr std::string_view kMagic = "FASMSNP1";
+// To be incremented whenever the encoding of any structure changes.
+constexpr uint32_t kVersion = 3;
+// Magic, version and checksum.
+constexpr size_t kHeaderSize = 8 + 4 + 8;
+
+// Only meant to catch corruption, so it goes a little endian word at a
+// time. Continues from "hash" to checksum data in
+// pieces; the pieces must be the same when writing and checking.
+uint64_t Checksum(std::string_view data, uint64_t hash = 0xcbf29ce484222325) {
+  constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15;
+  const auto *bytes = reinterpret_cast<const uint8_t *>(data.data());
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t word = 0;
+    for (int b = 7; b >= 0; --b) {
+      word = (word << 8) | bytes[i + b];
+    }
+    hash = std::rotl((hash ^ word) * kMultiplier, 31);
+  }
+  for (; i < data.size(); ++i) {
+    hash = (hash ^ bytes[i]) * kMultiplier;
+  }
+  return hash;
+}
+
+// Symbols are stored as their strings.
+void WriteSymbolMap(const absl::flat_hash_map<Symbol, Symbol> &map,
+                    SnapshotWriter &out) {
+  out.U32(map.size());
+  for (const auto &[key, value] : map) {
+    out.String(key.str());
+    out.String(value.str());
+  }
+}
+
+bool ReadSymbolMap(SnapshotReader &in,
+                   absl::flat_hash_map<Symbol, Symbol> &map) {
+  const uint32_t count = in.U32();
+  if (!in.Fits(count, 8)) {
+    return false;
+  }
+  map.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const std::string_view key = in.String();
+    map.emplace(key, in.String());
+  }
+  return in.ok();
+}
+
+void WriteBitsBlock(const BitsBlock &block, SnapshotWriter &out) {
+  out.U8(block.alias.has_value());
+  if (block.alias.has_value()) {
+    WriteSymbolMap(block.alias->sites, out);
+    out.U32(block.alias->start_offset);
+    out.String(block.alias->type.str());
+  }
+  out.U64(block.base_address);
+  out.U32(block.frames);
+  out.U32(static_cast<uint32_t>(block.offset));
+  out.U32(block.words);
+}
+
+bool ReadBitsBlock(SnapshotReader &in, BitsBlock &block) {
+  if (in.U8()) {
+    BitsBlockAlias &alias = block.alias.emplace();
+    if (!ReadSymbolMap(in, alias.sites)) {
+      return false;
+    }
+    alias.start_offset = in.U32();
+    alias.type = Symbol(in.String());
+  }
+  block.base_address = in.U64();
+  block.frames = in.U32();
+  block.offset = static_cast<int32_t>(in.U32());
+  block.words = in.U32();
+  return in.ok();
+}
+
+void WriteTile(const Tile &tile, SnapshotWriter &out) {
+  out.String(tile.type.str());
+  out.U32(tile.coord.x);
+  out.U32(tile.coord.y);
+  out.U8(tile.clock_region.has_value());
+  if (tile.clock_region.has_value()) {
+    out.String(tile.clock_region->str());
+  }
+  out.U32(tile.bits.size());
+  for (const auto &[bus, block] : tile.bits) {
+    out.U32(static_cast<uint32_t>(bus));
+    WriteBitsBlock(block, out);
+  }
+  WriteSymbolMap(tile.pin_functions, out);
+  WriteSymbolMap(tile.sites, out);
+  out.U32(tile.prohibited_sites.size());
+  for (const Symbol site : tile.prohibited_sites) {
+    out.String(site.str());
+  }
+}
+
+bool ReadTile(SnapshotReader &in, Tile &tile) {
+  tile.type = Symbol(in.String());
+  tile.coord.x = in.U32();
+  tile.coord.y = in.U32();
+  if (in.U8()) {
+    tile.clock_region = Symbol(in.String());
+  }
+  const uint32_t bits_count = in.U32();
+  for (uint32_t i = 0; i < bits_count && in.ok(); ++i) {
+    const auto bus = static_cast<ConfigBusType>(in.U32());
+    if (!ReadBitsBlock(in, tile.bits[bus])) {
+      return false;
+    }
+  }
+  if (!ReadSymbolMap(in, tile.pin_functions) ||
+      !ReadSymbolMap(in, tile.sites)) {
+    return false;
+  }
+  const uint32_t prohibited_count = in.U32();
+  if (!in.Fits(prohibited_count, 4)) {
+    return false;
+  }
+  tile.prohibited_sites.reserve(prohibited_count);
+  for (uint32_t i = 0; i < prohibited_count; ++i) {
+    tile.prohibited_sites.emplace_back(in.String());
+  }
+  return in.ok();
+}
+
+// Decodes a tile as written by WriteTile().
+absl::StatusOr<Tile> DecodeTile(std::string_view name,
+                                std::string_view encoded) {
+  SnapshotReader in(encoded);
+  Tile tile;
+  if (!ReadTile(in, tile)) {
+    return absl::DataLossError(absl::StrFormat(
+      "tile \"%s\" of the database snapshot cannot be decoded", name));
+  }
+  return tile;
+}
+
+void WriteClockRegionHalf(const GlobalClockRegionHalf &half,
+                          SnapshotWriter &out) {
+  out.U32(half.size());
+  for (const ClockRegionRow &row : half) {
+    out.U32(row.size());
+    for (const auto &[bus, columns] : row) {
+      out.U32(static_cast<uint32_t>(bus));
+      out.U32(columns.size());
+      for (const uint32_t frames : columns) {
+        out.U32(frames);
+      }
+    }
+  }
+}
+
+bool ReadClockRegionHalf(SnapshotReader &in, GlobalClockRegionHalf &half) {
+  const uint32_t row_count = in.U32();
+  if (!in.Fits(row_count, 4)) {
+    return false;
+  }
+  half.resize(row_count);
+  for (ClockRegionRow &row : half) {
+    const uint32_t bus_count = in.U32();
+    for (uint32_t i = 0; i < bus_count && in.ok(); ++i) {
+      const auto bus = static_cast<ConfigBusType>(in.U32());
+      const uint32_t column_count = in.U32();
+      if (!in.Fits(column_count, 4)) {
+        return false;
+      }
+      ConfigColumnsFramesCount &columns = row[bus];
+      columns.reserve(column_count);
+      for (uint32_t c = 0; c < column_count; ++c) {
+        columns.push_back(in.U32());
+      }
+    }
+  }
+  return in.ok();
+}
+}  // namespace
+
+void SnapshotWriter::U32(uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    data_.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void SnapshotWriter::U64(uint64_t value) {
+  U32(static_cast<uint32_t>(value));
+  U32(static_cast<uint32_t>(value >> 32));
+}
+
+void SnapshotWriter::String(std::string_view value) {
+  U32(value.size());
+  data_.append(value);
+}
+
+uint8_t SnapshotReader::U8() {
+  if (!Consume(1)) {
+    return 0;
+  }
+  const uint8_t value = data_[0];
+  data_.remove_prefix(1);
+  return value;
+}
+
+uint32_t SnapshotReader::U32() {
+  uint32_t value = 0;
+  if (!Consume(4)) {
+    return 0;
+  }
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | static_cast<uint8_t>(data_[i]);
+  }
+  data_.remove_prefix(4);
+  return value;
+}
+
+uint64_t SnapshotReader::U64() {
+  const uint64_t low = U32();
+  return low | (uint64_t(U32()) << 32);
+}
+
+std::string_view SnapshotReader::String() { return Bytes(U32()); }
+
+std::string_view SnapshotReader::Bytes(size_t size) {
+  if (!Consume(size)) {
+    return {};
+  }
+  const std::string_view value = data_.substr(0, size);
+  data_.remove_prefix(size);
+  return value;
+}
+
+void WritePart(const Part &part, SnapshotWriter &out) {
+  WriteClockRegionHalf(part.global_clock_regions.bottom_rows, out);
+  WriteClockRegionHalf(part.global_clock_regions.top_rows, out);
+  out.U32(part.idcode);
+  out.U32(part.iobanks.size());
+  for (const auto &[bank, location] : part.iobanks) {
+    out.U32(bank);
+    out.String(location);
+  }
+}
+
+bool ReadPart(SnapshotReader &in, Part &part) {
+  if (!ReadClockRegionHalf(in, part.global_clock_regions.bottom_rows) ||
+      !ReadClockRegionHalf(in, part.global_clock_regions.top_rows)) {
+    return false;
+  }
+  part.idcode = in.U32();
+  const uint32_t bank_count = in.U32();
+  if (!in.Fits(bank_count, 8)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < bank_count; ++i) {
+    const uint32_t bank = in.U32();
+    part.iobanks.emplace(bank, in.String());
+  }
+  return in.ok();
+}
+
+// The tiles are a table of fixed size rows, followed by the names and the
+// encoded tiles the rows point to, so that they are read in place:
+//   u32 tile count, u32 tile type count, tile types, per tile (u32 x, u32 y,
+//   u32 name offset, u32 name size, u32 tile offset, u32 tile size), u64 data
+//   size, data. Offsets are relative to the start of the data.
+absl::Status WriteTileGrid(const LazyTileGrid &grid, SnapshotWriter &out) {
+  SnapshotWriter table;
+  SnapshotWriter data;
+  absl::flat_hash_set<Symbol> tile_types;
+  const absl::Status status =
+    grid.ForEach([&](const std::string &name, const Tile &tile) {
+      tile_types.insert(tile.type);
+      for (const auto &[bus, block] : tile.bits) {
+        if (block.alias.has_value()) {
+          tile_types.insert(block.alias->type);
+        }
+      }
+      table.U32(tile.coord.x);
+      table.U32(tile.coord.y);
+      table.U32(data.data().size());
+      table.U32(name.size());
+      data.Bytes(name);
+      const size_t tile_offset = data.data().size();
+      WriteTile(tile, data);
+      table.U32(tile_offset);
+      table.U32(data.data().size() - tile_offset);
+    });
+  if (!status.ok()) {
+    return status;
+  }
+  if (data.data().size() > std::numeric_limits<uint32_t>::max()) {
+    return absl::ResourceExhaustedError("too many tiles for a snapshot");
+  }
+  out.U32(grid.size());
+  out.U32(tile_types.size());
+  for (const Symbol tile_type : tile_types) {
+    out.String(tile_type.str());
+  }
+  out.Bytes(table.data());
+  out.U64(data.data().size());
+  out.Bytes(data.data());
+  return absl::OkStatus();
+}
+
+bool ReadTileGrid(SnapshotReader &in, std::shared_ptr<const MemoryBlock> file,
+                  LazyTileGrid &grid) {
+  // Coordinates, name and tile offsets and sizes.
+  constexpr size_t kRowSize = 6 * 4;
+  const uint32_t count = in.U32();
+  const uint32_t tile_type_count = in.U32();
+  if (!in.Fits(tile_type_count, 4)) {
+    return false;
+  }
+  absl::flat_hash_set<Symbol> tile_types;
+  tile_types.reserve(tile_type_count);
+  for (uint32_t i = 0; i < tile_type_count; ++i) {
+    tile_types.emplace(in.String());
+  }
+  if (!in.Fits(count, kRowSize)) {
+    return false;
+  }
+  SnapshotReader table(in.Bytes(count * kRowSize));
+  const std::string_view data = in.Bytes(in.U64());
+  if (!in.ok()) {
+    return false;
+  }
+  const auto in_data = [&data](uint32_t offset, uint32_t size) {
+    return offset <= data.size() && size <= data.size() - offset;
+  };
+  std::vector<LazyTileGrid::EncodedTile> tiles(count);
+  for (LazyTileGrid::EncodedTile &tile : tiles) {
+    tile.coord.x = table.U32();
+    tile.coord.y = table.U32();
+    const uint32_t name_offset = table.U32();
+    const uint32_t name_size = table.U32();
+    const uint32_t tile_offset = table.U32();
+    const uint32_t tile_size = table.U32();
+    if (!in_data(name_offset, name_size) || !in_data(tile_offset, tile_size)) {
+      return false;
+    }
+    tile.name = data.substr(name_offset, name_size);
+    tile.encoded = data.substr(tile_offset, tile_size);
+  }
+  grid = LazyTileGrid::FromEncoded(std::move(file), tiles,
+                                   std::move(tile_types), DecodeTile);
+  return true;
+}
+
+void WritePseudoPIPs(const PseudoPIPs &pips, SnapshotWriter &out) {
+  out.U32(pips.size());
+  for (const auto &[name, type] : pips) {
+    out.String(name);
+    out.U8(static_cast<uint8_t>(type));
+  }
+}
+
+bool ReadPseudoPIPs(SnapshotReader &in, PseudoPIPs &pips) {
+  const uint32_t count = in.U32();
+  if (!in.Fits(count, 5)) {
+    return false;
+  }
+  pips.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const std::string_view name = in.String();
+    pips.emplace(name, static_cast<PseudoPIPType>(in.U8()));
+  }
+  return in.ok();
+}
+
+void WriteSegmentsBits(const PackedSegmentsBits &segbits,
+                       SnapshotWriter &out) {
+  out.U32(segbits.size());
+  for (size_t i = 0; i < segbits.size(); ++i) {
+    const PackedSegmentsBits::Feature feature = segbits.feature(i);
+    out.String(feature.tile_feature);
+    out.U32(feature.address);
+    out.U32(feature.bits.size());
+    for (const PackedSegmentBit bit : feature.bits) {
+      out.U32(bit.word_column());
+      out.U32(bit.word_bit());
+      out.U8(bit.is_set());
+    }
+  }
+}
+
+bool ReadSegmentsBits(SnapshotReader &in, PackedSegmentsBits &segbits) {
+  const uint32_t count = in.U32();
+  if (!in.Fits(count, 12)) {
+    return false;
+  }
+  PackedSegmentsBitsBuilder builder;
+  std::vector<SegmentBit> bits;
+  for (uint32_t i = 0; i < count; ++i) {
+    const std::string_view tile_feature = in.String();
+    const uint32_t address = in.U32();
+    const uint32_t bit_count = in.U32();
+    if (!in.Fits(bit_count, 9)) {
+      return false;
+    }
+    bits.clear();
+    for (uint32_t b = 0; b < bit_count; ++b) {
+      SegmentBit bit;
+      bit.word_column = in.U32();
+      bit.word_bit = in.U32();
+      bit.is_set = in.U8();
+      bits.push_back(bit);
+    }
+    if (!builder.Add(tile_feature, address, bits).ok()) {
+      return false;
+    }
+  }
+  segbits = std::move(builder).Build();
+  return in.ok();
+}
+
+absl::StatusOr<SnapshotSource> StatSnapshotSource(std::string path) {
+  std::error_code ec;
+  const std::filesystem::file_time_type mtime =
+    std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot stat \"%s\": %s", path, ec.message()));
+  }
+  uint64_t size = 0;
+  if (std::filesystem::is_regular_file(path, ec)) {
+    size = std::filesystem::file_size(path, ec);
+  }
+  if (ec) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot stat \"%s\": %s", path, ec.message()));
+  }
+  const int64_t mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             mtime.time_since_epoch())
+                             .count();
+  return SnapshotSource{std::move(path), mtime_ns, size};
+}
+
+absl::StatusOr<std::vector<SnapshotSource>> StatSnapshotSources(
+  const std::vector<std::string> &paths) {
+  std::vector<SnapshotSource> sources;
+  sources.reserve(paths.size());
+  for (const std::string &path : paths) {
+    absl::StatusOr<SnapshotSource> source = StatSnapshotSource(path);
+    if (!source.ok()) {
+      return source.status();
+    }
+    sources.push_back(std::move(source.value()));
+  }
+  return sources;
+}
+
+absl::Status CheckSnapshotSources(std::string_view path,
+                                  const std::vector<SnapshotSource> &sources) {
+  for (const SnapshotSource &expected : sources) {
+    const absl::StatusOr<SnapshotSource> source =
+      StatSnapshotSource(expected.path);
+    if (!source.ok() || source->mtime_ns != expected.mtime_ns ||
+        source->size != expected.size) {
+      return absl::FailedPreconditionError(absl::StrFormat(
+        "\"%s\" is stale, \"%s\" changed", path, expected.path));
+    }
+  }
+  return absl::OkStatus();
+}
+
+void WriteSnapshotSources(const std::vector<SnapshotSource> &sources,
+                          SnapshotWriter &out) {
+  out.U32(sources.size());
+  for (const SnapshotSource &source : sources) {
+    out.String(source.path);
+    out.U64(static_cast<uint64_t>(source.mtime_ns));
+    out.U64(source.size);
+  }
+}
+
+bool ReadSnapshotSources(SnapshotReader &in,
+                         std::vector<SnapshotSource> &sources) {
+  const uint32_t count = in.U32();
+  // Path size, mtime and size.
+  if (!in.Fits(count, 4 + 8 + 8)) {
+    return false;
+  }
+  sources.reserve(count);
+  for (uint32_t i = 0; i < count && in.ok(); ++i) {
+    SnapshotSource &source = sources.emplace_back();
+    source.path = in.String();
+    source.mtime_ns = static_cast<int64_t>(in.U64());
+    source.size = in.U64();
+  }
+  return in.ok();
+}
+
+absl::Status WriteSnapshotFile(std::string_view path,
+                               std::string_view fingerprint,
+                               const std::vector<SnapshotSource> &sources,
+                               std::string_view payload) {
+  SnapshotWriter body;
+  body.String(fingerprint);
+  WriteSnapshotSources(sources, body);
+  body.U64(payload.size());
+  SnapshotWriter header;
+  header.Bytes(kMagic);
+  header.U32(kVersion);
+  header.U64(Checksum(payload, Checksum(body.data())));
+
+  // Write next to the destination and move in place, so that concurrent runs
+  // never map a partially written snapshot.
+  const std::string tmp_path = absl::StrFormat("%s.tmp", path);
+  std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot open \"%s\" for writing", tmp_path));
+  }
+  file.write(header.data().data(), header.data().size());
+  file.write(body.data().data(), body.data().size());
+  file.write(payload.data(), payload.size());
+  file.close();
+  if (file.fail()) {
+    return absl::InternalError(
+      absl::StrFormat("failed writing \"%s\"", tmp_path));
+  }
+  if (std::rename(tmp_path.c_str(), std::string(path).c_str()) != 0) {
+    return absl::ErrnoToStatus(
+      errno, absl::StrFormat("cannot rename \"%s\"", tmp_path));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<SnapshotFile> OpenSnapshotFile(std::string_view path,
+                                              std::string_view fingerprint,
+                                              bool verify_checksum) {
+  absl::StatusOr<std::unique_ptr<MemoryBlock>> content = MemoryMapFile(path);
+  if (!content.ok()) {
+    return content.status();
+  }
+  const std::string_view data = content.value()->AsStringView();
+  SnapshotReader header(data);
+  if (header.Bytes(kMagic.size()) != kMagic) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("\"%s\" is not a database snapshot", path));
+  }
+  if (header.U32() != kVersion) {
+    return absl::FailedPreconditionError(
+      absl::StrFormat("\"%s\" was written by another version", path));
+  }
+  const uint64_t checksum = header.U64();
+  if (!header.ok()) {
+    return absl::DataLossError(
+      absl::StrFormat("database snapshot \"%s\" is truncated", path));
+  }
+  SnapshotReader body(data.substr(kHeaderSize));
+  if (body.String() != fingerprint) {
+    return absl::FailedPreconditionError(absl::StrFormat(
+      "\"%s\" was written for another database or part", path));
+  }
+  std::vector<SnapshotSource> sources;
+  ReadSnapshotSources(body, sources);
+  const uint64_t payload_size = body.U64();
+  const std::string_view payload = body.Bytes(payload_size);
+  if (!body.ok()) {
+    return absl::DataLossError(
+      absl::StrFormat("database snapshot \"%s\" is truncated", path));
+  }
+  // Cheaper than the checksum, so a stale snapshot is rejected without
+  // reading it all.
+  if (absl::Status status = CheckSnapshotSources(path, sources);
+      !status.ok()) {
+    return status;
+  }
+  const size_t body_size = payload.data() - data.data() - kHeaderSize;
+  if (verify_checksum &&
+      Checksum(payload, Checksum(data.substr(kHeaderSize, body_size))) !=
+        checksum) {
+    return absl::DataLossError(
+      absl::StrFormat("database snapshot \"%s\" is corrupt", path));
+  }
+  return SnapshotFile{std::move(content.value()), payload, std::move(sources)};
+}
+}  // namespace fpga
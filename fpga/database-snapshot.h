@@ -0,0 +1,130 @@
+#ifndef FPGA_DATABASE_SNAPSHOT_H
+#define FPGA_DATABASE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/memory-mapped-file.h"
+#include "fpga/packed-segments-bits.h"
+
+namespace fpga {
+// Appends values, integers in little endian, to a buffer.
+class SnapshotWriter {
+ public:
+  void U8(uint8_t value) { data_.push_back(static_cast<char>(value)); }
+  void U32(uint32_t value);
+  void U64(uint64_t value);
+  void String(std::string_view value);
+  void Bytes(std::string_view value) { data_.append(value); }
+
+  const std::string &data() const { return data_; }
+
+ private:
+  std::string data_;
+};
+
+// Consumes values written by SnapshotWriter from the front of a buffer; any
+// read past the end makes ok() false and returns zeros from then on.
+class SnapshotReader {
+ public:
+  explicit SnapshotReader(std::string_view data) : data_(data) {}
+
+  bool ok() const { return ok_; }
+
+  uint8_t U8();
+  uint32_t U32();
+  uint64_t U64();
+  std::string_view String();
+  std::string_view Bytes(size_t size);
+
+  // Whether at least "count" elements of at least "element_size" bytes are
+  // left, to reject bogus counts before reserving memory for them.
+  bool Fits(uint64_t count, size_t element_size) {
+    ok_ = ok_ && count <= data_.size() / element_size;
+    return ok_;
+  }
+
+ private:
+  bool Consume(size_t size) {
+    ok_ = ok_ && data_.size() >= size;
+    return ok_;
+  }
+
+  std::string_view data_;
+  bool ok_ = true;
+};
+
+// Binary encoding of the parsed database structures. Readers return false
+// if the data is truncated or malformed.
+void WritePart(const Part &part, SnapshotWriter &out);
+bool ReadPart(SnapshotReader &in, Part &part);
+
+// Decodes all the tiles of "grid"; fails if one of them cannot be.
+absl::Status WriteTileGrid(const LazyTileGrid &grid, SnapshotWriter &out);
+// Only reads the table of the tiles; each tile is decoded in place the first
+// time it is accessed. "file" holds the data of "in" and is kept alive by
+// "grid".
+bool ReadTileGrid(SnapshotReader &in, std::shared_ptr<const MemoryBlock> file,
+                  LazyTileGrid &grid);
+
+void WritePseudoPIPs(const PseudoPIPs &pips, SnapshotWriter &out);
+bool ReadPseudoPIPs(SnapshotReader &in, PseudoPIPs &pips);
+
+void WriteSegmentsBits(const PackedSegmentsBits &segbits,
+                       SnapshotWriter &out);
+bool ReadSegmentsBits(SnapshotReader &in, PackedSegmentsBits &segbits);
+
+// A file or directory a snapshot was derived from. A snapshot is stale once
+// the modification time or size of any of its sources changed.
+struct SnapshotSource {
+  std::string path;
+  int64_t mtime_ns;
+  uint64_t size;
+};
+
+absl::StatusOr<SnapshotSource> StatSnapshotSource(std::string path);
+absl::StatusOr<std::vector<SnapshotSource>> StatSnapshotSources(
+  const std::vector<std::string> &paths);
+
+// Fails with FailedPrecondition if any of "sources" changed since it was
+// stat-ed, which makes "path", derived from them, stale.
+absl::Status CheckSnapshotSources(std::string_view path,
+                                  const std::vector<SnapshotSource> &sources);
+
+// Encoding of the sources, for files that record them in their own format.
+void WriteSnapshotSources(const std::vector<SnapshotSource> &sources,
+                          SnapshotWriter &out);
+bool ReadSnapshotSources(SnapshotReader &in,
+                         std::vector<SnapshotSource> &sources);
+
+// Write "payload" with a header identifying "fingerprint" and "sources" to
+// "path".
+absl::Status WriteSnapshotFile(std::string_view path,
+                               std::string_view fingerprint,
+                               const std::vector<SnapshotSource> &sources,
+                               std::string_view payload);
+
+struct SnapshotFile {
+  std::unique_ptr<MemoryBlock> content;
+  // Points into "content".
+  std::string_view payload;
+  std::vector<SnapshotSource> sources;
+};
+
+// Map the snapshot at "path". Fails with FailedPrecondition if it was written
+// for another "fingerprint", by another version, or if any of its sources
+// changed since. The checksum is only verified if "verify_checksum", as that
+// reads the whole file.
+absl::StatusOr<SnapshotFile> OpenSnapshotFile(std::string_view path,
+                                              std::string_view fingerprint,
+                                              bool verify_checksum);
+}  // namespace fpga
+#endif  // FPGA_DATABASE_SNAPSHOT_H
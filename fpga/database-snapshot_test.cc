@@ -0,0 +1,208 @@
+#include "fpga/database-snapshot.h"
+
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/packed-segments-bits.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+std::string TestPath(const char *name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+void WriteFile(const std::string &path, const std::string &content) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+TEST(DatabaseSnapshot, TileGridRoundTrip) {
+  TileGrid grid;
+  grid["NULL_X1Y1"].type = Symbol("NULL");
+  Tile &tile = grid["LIOB33_X0Y1"];
+  tile.type = Symbol("LIOB33");
+  tile.coord = {0, 1};
+  tile.clock_region = Symbol("X0Y0");
+  tile.bits[ConfigBusType::kCLBIOCLK] = {
+    .alias = BitsBlockAlias{.sites = {{Symbol("IOB_Y0"), Symbol("IOB_Y1")}},
+                            .start_offset = 4,
+                            .type = Symbol("LIOB33_SING")},
+    .base_address = 0x400,
+    .frames = 42,
+    .offset = -2,
+    .words = 4};
+  tile.pin_functions = {
+    {Symbol("IOB_Y0"), Symbol("IO_L1P_T0_D00_MOSI_14")}};
+  tile.sites = {{Symbol("IOB_Y0"), Symbol("IOB33M")}};
+  tile.prohibited_sites = {Symbol("IOB_Y1")};
+
+  SnapshotWriter out;
+  ASSERT_TRUE(WriteTileGrid(LazyTileGrid(grid), out).ok());
+  SnapshotReader in(out.data());
+  LazyTileGrid read;
+  ASSERT_TRUE(ReadTileGrid(in, nullptr, read));
+  ASSERT_EQ(read.size(), 2);
+  EXPECT_TRUE(read.tile_types().contains(Symbol("LIOB33_SING")));
+  EXPECT_EQ(read.FindId(Location{0, 1}), read.FindId("LIOB33_X0Y1"));
+  const Tile &read_tile = read.at("LIOB33_X0Y1");
+  EXPECT_EQ(read_tile.type, "LIOB33");
+  EXPECT_EQ(read_tile.coord.y, 1);
+  EXPECT_EQ(read_tile.clock_region, "X0Y0");
+  const BitsBlock &block = read_tile.bits.at(ConfigBusType::kCLBIOCLK);
+  ASSERT_TRUE(block.alias.has_value());
+  EXPECT_EQ(block.alias->sites.at(Symbol("IOB_Y0")), Symbol("IOB_Y1"));
+  EXPECT_EQ(block.alias->start_offset, 4);
+  EXPECT_EQ(block.alias->type, "LIOB33_SING");
+  EXPECT_EQ(block.base_address, 0x400);
+  EXPECT_EQ(block.frames, 42);
+  EXPECT_EQ(block.offset, -2);
+  EXPECT_EQ(block.words, 4);
+  EXPECT_EQ(read_tile.pin_functions, tile.pin_functions);
+  EXPECT_EQ(read_tile.sites, tile.sites);
+  EXPECT_EQ(read_tile.prohibited_sites, tile.prohibited_sites);
+  EXPECT_FALSE(read.at("NULL_X1Y1").clock_region.has_value());
+
+  // Any truncation is noticed.
+  SnapshotReader truncated(
+    std::string_view(out.data()).substr(0, out.data().size() - 1));
+  LazyTileGrid ignored;
+  EXPECT_FALSE(ReadTileGrid(truncated, nullptr, ignored));
+}
+
+TEST(DatabaseSnapshot, TileGridDecodesTilesOnFirstAccess) {
+  TileGrid grid;
+  grid["NULL_X1Y1"].type = Symbol("NULL");
+  grid["INT_L_X2Y1"].type = Symbol("INT_L");
+  SnapshotWriter out;
+  ASSERT_TRUE(WriteTileGrid(LazyTileGrid(grid), out).ok());
+  // Tiles are read from the data as is, so corrupting the type of one tile
+  // only fails that tile, once it is accessed.
+  std::string data = out.data();
+  data[data.rfind("INT_L") - 4] = '\x7f';
+  SnapshotReader in(data);
+  LazyTileGrid read;
+  ASSERT_TRUE(ReadTileGrid(in, nullptr, read));
+  ASSERT_EQ(read.size(), 2);
+  EXPECT_EQ(read.at("NULL_X1Y1").type, "NULL");
+  const std::optional<TileId> corrupt = read.FindId("INT_L_X2Y1");
+  ASSERT_TRUE(corrupt.has_value());
+  EXPECT_EQ(read.status(*corrupt).code(), absl::StatusCode::kDataLoss);
+}
+
+TEST(DatabaseSnapshot, PartAndSegbitsRoundTrip) {
+  Part part;
+  part.idcode = 0x362d093;
+  part.iobanks = {{14, "X1Y26"}, {15, "X1Y78"}};
+  part.global_clock_regions.top_rows.push_back(
+    {{ConfigBusType::kCLBIOCLK, {42, 30, 36}}});
+  PseudoPIPs pips = {{"INT_L.A.B", PseudoPIPType::kHint}};
+  SegmentsBits segbits;
+  segbits[{"CLBLL_L.SLICEL_X0.ALUT.INIT", 3}] = {{1, 5, true}, {2, 40, false}};
+  const absl::StatusOr<PackedSegmentsBits> packed = PackSegmentsBits(segbits);
+  ASSERT_TRUE(packed.ok()) << packed.status();
+
+  SnapshotWriter out;
+  WritePart(part, out);
+  WritePseudoPIPs(pips, out);
+  WriteSegmentsBits(packed.value(), out);
+  SnapshotReader in(out.data());
+  Part read_part;
+  PseudoPIPs read_pips;
+  PackedSegmentsBits read_segbits;
+  ASSERT_TRUE(ReadPart(in, read_part));
+  ASSERT_TRUE(ReadPseudoPIPs(in, read_pips));
+  ASSERT_TRUE(ReadSegmentsBits(in, read_segbits));
+  EXPECT_EQ(read_part.idcode, part.idcode);
+  EXPECT_EQ(read_part.iobanks, part.iobanks);
+  ASSERT_EQ(read_part.global_clock_regions.top_rows.size(), 1);
+  EXPECT_EQ(read_part.global_clock_regions.top_rows[0].at(
+              ConfigBusType::kCLBIOCLK),
+            (ConfigColumnsFramesCount{42, 30, 36}));
+  EXPECT_TRUE(read_part.global_clock_regions.bottom_rows.empty());
+  EXPECT_EQ(read_pips, pips);
+  absl::Span<const PackedSegmentBit> bits;
+  ASSERT_TRUE(read_segbits.Find("CLBLL_L.SLICEL_X0.ALUT.INIT", 3, bits));
+  ASSERT_EQ(bits.size(), 2);
+  EXPECT_EQ(bits[1].word_column(), 2);
+  EXPECT_EQ(bits[1].word_bit(), 40);
+  EXPECT_FALSE(bits[1].is_set());
+}
+
+TEST(DatabaseSnapshot, FileIsValidatedAgainstSources) {
+  const std::string source_path = TestPath("source.json");
+  const std::string path = TestPath("database.snapshot");
+  WriteFile(source_path, "{}");
+  const absl::StatusOr<SnapshotSource> source =
+    StatSnapshotSource(source_path);
+  ASSERT_TRUE(source.ok()) << source.status();
+  ASSERT_TRUE(WriteSnapshotFile(path, "db:part", {*source}, "payload").ok());
+
+  absl::StatusOr<SnapshotFile> snapshot =
+    OpenSnapshotFile(path, "db:part", true);
+  ASSERT_TRUE(snapshot.ok()) << snapshot.status();
+  EXPECT_EQ(snapshot->payload, "payload");
+  EXPECT_EQ(OpenSnapshotFile(path, "db:other-part", true).status().code(),
+            absl::StatusCode::kFailedPrecondition);
+
+  WriteFile(source_path, "{\"changed\": true}");
+  EXPECT_EQ(OpenSnapshotFile(path, "db:part", true).status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(DatabaseSnapshot, CorruptFileIsRejected) {
+  const std::string path = TestPath("corrupt.snapshot");
+  ASSERT_TRUE(WriteSnapshotFile(path, "db:part", {}, "payload").ok());
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put('P');
+  }
+  EXPECT_EQ(OpenSnapshotFile(path, "db:part", true).status().code(),
+            absl::StatusCode::kDataLoss);
+  // The payload is not read unless asked to.
+  EXPECT_TRUE(OpenSnapshotFile(path, "db:part", false).ok());
+}
+
+TEST(DatabaseSnapshot, CorruptWordIsRejected) {
+  const std::string path = TestPath("corrupt-word.snapshot");
+  ASSERT_TRUE(
+    WriteSnapshotFile(path, "db:part", {}, std::string(100, 'p')).ok());
+  ASSERT_TRUE(OpenSnapshotFile(path, "db:part", true).ok());
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-50, std::ios::end);
+    file.put('q');
+  }
+  EXPECT_EQ(OpenSnapshotFile(path, "db:part", true).status().code(),
+            absl::StatusCode::kDataLoss);
+}
+
+TEST(DatabaseSnapshot, StaleFileIsRejectedBeforeItIsChecked) {
+  const std::string source_path = TestPath("stale-source.json");
+  const std::string path = TestPath("stale.snapshot");
+  WriteFile(source_path, "{}");
+  const absl::StatusOr<SnapshotSource> source =
+    StatSnapshotSource(source_path);
+  ASSERT_TRUE(source.ok()) << source.status();
+  ASSERT_TRUE(WriteSnapshotFile(path, "db:part", {*source}, "payload").ok());
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put('P');
+  }
+  WriteFile(source_path, "{\"changed\": true}");
+  EXPECT_EQ(OpenSnapshotFile(path, "db:part", true).status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+}  // namespace
+}  // namespace fpga
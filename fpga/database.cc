@@ -1,12 +1,11 @@
 #include "fpga/database.h"
 
-#include <algorithm>
-#include <cctype>
 #include <cstdint>
 #include <cstdlib>
 #include <filesystem>
+#include <initializer_list>
 #include <iostream>
-#include <iterator>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -15,51 +14,60 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
-#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "fpga/database-parsers.h"
+#include "fpga/database-snapshot.h"
+#include "fpga/feature-index.h"
+#include "fpga/lazy-tile-grid.h"
 #include "fpga/memory-mapped-file.h"
+#include "fpga/packed-segments-bits.h"
+#include "fpga/symbol-table.h"
+#include "fpga/thread-pool.h"
 
 namespace fpga {
 absl::StatusOr<BanksTilesRegistry> BanksTilesRegistry::Create(
-  const Part &part, const PackagePins &package_pins) {
-  absl::flat_hash_map<std::string, std::vector<uint32_t>> tile_to_banks;
-  absl::flat_hash_map<uint32_t, absl::flat_hash_set<std::string>>
-    banks_to_tiles_set;
-  for (const auto &pair : part.iobanks) {
-    const std::string tile = "HCLK_IOI3_" + pair.second;
-    banks_to_tiles_set[pair.first].insert(tile);
-    if (!tile_to_banks.contains(tile)) {
-      tile_to_banks.insert({tile, {}});
+  const Part &part, const PackagePins &package_pins,
+  const LazyTileGrid &grid) {
+  tile_to_bank_type tile_to_banks;
+  absl::flat_hash_map<uint32_t, absl::flat_hash_set<TileId>> banks_to_tiles_set;
+  auto add = [&](uint32_t bank, std::string_view tile_name) {
+    const std::optional<TileId> tile = grid.FindId(tile_name);
+    if (!tile.has_value()) {
+      return;
     }
-    tile_to_banks.at(tile).push_back(pair.first);
+    banks_to_tiles_set[bank].insert(*tile);
+    tile_to_banks[*tile].push_back(bank);
+  };
+  for (const auto &pair : part.iobanks) {
+    add(pair.first, "HCLK_IOI3_" + pair.second);
   }
-
   for (const auto &pin : package_pins) {
-    banks_to_tiles_set[pin.bank].insert(pin.tile);
-    if (!tile_to_banks.contains(pin.tile)) {
-      tile_to_banks.insert({pin.tile, {}});
-    }
-    tile_to_banks.at(pin.tile).push_back(pin.bank);
+    add(pin.bank, pin.tile.str());
   }
   // Convert sets to vectors.
   banks_to_tiles_type banks_to_tiles;
   for (const auto &pair : banks_to_tiles_set) {
     banks_to_tiles.insert(
       {pair.first,
-       std::vector<std::string>(pair.second.begin(), pair.second.end())});
+       std::vector<TileId>(pair.second.begin(), pair.second.end())});
   }
   return BanksTilesRegistry(tile_to_banks, banks_to_tiles);
 }
 
-std::optional<std::vector<std::string>> BanksTilesRegistry::Tiles(
+std::optional<std::vector<TileId>> BanksTilesRegistry::Tiles(
   uint32_t bank) const {
   if (!banks_to_tiles_.contains(bank)) {
     return {};
@@ -67,26 +75,76 @@ std::optional<std::vector<std::string>> BanksTilesRegistry::Tiles(
   return banks_to_tiles_.at(bank);
 }
 
-std::vector<uint32_t> BanksTilesRegistry::TileBanks(
-  const std::string &tile) const {
+std::vector<uint32_t> BanksTilesRegistry::TileBanks(TileId tile) const {
   if (!tile_to_bank_.contains(tile)) {
     return {};
   }
   return tile_to_bank_.at(tile);
 }
 
-bool PartDatabase::AddSegbitsToCache(const std::string &tile_type) {
-  // Already have the tile type segbits.
-  if (segment_bits_cache_.contains(tile_type)) {
-    return false;
+PartDatabase::PartDatabase(std::shared_ptr<Tiles> part_tiles)
+    : tiles_(std::move(part_tiles)),
+      segment_bits_cache_(std::make_unique<SegmentsBitsCache>()),
+      aliased_tiles_(
+        std::make_unique<AliasedTileEntry[]>(tiles_->grid.size())) {
+  // Known without decoding the tiles.
+  for (const Symbol tile_type : tiles_->grid.tile_types()) {
+    segment_bits_cache_->entries.emplace(
+      tile_type, std::make_unique<SegmentsBitsCache::Entry>());
   }
-  const std::optional<SegmentsBitsWithPseudoPIPs> maybe_segbits =
-    tiles_->bits(tile_type);
-  if (!maybe_segbits.has_value()) {
-    return false;
+}
+
+std::shared_ptr<const SegmentsBitsWithPseudoPIPs> PartDatabase::GetSegbits(
+  Symbol tile_type) {
+  // The type of tiles that could not be decoded.
+  if (tile_type.empty()) {
+    return nullptr;
+  }
+  const auto found = segment_bits_cache_->entries.find(tile_type);
+  if (found == segment_bits_cache_->entries.end()) {
+    // Not the tile type of any tile, so no feature can need it; load it
+    // without caching.
+    std::optional<SegmentsBitsWithPseudoPIPs> segbits =
+      tiles_->bits(std::string(tile_type.str()));
+    if (!segbits.has_value()) {
+      return nullptr;
+    }
+    return std::make_shared<const SegmentsBitsWithPseudoPIPs>(
+      std::move(segbits.value()));
+  }
+  SegmentsBitsCache::Entry &entry = *found->second;
+  absl::call_once(entry.loaded, [this, tile_type, &entry] {
+    std::optional<SegmentsBitsWithPseudoPIPs> segbits =
+      tiles_->bits(std::string(tile_type.str()));
+    if (segbits.has_value()) {
+      entry.segbits = std::make_shared<const SegmentsBitsWithPseudoPIPs>(
+        std::move(segbits.value()));
+    }
+  });
+  return entry.segbits;
+}
+
+void PartDatabase::PreloadSegbits() {
+  for (const Symbol tile_type : UsedTileTypes()) {
+    GetSegbits(tile_type);
   }
-  segment_bits_cache_.insert({tile_type, maybe_segbits.value()});
-  return true;
+}
+
+void PartDatabase::PrefetchSegbits(const absl::flat_hash_set<TileId> &tiles,
+                                   ThreadPool &pool) {
+  absl::flat_hash_set<Symbol> tile_types;
+  for (const TileId tile : tiles) {
+    tile_types.insert(GetAliasedTile(tile).tile_type);
+  }
+  LoadSegbits(tile_types, pool);
+}
+
+void PartDatabase::LoadSegbits(const absl::flat_hash_set<Symbol> &tile_types,
+                               ThreadPool &pool) {
+  const std::vector<Symbol> types(tile_types.begin(), tile_types.end());
+  // Tile types already loaded return right away.
+  pool.ParallelFor(types.size(),
+                   [this, &types](size_t i) { GetSegbits(types[i]); });
 }
 
 static absl::StatusOr<PartInfo> ParsePartInfo(
@@ -117,16 +175,17 @@ static absl::StatusOr<PartInfo> ParsePartInfo(
   return parts_infos.at(part);
 }
 
-static absl::StatusOr<TileGrid> ParseTileGrid(
+// Only indexes the tiles, they are decoded from the mapped file on use.
+static absl::StatusOr<LazyTileGrid> ParseTileGrid(
   const std::filesystem::path &prjxray_db_path,
   const fpga::PartInfo &part_info) {
-  const auto tilegrid_json_content_result =
+  auto tilegrid_json_content_result =
     MemoryMapFile(prjxray_db_path / part_info.fabric / "tilegrid.json");
   if (!tilegrid_json_content_result.ok()) {
     return tilegrid_json_content_result.status();
   }
-  return fpga::ParseTileGridJSON(
-    tilegrid_json_content_result.value()->AsStringView());
+  return LazyTileGrid::FromJSON(
+    std::move(tilegrid_json_content_result.value()));
 }
 
 // Stores full absolute paths of the databases for each tile type.
@@ -149,102 +208,100 @@ struct TileTypeDatabasePaths {
 
 constexpr std::string_view kTileTypeJSONPrefix = "tile_type_";
 constexpr std::string_view kTileTypeJSONSuffix = ".json";
-constexpr std::string_view KFileNameFormatSegbits = "segbits_%s.db";
-constexpr std::string_view KFileNameFormatSegbitsBlockRAM =
-  "segbits_%s.block_ram.db";
-constexpr std::string_view KFileNameFormatPseudoPIPs = "ppips_%s.db";
-constexpr std::string_view KFileNameFormatMask = "mask_%s.db";
-
-absl::Status GetDatabasePaths(
-  const std::filesystem::path &path,
-  absl::flat_hash_map<std::string, TileTypeDatabasePaths> &out) {
-  const std::string filename = path.filename();
-  const std::filesystem::path base_path = path.parent_path();
-
-  // Extract string core of tile_type_<tile-type>.json.
-  const size_t core_start = kTileTypeJSONPrefix.size();
-  const size_t core_length =
-    filename.size() - kTileTypeJSONPrefix.size() - kTileTypeJSONSuffix.size();
-  std::string tile_type = filename.substr(core_start, core_length);
-  std::string tile_type_lower;
-  std::transform(tile_type.begin(), tile_type.end(),
-                 std::back_inserter(tile_type_lower),
-                 [](unsigned char c) { return std::tolower(c); });
-
-  struct TileTypeDatabasePaths paths;
-  paths.tile_type_json = path;
-  const std::filesystem::path segbits_db =
-    base_path / absl::StrFormat(KFileNameFormatSegbits, tile_type_lower);
-  if (std::filesystem::exists(segbits_db)) {
-    paths.segbits_db.emplace(segbits_db);
-  }
-
-  const std::filesystem::path segbits_block_ram_db =
-    base_path /
-    absl::StrFormat(KFileNameFormatSegbitsBlockRAM, tile_type_lower);
-  if (std::filesystem::exists(segbits_block_ram_db)) {
-    paths.segbits_block_ram_db.emplace(segbits_block_ram_db);
-  }
-
-  const std::filesystem::path ppips_db =
-    base_path / absl::StrFormat(KFileNameFormatPseudoPIPs, tile_type_lower);
-  if (std::filesystem::exists(ppips_db)) {
-    paths.ppips_db.emplace(ppips_db);
-  }
-
-  const std::filesystem::path mask_db =
-    base_path / absl::StrFormat(KFileNameFormatMask, tile_type_lower);
-  if (std::filesystem::exists(mask_db)) {
-    paths.mask_db.emplace(mask_db);
-  }
-  out.insert({tile_type, paths});
-  return absl::OkStatus();
+constexpr std::string_view kSegbitsPrefix = "segbits_";
+constexpr std::string_view kSegbitsBlockRAMSuffix = ".block_ram.db";
+constexpr std::string_view kPseudoPIPsPrefix = "ppips_";
+constexpr std::string_view kMaskPrefix = "mask_";
+constexpr std::string_view kDatabaseSuffix = ".db";
+
+// If "filename" is <prefix><core><suffix>, store <core> in "core".
+static bool MatchFileName(std::string_view filename, std::string_view prefix,
+                          std::string_view suffix, std::string_view &core) {
+  if (filename.size() <= prefix.size() + suffix.size() ||
+      !absl::StartsWith(filename, prefix) ||
+      !absl::EndsWith(filename, suffix)) {
+    return false;
+  }
+  core = filename.substr(prefix.size(),
+                         filename.size() - prefix.size() - suffix.size());
+  return true;
 }
 
-absl::Status IndexTileTypes(
-  const std::filesystem::path &database_path,
+// Index the tile type databases of a single directory, classifying the
+// files by name in one pass over its entries. Tile types already in
+// "tile_types_database_paths" are kept.
+static absl::Status IndexTileTypesDirectory(
+  const std::filesystem::path &directory,
   absl::flat_hash_map<std::string, TileTypeDatabasePaths>
     &tile_types_database_paths) {
   std::error_code ec;
-  // Create a recursive directory iterator with options to skip permission
-  // errors
-  std::filesystem::recursive_directory_iterator it(
-    database_path, std::filesystem::directory_options::skip_permission_denied,
-    ec);
-  const std::filesystem::recursive_directory_iterator end;
+  std::filesystem::directory_iterator it(
+    directory, std::filesystem::directory_options::skip_permission_denied, ec);
   if (ec) {
-    return absl::InternalError("could not initialize directory iterator");
+    return absl::NotFoundError(absl::StrFormat(
+      "cannot list \"%s\": %s", directory.string(), ec.message()));
   }
-  for (; it != end; it.increment(ec)) {
-    if (ec) {
-      std::cerr << "error accessing " << it->path() << ": " << ec.message()
-                << '\n';
-      ec.clear();
+  // Tile type json files by tile type, the databases by lower case tile type
+  // as their file names are.
+  absl::flat_hash_map<std::string, std::filesystem::path> tile_types;
+  absl::flat_hash_map<std::string, TileTypeDatabasePaths> databases;
+  for (const std::filesystem::directory_iterator end; it != end;
+       it.increment(ec)) {
+    // Entries usually know their type from the directory listing already.
+    std::error_code type_ec;
+    if (!it->is_regular_file(type_ec)) {
       continue;
     }
-
-    // Check if the current entry is a regular file without throwing exceptions
-    std::error_code file_ec;
-    if (std::filesystem::is_regular_file(it->path(), file_ec)) {
-      if (file_ec) {
-        std::cerr << "error checking file type for " << it->path() << ": "
-                  << file_ec.message() << '\n';
-        file_ec.clear();
-      } else {
-        const std::filesystem::path &path = std::string(it->path());
-        const std::string filename = path.filename().string();
-        if (absl::StartsWith(filename, kTileTypeJSONPrefix) &&
-            absl::EndsWith(filename, kTileTypeJSONSuffix)) {
-          absl::Status status =
-            GetDatabasePaths(path, tile_types_database_paths);
-          if (!status.ok()) return status;
-        }
-      }
+    const std::string filename = it->path().filename().string();
+    std::string_view core;
+    if (MatchFileName(filename, kTileTypeJSONPrefix, kTileTypeJSONSuffix,
+                      core)) {
+      tile_types.emplace(core, it->path());
+    } else if (MatchFileName(filename, kSegbitsPrefix, kSegbitsBlockRAMSuffix,
+                             core)) {
+      databases[core].segbits_block_ram_db = it->path();
+    } else if (MatchFileName(filename, kSegbitsPrefix, kDatabaseSuffix,
+                             core)) {
+      databases[core].segbits_db = it->path();
+    } else if (MatchFileName(filename, kPseudoPIPsPrefix, kDatabaseSuffix,
+                             core)) {
+      databases[core].ppips_db = it->path();
+    } else if (MatchFileName(filename, kMaskPrefix, kDatabaseSuffix, core)) {
+      databases[core].mask_db = it->path();
     }
   }
+  if (ec) {
+    std::cerr << "error listing " << directory << ": " << ec.message() << '\n';
+  }
+  for (auto &[tile_type, tile_type_json] : tile_types) {
+    TileTypeDatabasePaths paths;
+    const auto found = databases.find(absl::AsciiStrToLower(tile_type));
+    if (found != databases.end()) {
+      paths = std::move(found->second);
+    }
+    paths.tile_type_json = std::move(tile_type_json);
+    tile_types_database_paths.try_emplace(tile_type, std::move(paths));
+  }
   return absl::OkStatus();
 }
 
+// Tile type databases are in the family directory, next to the fabric
+// directories. Tile types of the fabric directory itself take precedence.
+absl::Status IndexTileTypes(
+  const std::filesystem::path &database_path, const PartInfo &part_info,
+  absl::flat_hash_map<std::string, TileTypeDatabasePaths>
+    &tile_types_database_paths) {
+  const std::filesystem::path fabric_path = database_path / part_info.fabric;
+  if (std::filesystem::is_directory(fabric_path)) {
+    const absl::Status status =
+      IndexTileTypesDirectory(fabric_path, tile_types_database_paths);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return IndexTileTypesDirectory(database_path, tile_types_database_paths);
+}
+
 absl::StatusOr<SegmentsBitsWithPseudoPIPs> ParseTileTypeDatabase(
   const TileTypeDatabasePaths &paths) {
   SegmentsBitsWithPseudoPIPs out;
@@ -256,7 +313,7 @@ absl::StatusOr<SegmentsBitsWithPseudoPIPs> ParseTileTypeDatabase(
     if (!ppips_db.ok()) return ppips_db.status();
     out.pips = ppips_db.value();
   }
-  absl::flat_hash_map<ConfigBusType, SegmentsBits> &segment_bits =
+  absl::flat_hash_map<ConfigBusType, PackedSegmentsBits> &segment_bits =
     out.segment_bits;
   // Parse segments bits.
   if (paths.segbits_db.has_value()) {
@@ -265,7 +322,9 @@ absl::StatusOr<SegmentsBitsWithPseudoPIPs> ParseTileTypeDatabase(
     auto segbits_db =
       ParseSegmentsBitsDatabase(content.value()->AsStringView());
     if (!segbits_db.ok()) return segbits_db.status();
-    segment_bits.insert({ConfigBusType::kCLBIOCLK, segbits_db.value()});
+    auto packed = PackSegmentsBits(segbits_db.value());
+    if (!packed.ok()) return packed.status();
+    segment_bits.emplace(ConfigBusType::kCLBIOCLK, std::move(packed.value()));
   }
   if (paths.segbits_block_ram_db.has_value()) {
     const auto content =
@@ -274,48 +333,133 @@ absl::StatusOr<SegmentsBitsWithPseudoPIPs> ParseTileTypeDatabase(
     auto segbits_db =
       ParseSegmentsBitsDatabase(content.value()->AsStringView());
     if (!segbits_db.ok()) return segbits_db.status();
-    segment_bits.insert({ConfigBusType::kBlockRam, segbits_db.value()});
+    auto packed = PackSegmentsBits(segbits_db.value());
+    if (!packed.ok()) return packed.status();
+    segment_bits.emplace(ConfigBusType::kBlockRam, std::move(packed.value()));
   }
   return out;
 }
 
-absl::StatusOr<fpga::BanksTilesRegistry> CreateBanksRegistry(
-  const fpga::Part &part, const std::filesystem::path &package_pins_path) {
-  // Parse package pins.
+absl::StatusOr<fpga::PackagePins> ParsePackagePinsFile(
+  const std::filesystem::path &package_pins_path) {
   const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>>
     package_pins_csv_result = fpga::MemoryMapFile(package_pins_path);
   if (!package_pins_csv_result.ok()) return package_pins_csv_result.status();
-  const absl::StatusOr<fpga::PackagePins> package_pins_result =
-    fpga::ParsePackagePins(package_pins_csv_result.value()->AsStringView());
-  if (!package_pins_result.ok()) {
-    return package_pins_result.status();
-  }
-  const fpga::PackagePins &package_pins = package_pins_result.value();
-  return fpga::BanksTilesRegistry::Create(part, package_pins);
+  return fpga::ParsePackagePins(
+    package_pins_csv_result.value()->AsStringView());
 }
 
 absl::StatusOr<PartDatabase> PartDatabase::Parse(std::string_view database_path,
                                                  std::string_view part_name) {
-  const absl::StatusOr<PartInfo> part_info_result =
-    ParsePartInfo(std::filesystem::path(database_path), std::string(part_name));
+  std::vector<std::string> sources;
+  absl::StatusOr<PartDatabase> database =
+    Parse(database_path, part_name, &sources);
+  if (database.ok()) {
+    database->sources_ = std::move(sources);
+  }
+  return database;
+}
+
+absl::StatusOr<PartDatabase> PartDatabase::Parse(
+  std::string_view database_path, std::string_view part_name,
+  std::vector<std::string> *sources) {
+  const std::filesystem::path part_path =
+    std::filesystem::path(database_path) / part_name;
+
+  // The tile grid and the tile type index only depend on the part info, so
+  // once the part info is known the files are loaded by three chains running
+  // concurrently: tilegrid.json, tile type indexing, part.json and package
+  // pins. Each chain only writes its own results. The banks registry refers
+  // to the tiles of the grid, so it is created once all chains are done.
+  absl::StatusOr<PartInfo> part_info_result =
+    absl::UnknownError("part info not parsed");
+  absl::StatusOr<LazyTileGrid> tilegrid_result =
+    absl::UnknownError("tilegrid not parsed");
+  absl::flat_hash_map<std::string, TileTypeDatabasePaths>
+    tiles_types_databases_paths;
+  absl::Status index_status = absl::UnknownError("tile types not indexed");
+  absl::StatusOr<fpga::Part> part_result =
+    absl::UnknownError("part.json not parsed");
+  absl::StatusOr<fpga::PackagePins> package_pins_result =
+    absl::UnknownError("package pins not parsed");
+  {
+    ThreadPool pool(2);
+    pool.Schedule([&] {
+      const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>>
+        part_json_result = fpga::MemoryMapFile(part_path / "part.json");
+      if (!part_json_result.ok()) {
+        part_result = part_json_result.status();
+        return;
+      }
+      part_result =
+        fpga::ParsePartJSON(part_json_result.value()->AsStringView());
+      if (!part_result.ok()) {
+        return;
+      }
+      package_pins_result =
+        ParsePackagePinsFile(part_path / "package_pins.csv");
+    });
+    part_info_result = ParsePartInfo(std::filesystem::path(database_path),
+                                     std::string(part_name));
+    if (part_info_result.ok()) {
+      pool.Schedule([&] {
+        index_status =
+          IndexTileTypes(std::filesystem::path(database_path),
+                         part_info_result.value(), tiles_types_databases_paths);
+      });
+      // The tilegrid is the largest file, index it on this thread.
+      tilegrid_result = ParseTileGrid(database_path, part_info_result.value());
+    }
+  }
   if (!part_info_result.ok()) {
     return part_info_result.status();
   }
   const PartInfo &part_info = part_info_result.value();
-
-  // Parse tilegrid.
-  absl::StatusOr<fpga::TileGrid> tilegrid_result =
-    ParseTileGrid(database_path, part_info);
   if (!tilegrid_result.ok()) {
     return tilegrid_result.status();
   }
+  if (!index_status.ok()) {
+    return index_status;
+  }
+  if (!part_result.ok()) {
+    return part_result.status();
+  }
+  const fpga::Part &part = part_result.value();
+  if (!package_pins_result.ok()) {
+    return package_pins_result.status();
+  }
+  absl::StatusOr<BanksTilesRegistry> banks_tiles_registry_result =
+    BanksTilesRegistry::Create(part, package_pins_result.value(),
+                               tilegrid_result.value());
+  if (!banks_tiles_registry_result.ok()) {
+    return banks_tiles_registry_result.status();
+  }
 
-  absl::flat_hash_map<std::string, TileTypeDatabasePaths>
-    tiles_types_databases_paths;
-  absl::Status status = IndexTileTypes(std::filesystem::path(database_path),
-                                       tiles_types_databases_paths);
-  if (!status.ok()) {
-    return status;
+  if (sources != nullptr) {
+    const std::filesystem::path mapping_path =
+      std::filesystem::path(database_path) / "mapping";
+    *sources = {
+      (mapping_path / "parts.yaml").string(),
+      (mapping_path / "devices.yaml").string(),
+      (std::filesystem::path(database_path) / part_info.fabric /
+       "tilegrid.json")
+        .string(),
+      (part_path / "part.json").string(),
+      (part_path / "package_pins.csv").string(),
+    };
+    // The directories as well, to notice tile types being added or removed.
+    absl::btree_set<std::string> tile_type_sources;
+    for (const auto &[tile_type, paths] : tiles_types_databases_paths) {
+      tile_type_sources.insert(paths.tile_type_json.parent_path().string());
+      for (const auto &path :
+           {paths.segbits_db, paths.segbits_block_ram_db, paths.ppips_db}) {
+        if (path.has_value()) {
+          tile_type_sources.insert(path->string());
+        }
+      }
+    }
+    sources->insert(sources->end(), tile_type_sources.begin(),
+                    tile_type_sources.end());
   }
 
   auto tiles_database = [paths = std::move(tiles_types_databases_paths)](
@@ -332,124 +476,464 @@ absl::StatusOr<PartDatabase> PartDatabase::Parse(std::string_view database_path,
     }
     return {};
   };
-  // Parse part.json.
-  const absl::StatusOr<std::unique_ptr<fpga::MemoryBlock>> part_json_result =
-    fpga::MemoryMapFile(std::filesystem::path(database_path) / part_name /
-                        "part.json");
-  if (!part_json_result.ok()) return part_json_result.status();
-  const absl::StatusOr<fpga::Part> part_result =
-    fpga::ParsePartJSON(part_json_result.value()->AsStringView());
-  if (!part_result.ok()) {
-    return part_result.status();
-  }
-  const fpga::Part &part = part_result.value();
-
-  auto banks_tiles_registry_result =
-    CreateBanksRegistry(part, std::filesystem::path(database_path) / part_name /
-                                "package_pins.csv");
-  if (!banks_tiles_registry_result.ok()) {
-    return banks_tiles_registry_result.status();
-  }
   const std::shared_ptr<Tiles> tiles = std::make_shared<Tiles>(
     std::move(tilegrid_result.value()), std::move(tiles_database),
     std::move(banks_tiles_registry_result.value()), part);
   return absl::StatusOr<PartDatabase>(tiles);
 }
 
-// CLBLM_R_X33Y38.SLICEM_X0.ALUT.INIT, CLBLM_R_X33Y38 is a tilename.
-void PartDatabase::ConfigBits(const std::string &tile_name,
-                              const std::string &feature, uint32_t address,
-                              const BitSetter &bit_setter) {
-  // fprintf(stderr, "%s %s %u\n", tile_name.c_str(), feature.c_str(), address);
-  // Given the tilename, get the tile type.
-  const Tile &tile = tiles_->grid.at(tile_name);
-  // Either the feature tile type of the tile type alias.
-  std::string tile_type = tile.type;
-  std::string aliased_feature = feature;
-
-  // Materialize aliased bit maps.
-  absl::flat_hash_map<ConfigBusType, BitsBlock> aliased_bits_map;
-  for (const auto &pair : tile.bits) {
-    const BitsBlock &bits_block = pair.second;
-    const ConfigBusType &bus_type = pair.first;
-    if (bits_block.alias.has_value()) {
-      const BitsBlockAlias alias = bits_block.alias.value();
-      // TODO: check that for each block the aliased tile type is the same.
-      tile_type = bits_block.alias.value().type;
-      std::vector<std::string> feature_parts =
-        absl::StrSplit(feature, absl::MaxSplits('.', 1));
-      if (feature_parts.size() >= 2) {
-        std::string &site = feature_parts[1];
-        if (alias.sites.contains(site)) {
-          site = alias.sites.at(site);
-        }
-        aliased_feature = absl::StrJoin(feature_parts, ".");
+absl::StatusOr<PartDatabase> PartDatabase::ParseWithSnapshot(
+  std::string_view database_path, std::string_view part_name,
+  std::string_view snapshot_path, bool verify_checksum) {
+  const std::string fingerprint = absl::StrFormat(
+    "%s\n%s", std::filesystem::absolute(database_path).string(), part_name);
+  absl::StatusOr<SnapshotFile> snapshot =
+    OpenSnapshotFile(snapshot_path, fingerprint, verify_checksum);
+  if (snapshot.ok()) {
+    absl::StatusOr<PartDatabase> database =
+      FromSnapshot(std::move(snapshot.value()));
+    if (database.ok()) {
+      return database;
+    }
+    snapshot = database.status();
+  }
+  if (std::filesystem::exists(snapshot_path)) {
+    std::cerr << absl::StrFormat("rebuilding database snapshot: %s\n",
+                                 snapshot.status().message());
+  }
+  std::vector<std::string> sources;
+  absl::StatusOr<PartDatabase> database =
+    Parse(database_path, part_name, &sources);
+  if (!database.ok()) {
+    return database;
+  }
+  // The database is fine without a snapshot, so failing to write one is
+  // not an error.
+  const absl::Status status =
+    database->WriteSnapshot(snapshot_path, fingerprint, sources);
+  if (!status.ok()) {
+    std::cerr << absl::StrFormat("cannot write database snapshot: %s\n",
+                                 status.message());
+  }
+  database->sources_ = std::move(sources);
+  return database;
+}
+
+absl::flat_hash_set<Symbol> PartDatabase::UsedTileTypes() const {
+  absl::flat_hash_set<Symbol> tile_types;
+  for (TileId tile = 0; tile < tiles_->grid.size(); ++tile) {
+    tile_types.insert(GetAliasedTile(tile).tile_type);
+  }
+  return tile_types;
+}
+
+// Snapshot payload: part, tile grid, banks registry as tile to banks and
+// bank to tiles lists, then per tile type with segbits its name and size
+// followed by its pseudo PIPs and its segbits per bus.
+absl::Status PartDatabase::WriteSnapshot(
+  std::string_view path, std::string_view fingerprint,
+  const std::vector<std::string> &source_paths) {
+  const absl::StatusOr<std::vector<SnapshotSource>> sources =
+    StatSnapshotSources(source_paths);
+  if (!sources.ok()) {
+    return sources.status();
+  }
+  SnapshotWriter out;
+  WritePart(tiles_->part, out);
+  if (absl::Status status = WriteTileGrid(tiles_->grid, out); !status.ok()) {
+    return status;
+  }
+  const BanksTilesRegistry &banks = tiles_->banks;
+  out.U32(banks.tile_to_bank_.size());
+  for (const auto &[tile, tile_banks] : banks.tile_to_bank_) {
+    out.String(tiles_->grid.name(tile));
+    out.U32(tile_banks.size());
+    for (const uint32_t bank : tile_banks) {
+      out.U32(bank);
+    }
+  }
+  out.U32(banks.banks_to_tiles_.size());
+  for (const auto &[bank, bank_tiles] : banks.banks_to_tiles_) {
+    out.U32(bank);
+    out.U32(bank_tiles.size());
+    for (const TileId tile : bank_tiles) {
+      out.String(tiles_->grid.name(tile));
+    }
+  }
+  std::vector<std::pair<Symbol, std::string>> tile_types;
+  for (const Symbol tile_type : UsedTileTypes()) {
+    const std::shared_ptr<const SegmentsBitsWithPseudoPIPs> segbits =
+      GetSegbits(tile_type);
+    if (segbits == nullptr) {
+      continue;
+    }
+    SnapshotWriter section;
+    WritePseudoPIPs(segbits->pips, section);
+    section.U32(segbits->segment_bits.size());
+    for (const auto &[bus, bus_segbits] : segbits->segment_bits) {
+      section.U32(static_cast<uint32_t>(bus));
+      WriteSegmentsBits(bus_segbits, section);
+    }
+    tile_types.emplace_back(tile_type, section.data());
+  }
+  out.U32(tile_types.size());
+  for (const auto &[tile_type, section] : tile_types) {
+    out.String(tile_type.str());
+    out.U64(section.size());
+    out.Bytes(section);
+  }
+  return WriteSnapshotFile(path, fingerprint, sources.value(), out.data());
+}
+
+// Decode the segbits of a tile type from its snapshot section.
+static std::optional<SegmentsBitsWithPseudoPIPs> ReadSegbitsSection(
+  std::string_view section) {
+  SnapshotReader in(section);
+  SegmentsBitsWithPseudoPIPs segbits;
+  if (!ReadPseudoPIPs(in, segbits.pips)) {
+    return {};
+  }
+  const uint32_t bus_count = in.U32();
+  for (uint32_t i = 0; i < bus_count && in.ok(); ++i) {
+    const auto bus = static_cast<ConfigBusType>(in.U32());
+    if (!ReadSegmentsBits(in, segbits.segment_bits[bus])) {
+      return {};
+    }
+  }
+  if (!in.ok()) {
+    return {};
+  }
+  return segbits;
+}
+
+absl::StatusOr<PartDatabase> PartDatabase::FromSnapshot(SnapshotFile snapshot) {
+  const absl::Status corrupt =
+    absl::DataLossError("database snapshot cannot be decoded");
+  const std::shared_ptr<const MemoryBlock> content =
+    std::move(snapshot.content);
+  SnapshotReader in(snapshot.payload);
+  Part part;
+  LazyTileGrid grid;
+  if (!ReadPart(in, part) || !ReadTileGrid(in, content, grid)) {
+    return corrupt;
+  }
+  // Tiles are stored by name, as tile ids are only valid for one grid.
+  BanksTilesRegistry::tile_to_bank_type tile_to_bank;
+  const uint32_t tile_count = in.U32();
+  for (uint32_t i = 0; i < tile_count && in.ok(); ++i) {
+    const std::optional<TileId> tile = grid.FindId(in.String());
+    if (!tile.has_value()) {
+      return corrupt;
+    }
+    std::vector<uint32_t> &tile_banks = tile_to_bank[*tile];
+    const uint32_t bank_count = in.U32();
+    if (!in.Fits(bank_count, 4)) {
+      return corrupt;
+    }
+    for (uint32_t b = 0; b < bank_count; ++b) {
+      tile_banks.push_back(in.U32());
+    }
+  }
+  BanksTilesRegistry::banks_to_tiles_type banks_to_tiles;
+  const uint32_t bank_count = in.U32();
+  for (uint32_t i = 0; i < bank_count && in.ok(); ++i) {
+    std::vector<TileId> &bank_tiles = banks_to_tiles[in.U32()];
+    const uint32_t bank_tile_count = in.U32();
+    if (!in.Fits(bank_tile_count, 4)) {
+      return corrupt;
+    }
+    for (uint32_t t = 0; t < bank_tile_count; ++t) {
+      const std::optional<TileId> tile = grid.FindId(in.String());
+      if (!tile.has_value()) {
+        return corrupt;
       }
-      const BitsBlock aliased_block = {
-        .alias = {},
-        .base_address = bits_block.base_address,
-        .frames = bits_block.frames,
-        .offset = int32_t(bits_block.offset - alias.start_offset),
-        .words = bits_block.words,
-      };
-      aliased_bits_map.insert({bus_type, aliased_block});
-    } else {
-      aliased_bits_map.insert({bus_type, bits_block});
+      bank_tiles.push_back(*tile);
+    }
+  }
+  // Segbits are only decoded when a tile type is first used; until then,
+  // they stay in the mapped file.
+  absl::flat_hash_map<std::string, std::string_view> sections;
+  const uint32_t tile_type_count = in.U32();
+  for (uint32_t i = 0; i < tile_type_count && in.ok(); ++i) {
+    const std::string_view tile_type = in.String();
+    sections.emplace(tile_type, in.Bytes(in.U64()));
+  }
+  if (!in.ok()) {
+    return corrupt;
+  }
+  auto tiles_database =
+    [content, sections = std::move(sections)](const std::string &tile_type)
+    -> std::optional<SegmentsBitsWithPseudoPIPs> {
+    const auto found = sections.find(tile_type);
+    if (found == sections.end()) {
+      return {};
+    }
+    return ReadSegbitsSection(found->second);
+  };
+  const std::shared_ptr<Tiles> tiles = std::make_shared<Tiles>(
+    std::move(grid), std::move(tiles_database),
+    BanksTilesRegistry(std::move(tile_to_bank), std::move(banks_to_tiles)),
+    std::move(part));
+  PartDatabase database(tiles);
+  for (SnapshotSource &source : snapshot.sources) {
+    database.sources_.push_back(std::move(source.path));
+  }
+  return database;
+}
+
+void PartDatabase::EnableResolutionCache(size_t max_entries) {
+  resolution_cache_ = std::make_unique<ResolutionCache>(max_entries);
+}
+
+void PartDatabase::ConfigBits(TileId tile, std::string_view feature,
+                              uint32_t address, const BitSetter &bit_setter) {
+  absl::Span<const IndexedBit> indexed_bits;
+  // The index is keyed by names, as it outlives the ids of the grid.
+  if (feature_index_ != nullptr &&
+      feature_index_->Find(tiles_->grid.name(tile), feature, address,
+                           indexed_bits)) {
+    for (const IndexedBit &bit : indexed_bits) {
+      bit_setter(bit.bus(), bit.frame_address(),
+                 {.word = bit.word(), .index = bit.index()}, bit.value());
+    }
+    return;
+  }
+  if (resolution_cache_ == nullptr) {
+    ResolvedBits resolved;
+    ResolveConfigBits(tile, feature, address, resolved);
+    for (const ResolvedBit &bit : resolved) {
+      bit_setter(bit.bus, bit.address, bit.bit, bit.value);
+    }
+    return;
+  }
+  ResolutionCache &cache = *resolution_cache_;
+  const ResolutionKeyView key = {tile, feature, address};
+  std::shared_ptr<const ResolvedBits> resolved;
+  {
+    const absl::ReaderMutexLock lock(&cache.mu);
+    const auto found = cache.entries.find(key);
+    if (found != cache.entries.end()) {
+      resolved = found->second;
+    }
+  }
+  if (resolved != nullptr) {
+    cache.hits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    // Resolve outside of the lock; if someone else resolved the same key in
+    // the meantime, theirs is kept, as it is identical anyway.
+    cache.misses.fetch_add(1, std::memory_order_relaxed);
+    auto bits = std::make_shared<ResolvedBits>();
+    ResolveConfigBits(tile, feature, address, *bits);
+    const absl::MutexLock lock(&cache.mu);
+    if (cache.entries.size() >= cache.max_entries) {
+      cache.entries.clear();
     }
+    ResolutionKey owned_key = {tile, std::string(feature), address};
+    resolved = cache.entries.try_emplace(std::move(owned_key), std::move(bits))
+                 .first->second;
+  }
+  for (const ResolvedBit &bit : *resolved) {
+    bit_setter(bit.bus, bit.address, bit.bit, bit.value);
   }
+}
+
+const PartDatabase::AliasedTile &PartDatabase::GetAliasedTile(
+  TileId tile_id) const {
+  AliasedTileEntry &entry = aliased_tiles_[tile_id];
+  absl::call_once(entry.applied, [this, tile_id, &entry] {
+    const Tile &tile = tiles_->grid.tile(tile_id);
+    AliasedTile &aliased = entry.tile;
+    // Either the tile type or, if any, the one it is aliased to; should the
+    // blocks have different aliases, the last one wins.
+    // TODO: check that for each block the aliased tile type is the same.
+    const BitsBlockAlias *alias = nullptr;
+    for (const auto &[bus, bits_block] : tile.bits) {
+      uint32_t offset = bits_block.offset;
+      if (bits_block.alias.has_value()) {
+        alias = &bits_block.alias.value();
+        offset = bits_block.offset - alias->start_offset;
+      }
+      // Frame addresses are 32 bits wide.
+      CHECK_LE(bits_block.base_address, std::numeric_limits<uint32_t>::max())
+        << tile.type.str();
+      aliased.buses.push_back(
+        {.bus = bus,
+         .base_address = static_cast<uint32_t>(bits_block.base_address),
+         .offset = offset});
+    }
+    aliased.tile_type = tile.type;
+    if (alias != nullptr) {
+      aliased.tile_type = alias->type;
+      for (const auto &[from, to] : alias->sites) {
+        aliased.sites.emplace(from.str(), to.str());
+      }
+    }
+    aliased.feature_prefix = std::string(aliased.tile_type.str()) + ".";
+  });
+  return entry.tile;
+}
+
+// Name joined from a few pieces; kept inline unless unusually long, so
+// that looking up a feature does not allocate.
+class JoinedName {
+ public:
+  explicit JoinedName(std::initializer_list<std::string_view> pieces) {
+    for (const std::string_view piece : pieces) {
+      chars_.insert(chars_.end(), piece.begin(), piece.end());
+    }
+  }
+  std::string_view view() const { return {chars_.data(), chars_.size()}; }
+
+ private:
+  absl::InlinedVector<char, 128> chars_;
+};
+
+// A feature with its site renamed: the feature up to the site followed by
+// the new name of the site. Both are views, into the feature and the
+// symbol table.
+struct AliasedFeature {
+  std::string_view head;
+  std::string_view site;
+  bool operator==(std::string_view feature) const {
+    return feature.size() == head.size() + site.size() &&
+           absl::StartsWith(feature, head) && absl::EndsWith(feature, site);
+  }
+};
 
-  // Fill the cache with the current tile type segbits.
-  AddSegbitsToCache(tile_type);
-  CHECK(segment_bits_cache_.contains(tile_type));
-  const SegmentsBitsWithPseudoPIPs &tile_type_features_bits =
-    segment_bits_cache_.at(tile_type);
-  const std::string tile_segments_bits_key =
-    absl::StrJoin({tile_name, aliased_feature}, ".");
-  if (tile_type_features_bits.pips.contains(tile_segments_bits_key)) {
+// Rename the site of "feature" as given by the aliased "sites".
+static AliasedFeature AliasFeature(
+  const absl::flat_hash_map<std::string_view, std::string_view> &sites,
+  std::string_view feature) {
+  const size_t dot = feature.find('.');
+  if (dot == std::string_view::npos) {
+    return {.head = feature, .site = {}};
+  }
+  const auto found = sites.find(feature.substr(dot + 1));
+  if (found == sites.end()) {
+    return {.head = feature, .site = {}};
+  }
+  return {.head = feature.substr(0, dot + 1), .site = found->second};
+}
+
+// CLBLM_R_X33Y38.SLICEM_X0.ALUT.INIT, CLBLM_R_X33Y38 is a tilename.
+void PartDatabase::ResolveConfigBits(TileId tile_id, std::string_view feature,
+                                     uint32_t address,
+                                     ResolvedBits &resolved) {
+  const std::string &tile_name = tiles_->grid.name(tile_id);
+  const AliasedTile &tile = GetAliasedTile(tile_id);
+  const AliasedFeature aliased_feature = AliasFeature(tile.sites, feature);
+
+  // Get the current tile type segbits, filling the cache if needed.
+  const std::shared_ptr<const SegmentsBitsWithPseudoPIPs> segbits_entry =
+    GetSegbits(tile.tile_type);
+  CHECK(segbits_entry != nullptr);
+  const SegmentsBitsWithPseudoPIPs &tile_type_features_bits = *segbits_entry;
+  const JoinedName tile_segments_bits_key(
+    {tile_name, ".", aliased_feature.head, aliased_feature.site});
+  if (tile_type_features_bits.pips.contains(tile_segments_bits_key.view())) {
     return;
   }
 
   // Search our database of features and get the segbit.
-  const struct TileFeature tile_feature = {
-    .tile_feature = absl::StrJoin({tile_type, aliased_feature}, "."),
-    .address = address,
-  };
+  const JoinedName tile_feature(
+    {tile.feature_prefix, aliased_feature.head, aliased_feature.site});
 
   // If it's a pseudo pip, skip.
   // TODO(lromor): Is this really necessary? It looks like all pips are
   // different.
-  if (tile_type_features_bits.pips.contains(tile_feature.tile_feature)) {
+  if (tile_type_features_bits.pips.contains(tile_feature.view())) {
     return;
   }
 
   // The tile name has some specific config bus base addresses.
   bool matched = false;
-  for (const auto &config_bus_bits_pair : aliased_bits_map) {
-    const ConfigBusType &bus = config_bus_bits_pair.first;
-    const uint32_t base_address = config_bus_bits_pair.second.base_address;
-    const uint32_t offset = config_bus_bits_pair.second.offset;
-    if (!tile_type_features_bits.segment_bits.contains(bus)) {
+  for (const AliasedTile::Bus &tile_bus : tile.buses) {
+    const auto bus_segbits =
+      tile_type_features_bits.segment_bits.find(tile_bus.bus);
+    if (bus_segbits == tile_type_features_bits.segment_bits.end()) {
       continue;
     }
-    const SegmentsBits &features_segbits =
-      tile_type_features_bits.segment_bits.at(bus);
-    if (aliased_bits_map.size() > 1 && !features_segbits.count(tile_feature)) {
+    absl::Span<const PackedSegmentBit> segbits;
+    if (!bus_segbits->second.Find(tile_feature.view(), address, segbits)) {
       // a feature will probably only match one bus (e.g. BRAM init or BRAM
       // config/routing)
       continue;
     }
-    const auto &segbits = features_segbits.at(tile_feature);
     matched = true;
-    for (const auto &segbit : segbits) {
-      const uint32_t address = base_address + segbit.word_column;
-      const uint32_t bit_pos = offset * kWordSizeBits + segbit.word_bit;
+    for (const PackedSegmentBit segbit : segbits) {
+      const uint32_t address = tile_bus.base_address + segbit.word_column();
+      const uint32_t bit_pos =
+        tile_bus.offset * kWordSizeBits + segbit.word_bit();
       const FrameBit frame_bit = {
         .word = bit_pos / kWordSizeBits,
         .index = bit_pos % kWordSizeBits,
       };
-      bit_setter(bus, address, frame_bit, segbit.is_set);
+      resolved.push_back({tile_bus.bus, address, frame_bit, segbit.is_set()});
     }
   }
   CHECK(matched);
 }
+
+void PartDatabase::ForEachFeatureBits(const FeatureBitsFn &fn) {
+  ResolvedBits resolved;
+  std::vector<IndexedBit> bits;
+  const LazyTileGrid &grid = tiles_->grid;
+  for (TileId tile_id = 0; tile_id < grid.size(); ++tile_id) {
+    const std::string &tile_name = grid.name(tile_id);
+    const AliasedTile &tile = GetAliasedTile(tile_id);
+    const std::shared_ptr<const SegmentsBitsWithPseudoPIPs> segbits =
+      GetSegbits(tile.tile_type);
+    if (segbits == nullptr) {
+      continue;
+    }
+    // Only features of the buses of the tile can be resolved for it.
+    const std::string &prefix = tile.feature_prefix;
+    absl::btree_set<std::pair<std::string, uint32_t>> features;
+    for (const AliasedTile::Bus &tile_bus : tile.buses) {
+      const auto bus_segbits = segbits->segment_bits.find(tile_bus.bus);
+      if (bus_segbits == segbits->segment_bits.end()) {
+        continue;
+      }
+      const PackedSegmentsBits &packed = bus_segbits->second;
+      for (size_t i = 0; i < packed.size(); ++i) {
+        const PackedSegmentsBits::Feature feature = packed.feature(i);
+        if (absl::StartsWith(feature.tile_feature, prefix)) {
+          features.emplace(feature.tile_feature.substr(prefix.size()),
+                           feature.address);
+        }
+      }
+    }
+    for (const auto &[aliased_feature, address] : features) {
+      // Features are looked up by their aliased name; find the names
+      // that map to it.
+      std::vector<std::string> names = {aliased_feature};
+      if (!tile.sites.empty()) {
+        const std::vector<std::string> parts =
+          absl::StrSplit(aliased_feature, absl::MaxSplits('.', 1));
+        for (const auto &[from, to] : tile.sites) {
+          if (parts.size() == 2 && to == parts[1] && from != to) {
+            names.push_back(absl::StrCat(parts[0], ".", from));
+          }
+        }
+      }
+      for (const std::string &name : names) {
+        if (!tile.sites.empty() &&
+            AliasFeature(tile.sites, name) != aliased_feature) {
+          continue;
+        }
+        resolved.clear();
+        ResolveConfigBits(tile_id, name, address, resolved);
+        if (resolved.empty()) {
+          continue;
+        }
+        bits.clear();
+        for (const ResolvedBit &bit : resolved) {
+          bits.emplace_back(bit.bus, bit.address, bit.bit.word, bit.bit.index,
+                            bit.value);
+        }
+        fn(tile_name, name, address, bits);
+      }
+    }
+  }
+}
 }  // namespace fpga
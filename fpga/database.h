@@ -2,6 +2,8 @@
 #define FPGA_DATABASE_H
 
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -11,34 +13,50 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/call_once.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "fpga/database-parsers.h"
+#include "fpga/database-snapshot.h"
+#include "fpga/feature-index.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/packed-segments-bits.h"
+#include "fpga/symbol-table.h"
+#include "fpga/thread-pool.h"
 
 namespace fpga {
 // Many to many map between banks and tiles.
 class BanksTilesRegistry {
-  using tile_to_bank_type =
-    absl::flat_hash_map<std::string, std::vector<uint32_t>>;
+  using tile_to_bank_type = absl::flat_hash_map<TileId, std::vector<uint32_t>>;
   using banks_to_tiles_type =
-    absl::flat_hash_map<uint32_t, std::vector<std::string>>;
+    absl::flat_hash_map<uint32_t, std::vector<TileId>>;
 
  public:
   using const_iterator = banks_to_tiles_type::const_iterator;
   const_iterator begin() const { return banks_to_tiles_.begin(); }
   const_iterator end() const { return banks_to_tiles_.end(); }
 
+  // Tiles that are not in "grid" are left out, as they cannot be configured.
   static absl::StatusOr<BanksTilesRegistry> Create(
-    const Part &part, const PackagePins &package_pins);
+    const Part &part, const PackagePins &package_pins,
+    const LazyTileGrid &grid);
 
   // Get tiles from an IO bank name.
-  std::optional<std::vector<std::string>> Tiles(uint32_t bank) const;
+  std::optional<std::vector<TileId>> Tiles(uint32_t bank) const;
 
   // Get an IO bank from a tile.
-  std::vector<uint32_t> TileBanks(const std::string &tile) const;
+  std::vector<uint32_t> TileBanks(TileId tile) const;
 
  private:
+  // Snapshots store and restore the maps as they are.
+  friend class PartDatabase;
+
   explicit BanksTilesRegistry(tile_to_bank_type tile_to_bank,
                               banks_to_tiles_type banks_to_tiles)
       : tile_to_bank_(std::move(tile_to_bank)),
@@ -61,7 +79,7 @@ using Frames =
 
 struct SegmentsBitsWithPseudoPIPs {
   PseudoPIPs pips;
-  absl::flat_hash_map<ConfigBusType, SegmentsBits> segment_bits;
+  absl::flat_hash_map<ConfigBusType, PackedSegmentsBits> segment_bits;
 };
 
 // Maps tile types to segbits.
@@ -72,24 +90,34 @@ using TileTypesSegmentsBitsGetter =
 class PartDatabase {
  public:
   ~PartDatabase() = default;
+  PartDatabase(PartDatabase &&) = default;
+  PartDatabase &operator=(PartDatabase &&) = default;
   struct Tiles {
-    Tiles(TileGrid grid, TileTypesSegmentsBitsGetter bits,
+    Tiles(LazyTileGrid grid, TileTypesSegmentsBitsGetter bits,
           BanksTilesRegistry banks, Part part)
         : grid(std::move(grid)),
           bits(std::move(bits)),
           banks(std::move(banks)),
           part(std::move(part)) {}
-    TileGrid grid;
+    LazyTileGrid grid;
     TileTypesSegmentsBitsGetter bits;
     BanksTilesRegistry banks;
     Part part;
   };
-  explicit PartDatabase(std::shared_ptr<Tiles> part_tiles)
-      : tiles_(std::move(part_tiles)) {}
+  explicit PartDatabase(std::shared_ptr<Tiles> part_tiles);
 
   static absl::StatusOr<PartDatabase> Parse(std::string_view database_path,
                                             std::string_view part_name);
 
+  // Same as Parse(), but load the database from the binary snapshot at
+  // "snapshot_path" if it is up to date. Otherwise, the database is parsed
+  // and the snapshot (re)written for the next time. The snapshot is mapped
+  // and its tiles and segbits decoded as they are used; its checksum is only
+  // verified if "verify_checksum".
+  static absl::StatusOr<PartDatabase> ParseWithSnapshot(
+    std::string_view database_path, std::string_view part_name,
+    std::string_view snapshot_path, bool verify_checksum);
+
   struct FrameBit {
     uint32_t word;
     uint32_t index;
@@ -97,17 +125,202 @@ class PartDatabase {
   using BitSetter = std::function<void(ConfigBusType bus, uint32_t address,
                                        const FrameBit &bit, bool value)>;
 
-  // Set bits to configure a feature in a specific tile.
-  void ConfigBits(const std::string &tile_name, const std::string &feature,
-                  uint32_t address, const BitSetter &bit_setter);
+  // Set bits to configure a feature in a specific tile of the grid.
+  // Safe to be called concurrently.
+  void ConfigBits(TileId tile, std::string_view feature, uint32_t address,
+                  const BitSetter &bit_setter);
   const struct Tiles &tiles() { return *tiles_; }
 
+  // Files and directories the database was loaded from. Data derived from
+  // the database is outdated once one of them changes.
+  const std::vector<std::string> &sources() const { return sources_; }
+
+  // Have ConfigBits() keep the bits it resolves per tile, feature and
+  // address, to replay them when the same feature is set again. Only pays off
+  // when several designs are assembled with the same database, as a single
+  // design sets almost every feature once. Once "max_entries" are kept, the
+  // cache starts over. Must not be called concurrently with ConfigBits().
+  void EnableResolutionCache(size_t max_entries);
+
+  struct ResolutionCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+  };
+  // Number of ConfigBits() calls answered from the cache and resolved
+  // through the segbits so far; both are zero if the cache is not enabled.
+  ResolutionCacheStats resolution_cache_stats() const {
+    if (resolution_cache_ == nullptr) {
+      return {.hits = 0, .misses = 0};
+    }
+    return {.hits = resolution_cache_->hits.load(std::memory_order_relaxed),
+            .misses =
+              resolution_cache_->misses.load(std::memory_order_relaxed)};
+  }
+
+  // Load the segbits of every tile type used in the grid, so that later
+  // ConfigBits() calls never have to go to the database files.
+  void PreloadSegbits();
+
+  // Load the segbits of the tile types of "tiles", including aliased tile
+  // types, concurrently on "pool" ahead of resolving their features. Must not
+  // be called from one of the pool workers.
+  void PrefetchSegbits(const absl::flat_hash_set<TileId> &tiles,
+                       ThreadPool &pool);
+
+  // Call "fn" with the bits of every feature address of every tile of the
+  // grid that sets bits, as ConfigBits() would set them. Bypasses the
+  // resolution cache.
+  using FeatureBitsFn = std::function<void(
+    const std::string &tile_name, const std::string &feature,
+    uint32_t address, const std::vector<IndexedBit> &bits)>;
+  void ForEachFeatureBits(const FeatureBitsFn &fn);
+
+  // Have ConfigBits() look up features in "index" first, which must have been
+  // compiled from this database and part.
+  void UseFeatureIndex(std::shared_ptr<const FeatureIndex> index) {
+    feature_index_ = std::move(index);
+  }
+
  private:
-  bool AddSegbitsToCache(const std::string &tile_type);
+  // Parse() that also lists the files the database is derived from in
+  // "sources", if given.
+  static absl::StatusOr<PartDatabase> Parse(std::string_view database_path,
+                                            std::string_view part_name,
+                                            std::vector<std::string> *sources);
+
+  static absl::StatusOr<PartDatabase> FromSnapshot(SnapshotFile snapshot);
+
+  // Write a snapshot with the segbits of all used tile types.
+  absl::Status WriteSnapshot(std::string_view path,
+                             std::string_view fingerprint,
+                             const std::vector<std::string> &source_paths);
+
+  // Tile types whose segbits ConfigBits() may need. Decodes all the tiles.
+  absl::flat_hash_set<Symbol> UsedTileTypes() const;
+
+  // Load the segbits of "tile_types" that are not cached yet on "pool".
+  void LoadSegbits(const absl::flat_hash_set<Symbol> &tile_types,
+                   ThreadPool &pool);
+
+  // Segbits of the tile type, loaded on first use. Returns nullptr if
+  // there are none.
+  std::shared_ptr<const SegmentsBitsWithPseudoPIPs> GetSegbits(
+    Symbol tile_type);
+
+  // A bit set by ConfigBits(), as passed to the BitSetter.
+  struct ResolvedBit {
+    ConfigBusType bus;
+    uint32_t address;
+    FrameBit bit;
+    bool value;
+  };
+  using ResolvedBits = std::vector<ResolvedBit>;
+
+  // Look up the segbits of a feature address, without the cache.
+  void ResolveConfigBits(TileId tile, std::string_view feature,
+                         uint32_t address, ResolvedBits &resolved);
+
+  // A tile with the aliases of its bits blocks applied, which is all that is
+  // needed from it to resolve its features.
+  struct AliasedTile {
+    struct Bus {
+      ConfigBusType bus;
+      uint32_t base_address;
+      // Word offset of the tile, relative to the aliased tile type.
+      uint32_t offset;
+    };
+    // Tile type whose segbits hold the features of the tile, and its name
+    // followed by a dot, the prefix of these features.
+    Symbol tile_type;
+    std::string feature_prefix;
+    std::vector<Bus> buses;
+    // Sites renamed by the alias. Views into the symbol table, so that
+    // features can be looked up without being interned.
+    absl::flat_hash_map<std::string_view, std::string_view> sites;
+  };
+
+  // Aliases of "tile", applied the first time it is needed.
+  // Safe to be called concurrently.
+  const AliasedTile &GetAliasedTile(TileId tile) const;
+
+  struct AliasedTileEntry {
+    absl::once_flag applied;
+    AliasedTile tile;
+  };
+
+  // Has an entry for every tile type of the grid from the start, so the map
+  // itself is never modified and can be read without a lock. Each entry is
+  // loaded exactly once by the first thread that needs it; once loaded,
+  // reading it is a single atomic load.
+  struct SegmentsBitsCache {
+    struct Entry {
+      absl::once_flag loaded;
+      // nullptr if the tile type has no segbits.
+      std::shared_ptr<const SegmentsBitsWithPseudoPIPs> segbits;
+    };
+    absl::flat_hash_map<Symbol, std::unique_ptr<Entry>> entries;
+  };
+
+  // Key of the resolution cache; lookups use a view of the same fields so
+  // that no strings need to be copied. Features are not interned, so that
+  // looking them up takes no global lock and unknown ones do not grow the
+  // symbol table.
+  struct ResolutionKeyView {
+    TileId tile;
+    std::string_view feature;
+    uint32_t address;
+  };
+  struct ResolutionKey {
+    TileId tile;
+    std::string feature;
+    uint32_t address;
+    ResolutionKeyView view() const { return {tile, feature, address}; }
+  };
+  struct ResolutionKeyHash {
+    using is_transparent = void;
+    size_t operator()(const ResolutionKeyView &key) const {
+      return absl::HashOf(key.tile, key.feature, key.address);
+    }
+    size_t operator()(const ResolutionKey &key) const {
+      return (*this)(key.view());
+    }
+  };
+  struct ResolutionKeyEq {
+    using is_transparent = void;
+    static ResolutionKeyView View(const ResolutionKeyView &key) { return key; }
+    static ResolutionKeyView View(const ResolutionKey &key) {
+      return key.view();
+    }
+    template <typename A, typename B>
+    bool operator()(const A &a, const B &b) const {
+      const ResolutionKeyView va = View(a);
+      const ResolutionKeyView vb = View(b);
+      return va.address == vb.address && va.tile == vb.tile &&
+             va.feature == vb.feature;
+    }
+  };
+
+  // Same as the segbits cache, entries are never modified once inserted;
+  // they are shared, so that they outlive the cache starting over.
+  struct ResolutionCache {
+    explicit ResolutionCache(size_t max_entries) : max_entries(max_entries) {}
+    const size_t max_entries;
+    absl::Mutex mu;
+    absl::flat_hash_map<ResolutionKey, std::shared_ptr<const ResolvedBits>,
+                        ResolutionKeyHash, ResolutionKeyEq>
+      entries ABSL_GUARDED_BY(mu);
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> misses = 0;
+  };
 
   std::shared_ptr<Tiles> tiles_;
-  absl::flat_hash_map<std::string, SegmentsBitsWithPseudoPIPs>
-    segment_bits_cache_;
+  std::shared_ptr<const FeatureIndex> feature_index_;
+  std::vector<std::string> sources_;
+  std::unique_ptr<SegmentsBitsCache> segment_bits_cache_;
+  // Indexed by tile id.
+  std::unique_ptr<AliasedTileEntry[]> aliased_tiles_;
+  // nullptr unless enabled.
+  std::unique_ptr<ResolutionCache> resolution_cache_;
 };
 }  // namespace fpga
 #endif  // FPGA_DATABASE_H
@@ -1,13 +1,22 @@
 #include "fpga/database.h"
 
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "fpga/database-parsers.h"
+#include "fpga/feature-index.h"
+#include "fpga/lazy-tile-grid.h"
+#include "fpga/packed-segments-bits.h"
+#include "fpga/thread-pool.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -21,30 +30,37 @@ struct CorrectMappingAndTileNamesTestCase {
 };
 
 // Tile names should be unique per bank. The IOBank locations should be
-// prepended by "HCLK_IOI3_" to make the final tile name.
+// prepended by "HCLK_IOI3_" to make the final tile name. Tiles that are not
+// in the grid are left out.
 TEST(BanksTilesRegistry, CorrectMappingAndTileNames) {
+  TileGrid tiles;
+  for (const char *name : {"HCLK_IOI3_X1Y78", "HCLK_IOI3_X2Y43", "LIOB33_X0Y93",
+                           "HCLK_IOI3_X1Y79"}) {
+    tiles[name].type = Symbol("NULL");
+  }
+  const LazyTileGrid grid(std::move(tiles));
   // clang-format off
   const struct CorrectMappingAndTileNamesTestCase kTestCases[] = {{
       .part = {
-        {}, {}, IOBanksIDsToLocation{{0, "X1Y78"}, {3, "X2Y43"}, {4, "X1Y78"}}
+        {}, {}, IOBanksIDsToLocation{{0, "X1Y78"}, {3, "X2Y43"}, {4, "X1Y78"},
+                                     {5, "X9Y9"}}
       },
       .package_pins = {
-        {{}, 0, {}, "LIOB33_X0Y93", {}},
-        {{}, 216, {}, "GTP_CHANNEL_1_X97Y121", {}},
-        {{}, 0, {}, "HCLK_IOI3_X1Y79", {}}
+        {{}, 0, {}, Symbol("LIOB33_X0Y93"), {}},
+        {{}, 216, {}, Symbol("GTP_CHANNEL_1_X97Y121"), {}},
+        {{}, 0, {}, Symbol("HCLK_IOI3_X1Y79"), {}}
       },
       .expected_banks_tiles_res = {{
           {0, {"HCLK_IOI3_X1Y78", "LIOB33_X0Y93", "HCLK_IOI3_X1Y79"}},
           {3, {"HCLK_IOI3_X2Y43"}},
-          {4, {"HCLK_IOI3_X1Y78"}},
-          {216, {"GTP_CHANNEL_1_X97Y121"}}}
+          {4, {"HCLK_IOI3_X1Y78"}}}
       },
     },
   };
   // clang-format on
   for (const auto &test : kTestCases) {
     const absl::StatusOr<BanksTilesRegistry> res =
-      BanksTilesRegistry::Create(test.part, test.package_pins);
+      BanksTilesRegistry::Create(test.part, test.package_pins, grid);
     if (test.expected_banks_tiles_res.ok()) {
       ASSERT_TRUE(res.ok()) << res.status().message();
     }
@@ -55,9 +71,11 @@ TEST(BanksTilesRegistry, CorrectMappingAndTileNames) {
       const auto maybe_tiles = registry.Tiles(pair.first);
       ASSERT_TRUE(maybe_tiles.has_value());
       // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
-      const std::vector<std::string> &tiles_vector = maybe_tiles.value();
-      const absl::flat_hash_set<std::string> actual_tiles(tiles_vector.begin(),
-                                                          tiles_vector.end());
+      const std::vector<TileId> &tiles_vector = maybe_tiles.value();
+      absl::flat_hash_set<std::string> actual_tiles;
+      for (const TileId tile : tiles_vector) {
+        actual_tiles.insert(grid.name(tile));
+      }
       // Vector must have unique elements (tile names).
       EXPECT_EQ(tiles_vector.size(), actual_tiles.size());
 
@@ -66,13 +84,217 @@ TEST(BanksTilesRegistry, CorrectMappingAndTileNames) {
       EXPECT_EQ(actual_tiles, expected_tiles);
 
       // Check all the tiles can be mapped back to the bank.
-      for (const auto &tile : tiles_vector) {
+      for (const TileId tile : tiles_vector) {
         const std::vector<uint32_t> banks = registry.TileBanks(tile);
         ASSERT_FALSE(banks.empty());
         EXPECT_THAT(banks, ::testing::Contains(pair.first));
       }
     }
+    EXPECT_FALSE(registry.Tiles(5).has_value());
+    EXPECT_FALSE(registry.Tiles(216).has_value());
+  }
+}
+
+// CLBLL_L tiles from CLBLL_L_X2Y10 up at frame base address 0x100 and word
+// offset 2 whose segbits count the calls to the database.
+std::shared_ptr<PartDatabase::Tiles> TestTiles(int &segbits_loads,
+                                               int tile_count = 1) {
+  TileGrid grid;
+  Tile tile;
+  tile.type = Symbol("CLBLL_L");
+  tile.bits[ConfigBusType::kCLBIOCLK] = {
+    .alias = {}, .base_address = 0x100, .frames = 36, .offset = 2, .words = 2};
+  for (int i = 0; i < tile_count; ++i) {
+    grid.emplace("CLBLL_L_X2Y" + std::to_string(10 + i), tile);
+  }
+  auto bits = [&segbits_loads](const std::string &tile_type)
+    -> std::optional<SegmentsBitsWithPseudoPIPs> {
+    ++segbits_loads;
+    SegmentsBits clb;
+    clb[{"CLBLL_L.SLICEL_X0.ALUT.INIT", 3}] = {{1, 5, true}, {2, 40, false}};
+    SegmentsBitsWithPseudoPIPs segbits;
+    segbits.segment_bits.emplace(ConfigBusType::kCLBIOCLK,
+                                 PackSegmentsBits(clb).value());
+    return segbits;
+  };
+  LazyTileGrid tiles(std::move(grid));
+  auto banks = BanksTilesRegistry::Create(Part{}, PackagePins{}, tiles);
+  return std::make_shared<PartDatabase::Tiles>(
+    std::move(tiles), std::move(bits), std::move(banks.value()), Part{});
+}
+
+TEST(PartDatabase, ConfigBitsReplaysResolvedBitsFromCache) {
+  int segbits_loads = 0;
+  PartDatabase db(TestTiles(segbits_loads));
+  db.EnableResolutionCache(16);
+  const TileId tile = db.tiles().grid.FindId("CLBLL_L_X2Y10").value();
+  using Bit = std::tuple<ConfigBusType, uint32_t, uint32_t, uint32_t, bool>;
+  const std::vector<Bit> expected = {
+    {ConfigBusType::kCLBIOCLK, 0x101, 2, 5, true},
+    {ConfigBusType::kCLBIOCLK, 0x102, 3, 8, false},
+  };
+  for (int i = 0; i < 3; ++i) {
+    std::vector<Bit> bits;
+    db.ConfigBits(tile, "SLICEL_X0.ALUT.INIT", 3,
+                  [&bits](ConfigBusType bus, uint32_t address,
+                          const PartDatabase::FrameBit &bit, bool value) {
+                    bits.emplace_back(bus, address, bit.word, bit.index, value);
+                  });
+    EXPECT_EQ(bits, expected);
+  }
+  EXPECT_EQ(segbits_loads, 1);
+  const PartDatabase::ResolutionCacheStats stats = db.resolution_cache_stats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST(PartDatabase, ResolutionCacheIsOptInAndBounded) {
+  int segbits_loads = 0;
+  PartDatabase db(TestTiles(segbits_loads, 2));
+  const TileId tile = db.tiles().grid.FindId("CLBLL_L_X2Y10").value();
+  const TileId other_tile = db.tiles().grid.FindId("CLBLL_L_X2Y11").value();
+  int bit_count = 0;
+  auto count_bits = [&bit_count](ConfigBusType, uint32_t,
+                                 const PartDatabase::FrameBit &,
+                                 bool) { ++bit_count; };
+  db.ConfigBits(tile, "SLICEL_X0.ALUT.INIT", 3, count_bits);
+  db.ConfigBits(tile, "SLICEL_X0.ALUT.INIT", 3, count_bits);
+  EXPECT_EQ(bit_count, 4);
+  EXPECT_EQ(db.resolution_cache_stats().misses, 0);
+
+  // With room for a single entry, the cache starts over on every miss.
+  db.EnableResolutionCache(1);
+  for (const TileId id : {tile, tile, other_tile, tile}) {
+    db.ConfigBits(id, "SLICEL_X0.ALUT.INIT", 3, count_bits);
   }
+  EXPECT_EQ(bit_count, 12);
+  const PartDatabase::ResolutionCacheStats stats = db.resolution_cache_stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+}
+
+TEST(PartDatabase, ConcurrentConfigBitsLoadSegbitsOnce) {
+  int segbits_loads = 0;
+  PartDatabase db(TestTiles(segbits_loads));
+  const TileId tile = db.tiles().grid.FindId("CLBLL_L_X2Y10").value();
+  ThreadPool pool(8);
+  std::vector<int> bit_counts(64);
+  pool.ParallelFor(bit_counts.size(), [&db, tile, &bit_counts](size_t i) {
+    db.ConfigBits(tile, "SLICEL_X0.ALUT.INIT", 3,
+                  [&bit_counts, i](ConfigBusType, uint32_t,
+                                   const PartDatabase::FrameBit &,
+                                   bool) { ++bit_counts[i]; });
+  });
+  EXPECT_EQ(segbits_loads, 1);
+  EXPECT_THAT(bit_counts, ::testing::Each(2));
+}
+
+TEST(PartDatabase, ForEachFeatureBitsMatchesConfigBits) {
+  int segbits_loads = 0;
+  PartDatabase db(TestTiles(segbits_loads));
+  int calls = 0;
+  db.ForEachFeatureBits([&calls](const std::string &tile_name,
+                                 const std::string &feature, uint32_t address,
+                                 const std::vector<IndexedBit> &bits) {
+    ++calls;
+    EXPECT_EQ(tile_name, "CLBLL_L_X2Y10");
+    EXPECT_EQ(feature, "SLICEL_X0.ALUT.INIT");
+    EXPECT_EQ(address, 3);
+    ASSERT_EQ(bits.size(), 2);
+    EXPECT_EQ(bits[1].frame_address(), 0x102);
+    EXPECT_EQ(bits[1].word(), 3);
+    EXPECT_EQ(bits[1].index(), 8);
+    EXPECT_FALSE(bits[1].value());
+  });
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(db.resolution_cache_stats().misses, 0);
+}
+
+TEST(PartDatabase, ConfigBitsResolvesAliasedTiles) {
+  TileGrid grid;
+  Tile &tile = grid["LIOB33_X0Y1"];
+  tile.type = Symbol("LIOB33");
+  tile.bits[ConfigBusType::kCLBIOCLK] = {
+    .alias = BitsBlockAlias{.sites = {}, .start_offset = 1,
+                            .type = Symbol("LIOB33_SING")},
+    .base_address = 0x200,
+    .frames = 42,
+    .offset = 3,
+    .words = 2};
+  std::vector<std::string> loaded;
+  auto bits = [&loaded](const std::string &tile_type)
+    -> std::optional<SegmentsBitsWithPseudoPIPs> {
+    loaded.push_back(tile_type);
+    SegmentsBits iob;
+    iob[{"LIOB33_SING.IOB_Y0.PULLTYPE.PULLUP", 0}] = {{1, 5, true}};
+    SegmentsBitsWithPseudoPIPs segbits;
+    segbits.segment_bits.emplace(ConfigBusType::kCLBIOCLK,
+                                 PackSegmentsBits(iob).value());
+    return segbits;
+  };
+  LazyTileGrid tiles(std::move(grid));
+  auto banks = BanksTilesRegistry::Create(Part{}, PackagePins{}, tiles);
+  PartDatabase db(std::make_shared<PartDatabase::Tiles>(
+    std::move(tiles), std::move(bits), std::move(banks.value()), Part{}));
+  const TileId id = db.tiles().grid.FindId("LIOB33_X0Y1").value();
+  using Bit = std::tuple<ConfigBusType, uint32_t, uint32_t, uint32_t, bool>;
+  std::vector<Bit> set_bits;
+  db.ConfigBits(id, "IOB_Y0.PULLTYPE.PULLUP", 0,
+                [&set_bits](ConfigBusType bus, uint32_t address,
+                            const PartDatabase::FrameBit &bit, bool value) {
+                  set_bits.emplace_back(bus, address, bit.word, bit.index,
+                                        value);
+                });
+  // The offset of the tile is relative to the start of the aliased type.
+  EXPECT_THAT(set_bits, ::testing::ElementsAre(Bit{ConfigBusType::kCLBIOCLK,
+                                                   0x201, 2, 5, true}));
+  EXPECT_THAT(loaded, ::testing::ElementsAre("LIOB33_SING"));
+}
+
+TEST(PartDatabase, PrefetchSegbitsLoadsTileTypesOfTilesOnce) {
+  TileGrid grid;
+  grid["CLBLL_L_X2Y10"].type = Symbol("CLBLL_L");
+  grid["CLBLL_L_X2Y11"].type = Symbol("CLBLL_L");
+  grid["CLBLM_R_X3Y10"].type = Symbol("CLBLM_R");
+  Tile &aliased = grid["LIOB33_X0Y1"];
+  aliased.type = Symbol("LIOB33");
+  aliased.bits[ConfigBusType::kCLBIOCLK].alias =
+    BitsBlockAlias{.sites = {},
+                   .start_offset = 0,
+                   .type = Symbol("LIOB33_SING")};
+  absl::Mutex mu;
+  std::vector<std::string> loaded;
+  auto bits = [&mu, &loaded](const std::string &tile_type)
+    -> std::optional<SegmentsBitsWithPseudoPIPs> {
+    const absl::MutexLock lock(&mu);
+    loaded.push_back(tile_type);
+    return SegmentsBitsWithPseudoPIPs{};
+  };
+  LazyTileGrid tiles(std::move(grid));
+  auto id = [&tiles](const char *name) { return tiles.FindId(name).value(); };
+  const absl::flat_hash_set<TileId> first = {
+    id("CLBLL_L_X2Y10"), id("CLBLL_L_X2Y11"), id("LIOB33_X0Y1")};
+  const absl::flat_hash_set<TileId> second = {id("CLBLL_L_X2Y10"),
+                                              id("CLBLM_R_X3Y10")};
+  auto banks = BanksTilesRegistry::Create(Part{}, PackagePins{}, tiles);
+  PartDatabase db(std::make_shared<PartDatabase::Tiles>(
+    std::move(tiles), std::move(bits), std::move(banks.value()), Part{}));
+
+  ThreadPool pool(4);
+  db.PrefetchSegbits(first, pool);
+  EXPECT_THAT(loaded,
+              ::testing::UnorderedElementsAre("CLBLL_L", "LIOB33_SING"));
+  // Cached tile types are not loaded again.
+  db.PrefetchSegbits(second, pool);
+  EXPECT_THAT(loaded, ::testing::UnorderedElementsAre("CLBLL_L", "LIOB33_SING",
+                                                      "CLBLM_R"));
+}
+
+TEST(PartDatabase, ParseReportsMissingDatabase) {
+  // All the loading steps fail, the first one in dependency order is reported.
+  const absl::StatusOr<PartDatabase> db = PartDatabase::Parse(
+    testing::TempDir() + "/no-such-database", "xc7a35tcsg324-1");
+  EXPECT_FALSE(db.ok());
 }
 }  // namespace
 }  // namespace fpga
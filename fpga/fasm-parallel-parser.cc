@@ -0,0 +1,85 @@
+#include "fpga/fasm-parallel-parser.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "fpga/fasm-parser.h"
+#include "fpga/thread-pool.h"
+
+namespace fpga {
+std::vector<FasmChunk> SplitFasmChunks(std::string_view content,
+                                       size_t max_chunks, ThreadPool &pool) {
+  std::vector<FasmChunk> chunks;
+  if (content.empty()) {
+    return chunks;
+  }
+  max_chunks = std::max<size_t>(max_chunks, 1);
+  const size_t target_size = (content.size() + max_chunks - 1) / max_chunks;
+  size_t start = 0;
+  while (start < content.size()) {
+    size_t cut = std::min(start + target_size, content.size());
+    if (cut < content.size()) {
+      // Extend the chunk to include the rest of the line it ends in.
+      const size_t newline = content.find('\n', cut - 1);
+      cut = (newline == std::string_view::npos) ? content.size() : newline + 1;
+    }
+    chunks.push_back({content.substr(start, cut - start), 0});
+    start = cut;
+  }
+
+  // Count lines of each chunk, then turn the counts in absolute line numbers.
+  std::vector<uint32_t> line_counts(chunks.size());
+  pool.ParallelFor(chunks.size(), [&chunks, &line_counts](size_t i) {
+    const std::string_view chunk = chunks[i].content;
+    line_counts[i] = std::count(chunk.begin(), chunk.end(), '\n');
+  });
+  uint32_t line = 1;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    chunks[i].first_line = line;
+    line += line_counts[i];
+  }
+  return chunks;
+}
+
+fasm::ParseResult ParseFasmChunks(const std::vector<FasmChunk> &chunks,
+                                  ThreadPool &pool, FILE *errstream,
+                                  const FasmChunkParseCallback &callback) {
+  struct ChunkResult {
+    fasm::ParseResult result = fasm::ParseResult::kSuccess;
+    char *diagnostics = nullptr;
+    size_t diagnostics_size = 0;
+  };
+  std::vector<ChunkResult> results(chunks.size());
+  pool.ParallelFor(chunks.size(), [&](size_t i) {
+    ChunkResult &out = results[i];
+    FILE *chunk_errstream =
+      open_memstream(&out.diagnostics, &out.diagnostics_size);
+    out.result = fasm::Parse(
+      chunks[i].content, chunk_errstream ? chunk_errstream : errstream,
+      [&callback, i](uint32_t line, std::string_view feature, int start_bit,
+                     int width, uint64_t bits) {
+        return callback(i, line, feature, start_bit, width, bits);
+      },
+      {}, chunks[i].first_line);
+    if (chunk_errstream) {
+      fclose(chunk_errstream);
+    }
+  });
+
+  fasm::ParseResult result = fasm::ParseResult::kSuccess;
+  for (const ChunkResult &chunk_result : results) {
+    result = std::max(result, chunk_result.result);
+    if (chunk_result.diagnostics != nullptr) {
+      fwrite(chunk_result.diagnostics, 1, chunk_result.diagnostics_size,
+             errstream);
+      free(chunk_result.diagnostics);
+    }
+  }
+  return result;
+}
+}  // namespace fpga
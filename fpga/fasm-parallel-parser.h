@@ -0,0 +1,47 @@
+#ifndef FPGA_FASM_PARALLEL_PARSER_H
+#define FPGA_FASM_PARALLEL_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "fpga/fasm-parser.h"
+#include "fpga/thread-pool.h"
+
+namespace fpga {
+// Newline aligned slice of a FASM buffer.
+struct FasmChunk {
+  std::string_view content;
+
+  // Line number of the first line of the chunk within the whole buffer.
+  uint32_t first_line;
+};
+
+// Split "content" in at most "max_chunks" chunks of roughly the same size.
+// Every chunk but the last ends right after a newline, so each of them can
+// be handed to fasm::Parse() on its own. Line numbers are counted on the pool.
+std::vector<FasmChunk> SplitFasmChunks(std::string_view content,
+                                       size_t max_chunks, ThreadPool &pool);
+
+// Same as fasm::ParseCallback, but also receives the index of the chunk
+// the feature belongs to.
+using FasmChunkParseCallback =
+  std::function<bool(size_t chunk, uint32_t line, std::string_view feature,
+                     int start_bit, int width, uint64_t bits)>;
+
+// Parse all the chunks concurrently on "pool".
+// The callback is called concurrently for different chunks but sequentially,
+// in line order, for the features of the same chunk. Collecting the features
+// per chunk and concatenating them in chunk order gives the same sequence
+// as a serial parse.
+// Diagnostics are buffered per chunk and written to "errstream" in chunk
+// order, with line numbers relative to the whole buffer.
+// Returns the most severe result among all chunks.
+fasm::ParseResult ParseFasmChunks(const std::vector<FasmChunk> &chunks,
+                                  ThreadPool &pool, FILE *errstream,
+                                  const FasmChunkParseCallback &callback);
+}  // namespace fpga
+#endif  // FPGA_FASM_PARALLEL_PARSER_H
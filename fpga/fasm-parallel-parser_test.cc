@@ -0,0 +1,127 @@
+#include "fpga/fasm-parallel-parser.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "fpga/fasm-parser.h"
+#include "fpga/thread-pool.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+struct Feature {
+  uint32_t line;
+  std::string name;
+  int start_bit;
+  int width;
+  uint64_t bits;
+  bool operator==(const Feature &) const = default;
+};
+
+std::string MakeFasm(int lines) {
+  std::string out;
+  for (int i = 0; i < lines; ++i) {
+    if (i % 7 == 0) {
+      out += "# comment line\n";
+    } else if (i % 5 == 0) {
+      out += "\n";
+    } else {
+      absl::StrAppendFormat(&out, "TILE_X%dY%d.FEATURE[%d:0] = 8'h%02x\n", i,
+                            i / 3, 7, i & 0xff);
+    }
+  }
+  return out;
+}
+
+std::vector<Feature> SerialParse(std::string_view content) {
+  std::vector<Feature> out;
+  fasm::Parse(content, stderr,
+              [&out](uint32_t line, std::string_view name, int start_bit,
+                     int width, uint64_t bits) {
+                out.push_back({line, std::string(name), start_bit, width, bits});
+                return true;
+              });
+  return out;
+}
+
+std::vector<Feature> ChunkedParse(std::string_view content, size_t chunks,
+                                  ThreadPool &pool) {
+  const std::vector<FasmChunk> split = SplitFasmChunks(content, chunks, pool);
+  std::vector<std::vector<Feature>> per_chunk(split.size());
+  const fasm::ParseResult result = ParseFasmChunks(
+    split, pool, stderr,
+    [&per_chunk](size_t chunk, uint32_t line, std::string_view name,
+                 int start_bit, int width, uint64_t bits) {
+      per_chunk[chunk].push_back(
+        {line, std::string(name), start_bit, width, bits});
+      return true;
+    });
+  EXPECT_EQ(result, fasm::ParseResult::kSuccess);
+  std::vector<Feature> out;
+  for (const auto &features : per_chunk) {
+    out.insert(out.end(), features.begin(), features.end());
+  }
+  return out;
+}
+
+TEST(FasmParallelParser, ChunksAreNewlineAligned) {
+  ThreadPool pool(4);
+  const std::string content = MakeFasm(1000);
+  const std::vector<FasmChunk> chunks = SplitFasmChunks(content, 16, pool);
+  ASSERT_FALSE(chunks.empty());
+  EXPECT_LE(chunks.size(), 16);
+  size_t total = 0;
+  uint32_t expected_line = 1;
+  for (const FasmChunk &chunk : chunks) {
+    ASSERT_FALSE(chunk.content.empty());
+    EXPECT_EQ(chunk.content.back(), '\n');
+    EXPECT_EQ(chunk.first_line, expected_line);
+    expected_line += std::count(chunk.content.begin(), chunk.content.end(),
+                                '\n');
+    total += chunk.content.size();
+  }
+  EXPECT_EQ(total, content.size());
+}
+
+TEST(FasmParallelParser, SameFeaturesAndLinesAsSerialParse) {
+  ThreadPool pool(4);
+  const std::string content = MakeFasm(5000);
+  const std::vector<Feature> expected = SerialParse(content);
+  for (const size_t chunks : {1, 2, 3, 8, 64, 100000}) {
+    EXPECT_EQ(ChunkedParse(content, chunks, pool), expected) << chunks;
+  }
+}
+
+TEST(FasmParallelParser, DiagnosticsUseGlobalLineNumbers) {
+  ThreadPool pool(2);
+  std::string content = MakeFasm(100);
+  content += "BROKEN[3:0 = 1\n";
+  const std::vector<FasmChunk> chunks = SplitFasmChunks(content, 4, pool);
+  char *buffer = nullptr;
+  size_t size = 0;
+  FILE *errstream = open_memstream(&buffer, &size);
+  const fasm::ParseResult result = ParseFasmChunks(
+    chunks, pool, errstream,
+    [](size_t, uint32_t, std::string_view, int, int, uint64_t) {
+      return true;
+    });
+  fclose(errstream);
+  const std::string diagnostics(buffer, size);
+  free(buffer);
+  EXPECT_EQ(result, fasm::ParseResult::kError);
+  EXPECT_EQ(diagnostics.rfind("101: ERR", 0), 0) << diagnostics;
+}
+
+TEST(FasmParallelParser, EmptyContent) {
+  ThreadPool pool(2);
+  EXPECT_TRUE(SplitFasmChunks("", 4, pool).empty());
+}
+}  // namespace
+}  // namespace fpga
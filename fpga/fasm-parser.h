@@ -19,12 +19,19 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <functional>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace fasm {
 // Parse callback for FASM lines. The "feature" found in line number "line"
 // is set the values given in "bits", starting from lowest "start_bit" (lsb)
@@ -66,10 +73,42 @@ enum class ParseResult {
 // If there are warnings or errors, parsing will continue if possible.
 // The most severe issue found is returned.
 //
+// Lines are numbered starting at "first_line_number", which allows to parse
+// a file in pieces while still reporting line numbers relative to the whole
+// file.
+//
 // Spec: https://fasm.readthedocs.io/en/latest/specification/syntax.html
 inline ParseResult Parse(std::string_view content, FILE *errstream,
                          const ParseCallback &parse_callback,
-                         const AnnotationCallback &annotation_callback = {});
+                         const AnnotationCallback &annotation_callback = {},
+                         uint32_t first_line_number = 1);
+
+// Values up to this many bits are assembled without heap allocation.
+// Large enough for the common wide values such as 256 bit BRAM INIT.
+inline constexpr size_t kDefaultInlineValueBits = 256;
+
+// Same as above, but with the "parse_callback" being any callable with the
+// signature of ParseCallback. The callback is called directly instead of
+// through a std::function, which allows the compiler to inline it.
+//
+// Values up to "kInlineValueBits" wide are assembled in a buffer on the
+// stack; only wider values need to go to the heap.
+template <size_t kInlineValueBits = kDefaultInlineValueBits,
+          typename ParseFun>
+inline ParseResult Parse(std::string_view content, FILE *errstream,
+                         ParseFun &&parse_callback,
+                         const AnnotationCallback &annotation_callback = {},
+                         uint32_t first_line_number = 1);
+
+// Same as above, but with the words of values, least significant first,
+// assembled in "Values": any type with the parts of the std::vector<uint64_t>
+// interface used by the parser. It is cleared before every value. Allows
+// comparing how values are stored, e.g. in benchmarks.
+template <typename Values, typename ParseFun>
+inline ParseResult ParseWithValues(
+  std::string_view content, FILE *errstream, ParseFun &&parse_callback,
+  const AnnotationCallback &annotation_callback = {},
+  uint32_t first_line_number = 1);
 
 // -- End of API interface; rest is implementation details
 
@@ -128,6 +167,364 @@ inline constexpr char kValidIdentifier[256] = {
 };
 
 using bit_range_t = uint16_t;  // gcc slightly faster with 16 bit
+
+// Sequence of 64 bit words keeping the first "kInlineWords" in place and
+// only moving to the heap if more are needed. Subset of the std::vector
+// interface used by the parser.
+template <size_t kInlineWords>
+class ValueBuffer {
+ public:
+  static_assert(kInlineWords > 0, "Need at least one inline word");
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  uint64_t *begin() { return heap_.empty() ? inline_ : heap_.data(); }
+  uint64_t *end() { return begin() + size_; }
+  uint64_t &operator[](size_t i) { return begin()[i]; }
+  uint64_t &back() { return begin()[size_ - 1]; }
+
+  void push_back(uint64_t value) {
+    if (size_ < kInlineWords) {
+      inline_[size_++] = value;
+      return;
+    }
+    if (heap_.empty()) {
+      heap_.assign(inline_, inline_ + size_);
+    }
+    heap_.push_back(value);
+    ++size_;
+  }
+  void emplace_back() { push_back(0); }
+
+  // Empty the buffer; heap capacity is kept for the next value.
+  void clear() {
+    size_ = 0;
+    heap_.clear();
+  }
+
+ private:
+  uint64_t inline_[kInlineWords];
+  size_t size_ = 0;
+  std::vector<uint64_t> heap_;
+};
+
+// -- Scanning kernels.
+//
+// The hot loops of the parser (scanning identifiers, skipping to the end of
+// line and reading long binary/hex literals such as LUT or BRAM INIT values)
+// are provided as a set of kernels. Besides the portable scalar version there
+// are SSE4.2 and AVX2 versions on x86 that are picked at runtime depending
+// on what the CPU supports.
+//
+// All kernels get the current position "it" and the "end" of the buffer.
+// Vector loads never go beyond "end"; the tail is handled by the scalar code
+// which relies on the '\n' sentinel at the end of the buffer.
+
+// Returns the first position that is not a valid identifier character.
+using SkipIdentifierKernel = const char *(*)(const char *it, const char *end);
+
+// Returns the position of the next '\n'.
+using SkipToEolKernel = const char *(*)(const char *it, const char *end);
+
+// Reads a run of digits (binary or hexadecimal, depending on the kernel)
+// starting at "it". Returns the number of digits read and stores their value,
+// first digit most significant, in "value". At most 64 bits worth of digits
+// are read. Digit separators are not handled: the kernel stops there and lets
+// the caller take care of them. Returning zero means "no fast path here".
+using DigitsKernel = unsigned (*)(const char *it, const char *end,
+                                  uint64_t *value);
+
+enum class ScanLevel {
+  kScalar,
+  kSSE42,
+  kAVX2,
+};
+
+struct ScanKernels {
+  ScanLevel level;
+  SkipIdentifierKernel skip_identifier;
+  SkipToEolKernel skip_to_eol;
+  DigitsKernel binary_digits;
+  DigitsKernel hex_digits;
+};
+
+inline const char *SkipIdentifierScalar(const char *it, const char *) {
+  while (kValidIdentifier[(uint8_t)*it]) {
+    ++it;
+  }
+  return it;
+}
+
+inline const char *SkipToEolScalar(const char *it, const char *end) {
+  return static_cast<const char *>(memchr(it, '\n', end - it));
+}
+
+inline unsigned NoDigitsScalar(const char *, const char *, uint64_t *) {
+  return 0;
+}
+
+inline constexpr ScanKernels kScalarScanKernels = {
+  .level = ScanLevel::kScalar,
+  .skip_identifier = SkipIdentifierScalar,
+  .skip_to_eol = SkipToEolScalar,
+  .binary_digits = NoDigitsScalar,
+  .hex_digits = NoDigitsScalar,
+};
+
+// x86_64 only, the kernels use 64-bit intrinsics such as _mm_cvtsi128_si64.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FASM_HAVE_X86_KERNELS 1
+
+// Reverse the lowest "n" bits of "v" (1 <= n <= 32).
+inline uint32_t ReverseLowBits(uint32_t v, unsigned n) {
+  v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+  v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+  v = ((v >> 4) & 0x0F0F0F0Fu) | ((v & 0x0F0F0F0Fu) << 4);
+  v = __builtin_bswap32(v);
+  return v >> (32 - n);
+}
+
+__attribute__((target("sse4.2"))) inline const char *SkipIdentifierSSE42(
+  const char *it, const char *end) {
+  // Pairs of inclusive ranges of valid identifier characters.
+  const __m128i ranges = _mm_setr_epi8('.', '.', '0', '9', 'A', 'Z', '_', '_',
+                                       'a', 'z', 0, 0, 0, 0, 0, 0);
+  while (it + 16 <= end) {
+    const __m128i chars = _mm_loadu_si128((const __m128i *)it);
+    const int idx = _mm_cmpistri(
+      ranges, chars,
+      _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY);
+    if (idx < 16) return it + idx;
+    it += 16;
+  }
+  return SkipIdentifierScalar(it, end);
+}
+
+__attribute__((target("sse4.2"))) inline const char *SkipToEolSSE42(
+  const char *it, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (it + 16 <= end) {
+    const __m128i chars = _mm_loadu_si128((const __m128i *)it);
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline));
+    if (mask) return it + __builtin_ctz(mask);
+    it += 16;
+  }
+  return SkipToEolScalar(it, end);
+}
+
+__attribute__((target("sse4.2"))) inline unsigned BinaryDigitsSSE42(
+  const char *it, const char *end, uint64_t *value) {
+  if (it + 16 > end) return 0;
+  const __m128i chars = _mm_loadu_si128((const __m128i *)it);
+  // '0' and '1' only differ in the lowest bit.
+  const __m128i is_digit = _mm_cmpeq_epi8(
+    _mm_and_si128(chars, _mm_set1_epi8(~1)), _mm_set1_epi8('0'));
+  const unsigned valid = _mm_movemask_epi8(is_digit);
+  const unsigned count = __builtin_ctz(~valid | 0x10000u);
+  if (count == 0) return 0;
+  const unsigned ones =
+    _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('1')));
+  *value = ReverseLowBits(ones, count);
+  return count;
+}
+
+__attribute__((target("sse4.2"))) inline unsigned HexDigitsSSE42(
+  const char *it, const char *end, uint64_t *value) {
+  if (it + 16 > end) return 0;
+  const __m128i chars = _mm_loadu_si128((const __m128i *)it);
+  const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  const __m128i is_digit =
+    _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)),
+                                      _mm_set1_epi8('a'));
+  const __m128i is_letter =
+    _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+  const unsigned valid =
+    _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter));
+  const unsigned count = __builtin_ctz(~valid | 0x10000u);
+  if (count == 0) return 0;
+  const __m128i nibbles = _mm_or_si128(
+    _mm_and_si128(digit, is_digit),
+    _mm_and_si128(_mm_add_epi8(letter, _mm_set1_epi8(10)), is_letter));
+  // Combine pairs of nibbles to bytes, first character in the high nibble.
+  const __m128i bytes = _mm_packus_epi16(
+    _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110)), _mm_setzero_si128());
+  const uint64_t all = __builtin_bswap64(_mm_cvtsi128_si64(bytes));
+  // Get rid of whatever followed the digits.
+  *value = (count == 16) ? all : all >> (4 * (16 - count));
+  return count;
+}
+
+// True for each byte of "v" in the inclusive range [lo, hi].
+__attribute__((target("avx2"))) inline __m256i InRangeAVX2(__m256i v, char lo,
+                                                            char hi) {
+  const __m256i above_lo =
+    _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)), v);
+  const __m256i below_hi =
+    _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(hi)), v);
+  return _mm256_and_si256(above_lo, below_hi);
+}
+
+__attribute__((target("avx2"))) inline const char *SkipIdentifierAVX2(
+  const char *it, const char *end) {
+  while (it + 32 <= end) {
+    const __m256i chars = _mm256_loadu_si256((const __m256i *)it);
+    // Fold upper into lower case letters; no other valid character is
+    // affected in a way that would make it valid.
+    const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    __m256i valid = InRangeAVX2(lower, 'a', 'z');
+    valid = _mm256_or_si256(valid, InRangeAVX2(chars, '0', '9'));
+    valid = _mm256_or_si256(
+      valid, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('.')));
+    valid = _mm256_or_si256(
+      valid, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_')));
+    const uint32_t invalid = ~(uint32_t)_mm256_movemask_epi8(valid);
+    if (invalid) return it + __builtin_ctz(invalid);
+    it += 32;
+  }
+  return SkipIdentifierSSE42(it, end);
+}
+
+__attribute__((target("avx2"))) inline const char *SkipToEolAVX2(
+  const char *it, const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  while (it + 32 <= end) {
+    const __m256i chars = _mm256_loadu_si256((const __m256i *)it);
+    const uint32_t mask =
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, newline));
+    if (mask) return it + __builtin_ctz(mask);
+    it += 32;
+  }
+  return SkipToEolSSE42(it, end);
+}
+
+__attribute__((target("avx2"))) inline unsigned BinaryDigitsAVX2(
+  const char *it, const char *end, uint64_t *value) {
+  if (it + 32 > end) return BinaryDigitsSSE42(it, end, value);
+  const __m256i chars = _mm256_loadu_si256((const __m256i *)it);
+  const __m256i is_digit = _mm256_cmpeq_epi8(
+    _mm256_and_si256(chars, _mm256_set1_epi8(~1)), _mm256_set1_epi8('0'));
+  const uint32_t valid = _mm256_movemask_epi8(is_digit);
+  const unsigned count = (valid == ~0u) ? 32 : __builtin_ctz(~valid);
+  if (count == 0) return 0;
+  const uint32_t ones =
+    _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('1')));
+  *value = ReverseLowBits(ones, count);
+  return count;
+}
+
+inline constexpr ScanKernels kSSE42ScanKernels = {
+  .level = ScanLevel::kSSE42,
+  .skip_identifier = SkipIdentifierSSE42,
+  .skip_to_eol = SkipToEolSSE42,
+  .binary_digits = BinaryDigitsSSE42,
+  .hex_digits = HexDigitsSSE42,
+};
+
+inline constexpr ScanKernels kAVX2ScanKernels = {
+  .level = ScanLevel::kAVX2,
+  .skip_identifier = SkipIdentifierAVX2,
+  .skip_to_eol = SkipToEolAVX2,
+  .binary_digits = BinaryDigitsAVX2,
+  // 16 hex digits already fill a 64 bit word, wider vectors don't help.
+  .hex_digits = HexDigitsSSE42,
+};
+#endif
+
+// Returns true if the kernels of the given level can run on this CPU.
+inline bool IsScanLevelSupported(ScanLevel level) {
+  switch (level) {
+  case ScanLevel::kScalar: return true;
+#ifdef FASM_HAVE_X86_KERNELS
+  case ScanLevel::kSSE42:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  case ScanLevel::kAVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2");
+#endif
+  default: return false;
+  }
+}
+
+// Kernels for the given level; falls back to scalar if not compiled in.
+inline const ScanKernels &GetScanKernels(ScanLevel level) {
+#ifdef FASM_HAVE_X86_KERNELS
+  switch (level) {
+  case ScanLevel::kAVX2: return kAVX2ScanKernels;
+  case ScanLevel::kSSE42: return kSSE42ScanKernels;
+  default: break;
+  }
+#endif
+  return kScalarScanKernels;
+}
+
+// Kernels used by Parse(). Initialized with the best level supported by the
+// CPU; can be changed, e.g. by tests, to force a particular implementation.
+inline const ScanKernels *&ActiveScanKernels() {
+  static const ScanKernels *kernels = [] {
+    for (const ScanLevel level : {ScanLevel::kAVX2, ScanLevel::kSSE42}) {
+      if (IsScanLevelSupported(level)) return &GetScanKernels(level);
+    }
+    return &kScalarScanKernels;
+  }();
+  return kernels;
+}
+
+// Append "count" digits of "l2base" bits each, given in "value" most
+// significant first, to the words in "v". Words are filled up to 64 bits
+// before a new one is started; "n" is the total number of bits so far.
+template <typename Words>
+inline void AppendDigits(Words &v, unsigned &n, uint64_t value, unsigned count,
+                         unsigned l2base) {
+  while (count > 0) {
+    if ((n % 64) == 0) v.emplace_back();
+    const unsigned room = (64 - (n % 64)) / l2base;
+    const unsigned take = std::min(room, count);
+    const unsigned take_bits = take * l2base;
+    const unsigned rest_bits = (count - take) * l2base;
+    uint64_t chunk = (rest_bits >= 64) ? 0 : value >> rest_bits;
+    if (take_bits < 64) {
+      chunk &= (uint64_t(1) << take_bits) - 1;
+      v.back() = (v.back() << take_bits) | chunk;
+    } else {
+      v.back() = chunk;
+    }
+    n += take_bits;
+    count -= take;
+  }
+}
+
+// Parse a number with power-of-2 base into words of 64 bit, least
+// significant word first.
+template <typename Words>
+inline const char *ParseLongNumber(const char *it, const char *end,
+                                   unsigned l2base, const ScanKernels &kernels,
+                                   Words &v) {
+  const DigitsKernel fast_digits = (l2base == 1)   ? kernels.binary_digits
+                                   : (l2base == 4) ? kernels.hex_digits
+                                                   : NoDigitsScalar;
+  unsigned n = 0;
+  for (;;) {
+    uint64_t value;
+    const unsigned count = fast_digits(it, end, &value);
+    if (count > 0) {
+      AppendDigits(v, n, value, count, l2base);
+      it += count;
+      continue;
+    }
+    const int8_t d = kDigitToInt[(uint8_t)*it];
+    if (d >= (1 << l2base)) break;
+    if (d != kDigitSeparator) {
+      AppendDigits(v, n, d, 1, l2base);
+    }
+    ++it;
+  }
+  if (v.empty()) v.emplace_back();
+  std::reverse(v.begin(), v.end());
+  return it;
+}
 }  // namespace internal
 
 // [[unlikely]] only available since c++20, so use gcc/clang builtin here.
@@ -138,8 +535,7 @@ using bit_range_t = uint16_t;  // gcc slightly faster with 16 bit
   while (*it == ' ' || *it == '\t') ++it
 
 // Skip forward until we sit on the '\n' end of current line.
-#define fasm_skip_to_eol() \
-  while (*it != '\n') ++it
+#define fasm_skip_to_eol() it = kernels.skip_to_eol(it, end)
 
 // Skip forward beyond the end of current line. To be used before 'continue'.
 #define fasm_skip_to_start_of_next_line() \
@@ -155,25 +551,33 @@ using bit_range_t = uint16_t;  // gcc slightly faster with 16 bit
       (v) = (v) * (base) + d
 
 // Parse big number with given power-of-2 base
-#define fasm_parse_long_number_with_base(v, l2base)                         \
-  fasm_skip_blank();                                                        \
-  {                                                                         \
-    unsigned n = 0;                                                         \
-    for (int8_t d;                                                          \
-         (d = internal::kDigitToInt[(uint8_t)*it]) < (1 << (l2base)); ++it) \
-      if (d == internal::kDigitSeparator) {                                 \
-      } else {                                                              \
-        if ((n % 64) == 0) (v).emplace_back();                              \
-        (v).back() = (v).back() * (1 << (l2base)) + d;                      \
-        n += (l2base);                                                      \
-      }                                                                     \
-  }                                                                         \
-  if ((v).empty()) (v).emplace_back();                                      \
-  std::reverse((v).begin(), (v).end());
+#define fasm_parse_long_number_with_base(v, l2base) \
+  fasm_skip_blank();                                \
+  it = internal::ParseLongNumber(it, end, (l2base), kernels, (v))
 
 inline ParseResult Parse(std::string_view content, FILE *errstream,
                          const ParseCallback &parse_callback,
-                         const AnnotationCallback &annotation_callback) {
+                         const AnnotationCallback &annotation_callback,
+                         uint32_t first_line_number) {
+  return Parse<kDefaultInlineValueBits, const ParseCallback &>(
+    content, errstream, parse_callback, annotation_callback,
+    first_line_number);
+}
+
+template <size_t kInlineValueBits, typename ParseFun>
+inline ParseResult Parse(std::string_view content, FILE *errstream,
+                         ParseFun &&parse_callback,
+                         const AnnotationCallback &annotation_callback,
+                         uint32_t first_line_number) {
+  return ParseWithValues<internal::ValueBuffer<(kInlineValueBits + 63) / 64>>(
+    content, errstream, std::forward<ParseFun>(parse_callback),
+    annotation_callback, first_line_number);
+}
+
+template <typename Values, typename ParseFun>
+inline ParseResult ParseWithValues(
+  std::string_view content, FILE *errstream, ParseFun &&parse_callback,
+  const AnnotationCallback &annotation_callback, uint32_t first_line_number) {
   if (content.empty()) {
     return ParseResult::kSuccess;
   }
@@ -183,10 +587,12 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
     return ParseResult::kError;
   }
 
+  const internal::ScanKernels &kernels = *internal::ActiveScanKernels();
   ParseResult result = ParseResult::kSuccess;
   const char *it = content.data();
   const char *const end = content.data() + content.size();
-  uint32_t line_number = 0;
+  uint32_t line_number = first_line_number - 1;
+  Values bitset;
   while (it < end) {
     ++line_number;
     fasm_skip_blank();
@@ -195,9 +601,7 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
     // (dot, digit, or underscore) which is entirely sufficient for the parsing
     // part. The receiver of the feature name will notice semantic issues.
     const char *const start_feature = it;
-    while (internal::kValidIdentifier[(uint8_t)*it]) {
-      ++it;
-    }
+    it = kernels.skip_identifier(it, end);
     const std::string_view feature{start_feature, size_t(it - start_feature)};
     fasm_skip_blank();
 
@@ -237,7 +641,7 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
 
       uint32_t width = (max_bit - min_bit + 1);
 
-      std::vector<uint64_t> bitset;
+      bitset.clear();
 
       // Assignment.
       if (*it == '=') {
@@ -331,7 +735,7 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
 
       // Ready to report the feature and their bits.
       for (unsigned chunk = 0; chunk < bitset.size(); chunk++) {
-        auto value = bitset.at(chunk);
+        auto value = bitset[chunk];
         unsigned value_width = 64;
         if (chunk == (bitset.size() - 1)) {
           value_width = unsigned(width - 64 * (bitset.size() - 1));
@@ -354,9 +758,7 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
           ++it;  // skip '{' or ','
           fasm_skip_blank();
           const char *const start_name = it;
-          while (internal::kValidIdentifier[(uint8_t)*it]) {
-            ++it;
-          }
+          it = kernels.skip_identifier(it, end);
           const std::string_view aname{start_name, size_t(it - start_name)};
 
           fasm_skip_blank();
@@ -424,6 +826,7 @@ inline ParseResult Parse(std::string_view content, FILE *errstream,
   return result;
 }
 
+#undef fasm_parse_long_number_with_base
 #undef fasm_parse_number_with_base
 #undef fasm_skip_to_start_of_next_line
 #undef fasm_skip_to_eol
@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fpga/fasm-parser.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FASM_BENCHMARK_HAVE_RDTSC 1
+#endif
+
+namespace {
+constexpr int kLines = 100'000;
+
+// Synthetic FASM file with a typical mix of lines: mostly single bit
+// features, some 64 bit LUT INIT values and a few 256 bit BRAM INIT values.
+const std::string &FasmContent() {
+  static const std::string content = [] {
+    std::mt19937_64 rnd(42);
+    std::string result;
+    char buf[128];
+    for (int i = 0; i < kLines; ++i) {
+      const int x = rnd() % 100;
+      const int y = rnd() % 200;
+      switch (rnd() % 10) {
+      case 0:
+      case 1:
+        snprintf(buf, sizeof(buf),
+                 "CLBLL_L_X%dY%d.SLICEL_X0.ALUT.INIT[63:0] = 64'h%016llx\n", x,
+                 y, static_cast<unsigned long long>(rnd()));
+        result += buf;
+        break;
+      case 2:
+        snprintf(buf, sizeof(buf),
+                 "BRAM_L_X%dY%d.RAMB18_Y0.INIT_%02X[255:0] = 256'h", x, y,
+                 i % 64);
+        result += buf;
+        for (int w = 0; w < 4; ++w) {
+          snprintf(buf, sizeof(buf), "%016llx",
+                   static_cast<unsigned long long>(rnd()));
+          result += buf;
+        }
+        result += "\n";
+        break;
+      default:
+        snprintf(buf, sizeof(buf),
+                 "INT_L_X%dY%d.NL1BEG%d.NN2END%d # routing\n", x, y, i % 4,
+                 i % 3);
+        result += buf;
+        break;
+      }
+    }
+    return result;
+  }();
+  return content;
+}
+
+template <typename ParseFn>
+void RunParseBenchmark(benchmark::State &state, ParseFn parse) {
+  const std::string &content = FasmContent();
+  uint64_t checksum = 0;
+#ifdef FASM_BENCHMARK_HAVE_RDTSC
+  uint64_t cycles = 0;
+#endif
+  for (auto _ : state) {
+#ifdef FASM_BENCHMARK_HAVE_RDTSC
+    const uint64_t start = __rdtsc();
+#endif
+    parse(content, &checksum);
+#ifdef FASM_BENCHMARK_HAVE_RDTSC
+    cycles += __rdtsc() - start;
+#endif
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * kLines);
+  state.SetBytesProcessed(state.iterations() * content.size());
+#ifdef FASM_BENCHMARK_HAVE_RDTSC
+  state.counters["cycles/line"] =
+    static_cast<double>(cycles) / (state.iterations() * kLines);
+#endif
+}
+
+// The words of values as the parser kept them before ValueBuffer: in a
+// std::vector created for every line, so every value allocates.
+class PerLineVector : public std::vector<uint64_t> {
+ public:
+  void clear() { std::vector<uint64_t>().swap(*this); }
+};
+
+// The parser before the inlined callback and value buffer: callback through
+// std::function and values in a std::vector per line.
+void BM_ParseBaseline(benchmark::State &state) {
+  RunParseBenchmark(state, [](std::string_view content, uint64_t *checksum) {
+    const fasm::ParseCallback callback =
+      [checksum](uint32_t, std::string_view feature, int start_bit, int width,
+                 uint64_t bits) {
+        *checksum += feature.size() + start_bit + width + bits;
+        return true;
+      };
+    fasm::ParseWithValues<PerLineVector, const fasm::ParseCallback &>(
+      content, stderr, callback);
+  });
+}
+BENCHMARK(BM_ParseBaseline);
+
+// Callback through std::function, values in the inline buffer.
+void BM_ParseStdFunction(benchmark::State &state) {
+  RunParseBenchmark(state, [](std::string_view content, uint64_t *checksum) {
+    const fasm::ParseCallback callback =
+      [checksum](uint32_t, std::string_view feature, int start_bit, int width,
+                 uint64_t bits) {
+        *checksum += feature.size() + start_bit + width + bits;
+        return true;
+      };
+    fasm::Parse(content, stderr, callback);
+  });
+}
+BENCHMARK(BM_ParseStdFunction);
+
+// Inlined callback; with a single inline word, wide values use the heap.
+void BM_ParseTemplateHeapValues(benchmark::State &state) {
+  RunParseBenchmark(state, [](std::string_view content, uint64_t *checksum) {
+    fasm::Parse<64>(content, stderr,
+                    [checksum](uint32_t, std::string_view feature,
+                               int start_bit, int width, uint64_t bits) {
+                      *checksum += feature.size() + start_bit + width + bits;
+                      return true;
+                    });
+  });
+}
+BENCHMARK(BM_ParseTemplateHeapValues);
+
+// Inlined callback, all values fit in the inline buffer.
+void BM_ParseTemplate(benchmark::State &state) {
+  RunParseBenchmark(state, [](std::string_view content, uint64_t *checksum) {
+    fasm::Parse(content, stderr,
+                [checksum](uint32_t, std::string_view feature, int start_bit,
+                           int width, uint64_t bits) {
+                  *checksum += feature.size() + start_bit + width + bits;
+                  return true;
+                });
+  });
+}
+BENCHMARK(BM_ParseTemplate);
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -14,9 +14,11 @@
 
 #include "fpga/fasm-parser.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <iostream>
+#include <random>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -201,6 +203,24 @@ void LongValueParseTest() {
        {64, 64, 0xDEADBEEFDEADBEEFUL},
        {128, 64, 0x0123456789ABCDEFUL},
      }},
+
+    // Long enough to exercise vector kernels including the digit separator.
+    {"ASSIGN_LONG_BINARY_WITH_A_VERY_LONG_FEATURE_NAME[127:0] = 128'b"
+     "1010101010101010101010101010101010101010101010101010101010101010"
+     "1111000011110000111100001111000011110000111100001111000011110000",
+     ParseResult::kSuccess,  //
+     "ASSIGN_LONG_BINARY_WITH_A_VERY_LONG_FEATURE_NAME",
+     {
+       {0, 64, 0xF0F0F0F0F0F0F0F0UL},
+       {64, 64, 0xAAAAAAAAAAAAAAAAUL},
+     }},
+    {"ASSIGN_LONG_HEX[127:0] = 128'h0123_4567_89ab_cdef_FEDC_BA98_7654_3210",
+     ParseResult::kSuccess,  //
+     "ASSIGN_LONG_HEX",
+     {
+       {0, 64, 0xFEDCBA9876543210UL},
+       {64, 64, 0x0123456789ABCDEFUL},
+     }},
   };
 
   for (const LongValueTestCase &expected : tests) {
@@ -296,10 +316,96 @@ void AnnotationParseTest() {
   }
 }
 
+// Values wider than the inline buffer are the same when moved to the heap.
+void InlineBufferFallbackTest() {
+  std::cout << "\n-- Inline buffer fallback test -- \n";
+  const std::string input =
+    "WIDE[255:0] = 256'h0123456789ABCDEF_FEDCBA9876543210"
+    "_DEADBEEFDEADBEEF_AABBCCDDEEFF0011\n";
+  const uint64_t expected[] = {0xAABBCCDDEEFF0011UL, 0xDEADBEEFDEADBEEFUL,
+                               0xFEDCBA9876543210UL, 0x0123456789ABCDEFUL};
+  size_t i = 0;
+  auto result = fasm::Parse<64>(
+    input, stderr,
+    [&](uint32_t, std::string_view, int min_bit, int width, uint64_t bits) {
+      EXPECT_EQ(min_bit, int(64 * i));
+      EXPECT_EQ(width, 64);
+      EXPECT_EQ(bits, expected[i]);
+      ++i;
+      return true;
+    });
+  EXPECT_EQ(result, ParseResult::kSuccess);
+  EXPECT_EQ(i, 4u);
+}
+
+// Random long values and names must parse the same with all scan kernels.
+void ScanKernelConsistencyTest() {
+  std::cout << "\n-- Scan kernel consistency test -- \n";
+  std::mt19937 rnd(42);
+  std::string input;
+  for (int digits = 1; digits < 300; ++digits) {
+    const bool hex = (digits % 2) == 0;
+    std::string value;
+    for (int i = 0; i < digits; ++i) {
+      if (rnd() % 13 == 0) value += '_';
+      value += (hex ? "0123456789abcdefABCDEF" : "01")[rnd() % (hex ? 22 : 2)];
+    }
+    const int width = std::max(1, (hex ? 4 : 1) * digits);
+    input += std::string(rnd() % 70 + 1, 'N') + "_" + std::to_string(digits) +
+             "[" + std::to_string(width - 1) + ":0] = " + (hex ? "'h" : "'b") +
+             value + "   # " + std::string(rnd() % 70, 'c') + "\n";
+  }
+
+  using Feature = std::pair<std::string, uint64_t>;
+  auto parse_all = [&](std::vector<Feature> *features) {
+    return fasm::Parse(input, stderr,
+                       [&](uint32_t, std::string_view n, int min_bit,
+                           int width, uint64_t bits) {
+                         features->emplace_back(
+                           std::string(n) + "@" + std::to_string(min_bit) +
+                             ":" + std::to_string(width),
+                           bits);
+                         return true;
+                       });
+  };
+
+  const fasm::internal::ScanKernels *const active =
+    fasm::internal::ActiveScanKernels();
+  fasm::internal::ActiveScanKernels() =
+    &fasm::internal::GetScanKernels(fasm::internal::ScanLevel::kScalar);
+  std::vector<Feature> expected;
+  EXPECT_EQ(parse_all(&expected), ParseResult::kSuccess);
+  for (const auto level :
+       {fasm::internal::ScanLevel::kSSE42, fasm::internal::ScanLevel::kAVX2}) {
+    if (!fasm::internal::IsScanLevelSupported(level)) continue;
+    fasm::internal::ActiveScanKernels() =
+      &fasm::internal::GetScanKernels(level);
+    std::vector<Feature> features;
+    EXPECT_EQ(parse_all(&features), ParseResult::kSuccess);
+    EXPECT_EQ(features.size(), expected.size());
+    for (size_t i = 0; i < std::min(features.size(), expected.size()); ++i) {
+      EXPECT_EQ(features[i].first, expected[i].first);
+      EXPECT_EQ(features[i].second, expected[i].second) << features[i].first;
+    }
+  }
+  fasm::internal::ActiveScanKernels() = active;
+}
+
 int main() {
-  ValueParseTest();
-  AnnotationParseTest();
-  LongValueParseTest();
+  using fasm::internal::ScanLevel;
+  for (const ScanLevel level :
+       {ScanLevel::kScalar, ScanLevel::kSSE42, ScanLevel::kAVX2}) {
+    if (!fasm::internal::IsScanLevelSupported(level)) continue;
+    std::cout << "\n== Scan kernel level " << static_cast<int>(level)
+              << " ==\n";
+    fasm::internal::ActiveScanKernels() =
+      &fasm::internal::GetScanKernels(level);
+    ValueParseTest();
+    AnnotationParseTest();
+    LongValueParseTest();
+  }
+  InlineBufferFallbackTest();
+  ScanKernelConsistencyTest();
 
   if (expect_mismatch_count == 0) {
     printf("\nPASS, all expectations met.\n");
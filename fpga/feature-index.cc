@@ -0,0 +1,290 @@
+#include "fpga/feature-index.h"
+
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/span.h"
+#include "fpga/database-snapshot.h"
+#include "fpga/memory-mapped-file.h"
+
+namespace fpga {
+namespace {
+// File layout, in native byte order and with all tables 4 byte aligned:
+//   magic, u32 byte order mark, u32 fingerprint size, fingerprint padded to
+//   4 bytes, u32 sources size, sources as encoded in snapshots padded to 4
+//   bytes, u32 slot count, u32 entry count, u32 name count, u32 bit count,
+//   u32 string pool size, then the slots, names, bits and the string pool.
+constexpr std::string_view kMagic = "FASMIDX2";
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+template <typename T>
+void Append(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void WriteTable(std::ostream &out, const std::vector<T> &values) {
+  out.write(reinterpret_cast<const char *>(values.data()),
+            values.size() * sizeof(T));
+}
+
+void PadTo4(std::string &out) { out.resize((out.size() + 3) & ~size_t(3)); }
+
+// Hands out the tables of a mapped index; any read past the end makes ok()
+// false.
+class TableReader {
+ public:
+  explicit TableReader(std::string_view data) : data_(data) {}
+
+  bool ok() const { return ok_; }
+
+  uint32_t U32() {
+    uint32_t value = 0;
+    if (Consume(sizeof(value))) {
+      std::memcpy(&value, data_.data(), sizeof(value));
+      data_.remove_prefix(sizeof(value));
+    }
+    return value;
+  }
+
+  std::string_view Bytes(size_t size) {
+    if (!Consume(size)) {
+      return {};
+    }
+    const std::string_view value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return value;
+  }
+
+  void SkipPadding() {
+    const size_t padding =
+      -reinterpret_cast<uintptr_t>(data_.data()) % sizeof(uint32_t);
+    Bytes(padding);
+  }
+
+  template <typename T>
+  absl::Span<const T> Table(size_t count) {
+    if (count > data_.size() / sizeof(T)) {
+      ok_ = false;
+      return {};
+    }
+    const std::string_view bytes = Bytes(count * sizeof(T));
+    return {reinterpret_cast<const T *>(bytes.data()), count};
+  }
+
+ private:
+  bool Consume(size_t size) {
+    ok_ = ok_ && data_.size() >= size;
+    return ok_;
+  }
+
+  std::string_view data_;
+  bool ok_ = true;
+};
+}  // namespace
+
+uint64_t FeatureIndex::Hash(std::string_view tile_name,
+                            std::string_view feature, uint32_t address) {
+  // FNV-1a; it has to be stable across processes, as it is stored.
+  uint64_t hash = 0xcbf29ce484222325;
+  const auto add = [&hash](uint8_t byte) {
+    hash = (hash ^ byte) * 0x100000001b3;
+  };
+  for (const char c : tile_name) add(c);
+  add('.');
+  for (const char c : feature) add(c);
+  for (int i = 0; i < 4; ++i) add(address >> (8 * i));
+  return hash;
+}
+
+absl::StatusOr<FeatureIndex> FeatureIndex::Open(std::string_view path,
+                                                std::string_view fingerprint) {
+  absl::StatusOr<std::unique_ptr<MemoryBlock>> content = MemoryMapFile(path);
+  if (!content.ok()) {
+    return content.status();
+  }
+  TableReader reader(content.value()->AsStringView());
+  if (reader.Bytes(kMagic.size()) != kMagic ||
+      reader.U32() != kByteOrderMark) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("\"%s\" is not a feature index of this machine", path));
+  }
+  const uint32_t fingerprint_size = reader.U32();
+  if (reader.Bytes(fingerprint_size) != fingerprint) {
+    return absl::FailedPreconditionError(absl::StrFormat(
+      "\"%s\" was compiled for another database or part", path));
+  }
+  reader.SkipPadding();
+  SnapshotReader sources_reader(reader.Bytes(reader.U32()));
+  std::vector<SnapshotSource> sources;
+  if (!ReadSnapshotSources(sources_reader, sources) || !reader.ok()) {
+    return absl::DataLossError(
+      absl::StrFormat("feature index \"%s\" is truncated", path));
+  }
+  if (absl::Status status = CheckSnapshotSources(path, sources);
+      !status.ok()) {
+    return status;
+  }
+  reader.SkipPadding();
+  FeatureIndex index;
+  const uint32_t slot_count = reader.U32();
+  index.entry_count_ = reader.U32();
+  const uint32_t name_count = reader.U32();
+  const uint32_t bit_count = reader.U32();
+  const uint32_t strings_size = reader.U32();
+  index.slots_ = reader.Table<Slot>(slot_count);
+  index.names_ = reader.Table<Name>(name_count);
+  index.bits_ = reader.Table<IndexedBit>(bit_count);
+  index.strings_ = reader.Bytes(strings_size);
+  if (!reader.ok() || !std::has_single_bit(slot_count)) {
+    return absl::DataLossError(
+      absl::StrFormat("feature index \"%s\" is truncated", path));
+  }
+  // Names are few, so they are validated upfront. Slots are only validated
+  // when used by Find(), so that opening does not read the whole file.
+  for (const Name &name : index.names_) {
+    if (name.offset > strings_size || name.size > strings_size - name.offset) {
+      return absl::DataLossError(
+        absl::StrFormat("feature index \"%s\" is corrupt", path));
+    }
+  }
+  index.content_ = std::move(content.value());
+  return index;
+}
+
+bool FeatureIndex::Find(std::string_view tile_name, std::string_view feature,
+                        uint32_t address,
+                        absl::Span<const IndexedBit> &bits) const {
+  const size_t mask = slots_.size() - 1;
+  const size_t start = Hash(tile_name, feature, address);
+  for (size_t probe = 0; probe < slots_.size(); ++probe) {
+    const Slot &slot = slots_[(start + probe) & mask];
+    if (slot.tile == kEmptySlot) {
+      return false;
+    }
+    if (slot.tile >= names_.size() || slot.feature >= names_.size() ||
+        slot.bits_begin > bits_.size() ||
+        slot.bits_count > bits_.size() - slot.bits_begin) {
+      return false;  // Corrupt slot.
+    }
+    if (slot.address == address && NameAt(slot.feature) == feature &&
+        NameAt(slot.tile) == tile_name) {
+      bits = bits_.subspan(slot.bits_begin, slot.bits_count);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t FeatureIndexBuilder::Intern(std::string_view name) {
+  const auto [it, inserted] =
+    name_ids_.try_emplace(std::string(name), names_.size());
+  if (inserted) {
+    names_.emplace_back(name);
+  }
+  return it->second;
+}
+
+void FeatureIndexBuilder::Add(std::string_view tile_name,
+                              std::string_view feature, uint32_t address,
+                              const std::vector<IndexedBit> &bits) {
+  entries_.push_back({
+    .tile = Intern(tile_name),
+    .feature = Intern(feature),
+    .address = address,
+    .bits_begin = static_cast<uint32_t>(bits_.size()),
+    .bits_count = static_cast<uint32_t>(bits.size()),
+  });
+  bits_.insert(bits_.end(), bits.begin(), bits.end());
+}
+
+absl::Status FeatureIndexBuilder::Write(
+  std::string_view path, std::string_view fingerprint,
+  const std::vector<SnapshotSource> &sources) const {
+  // At most half full, so that probe sequences stay short.
+  const size_t slot_count = std::bit_ceil(2 * entries_.size() + 1);
+  if (slot_count > FeatureIndex::kEmptySlot ||
+      bits_.size() > FeatureIndex::kEmptySlot) {
+    return absl::ResourceExhaustedError("too many features for an index");
+  }
+  const FeatureIndex::Slot empty_slot = {.tile = FeatureIndex::kEmptySlot,
+                                         .feature = 0,
+                                         .address = 0,
+                                         .bits_begin = 0,
+                                         .bits_count = 0};
+  std::vector<FeatureIndex::Slot> slots(slot_count, empty_slot);
+  const size_t mask = slot_count - 1;
+  for (const FeatureIndex::Slot &entry : entries_) {
+    size_t i = FeatureIndex::Hash(names_[entry.tile], names_[entry.feature],
+                                  entry.address) &
+               mask;
+    while (slots[i].tile != FeatureIndex::kEmptySlot) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = entry;
+  }
+  std::vector<FeatureIndex::Name> names;
+  names.reserve(names_.size());
+  std::string strings;
+  for (const std::string &name : names_) {
+    names.push_back({static_cast<uint32_t>(strings.size()),
+                     static_cast<uint32_t>(name.size())});
+    strings.append(name);
+  }
+
+  std::string header(kMagic);
+  Append(header, kByteOrderMark);
+  Append(header, static_cast<uint32_t>(fingerprint.size()));
+  header.append(fingerprint);
+  PadTo4(header);
+  SnapshotWriter encoded_sources;
+  WriteSnapshotSources(sources, encoded_sources);
+  Append(header, static_cast<uint32_t>(encoded_sources.data().size()));
+  header.append(encoded_sources.data());
+  PadTo4(header);
+  Append(header, static_cast<uint32_t>(slot_count));
+  Append(header, static_cast<uint32_t>(entries_.size()));
+  Append(header, static_cast<uint32_t>(names.size()));
+  Append(header, static_cast<uint32_t>(bits_.size()));
+  Append(header, static_cast<uint32_t>(strings.size()));
+
+  // Write next to the destination and move in place, so that a concurrent
+  // Open() never maps a partially written index.
+  const std::string tmp_path = absl::StrFormat("%s.tmp", path);
+  std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot open \"%s\" for writing", tmp_path));
+  }
+  file.write(header.data(), header.size());
+  WriteTable(file, slots);
+  WriteTable(file, names);
+  WriteTable(file, bits_);
+  file.write(strings.data(), strings.size());
+  file.close();
+  if (file.fail()) {
+    return absl::InternalError(
+      absl::StrFormat("failed writing \"%s\"", tmp_path));
+  }
+  if (std::rename(tmp_path.c_str(), std::string(path).c_str()) != 0) {
+    return absl::ErrnoToStatus(
+      errno, absl::StrFormat("cannot rename \"%s\"", tmp_path));
+  }
+  return absl::OkStatus();
+}
+}  // namespace fpga
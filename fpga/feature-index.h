@@ -0,0 +1,131 @@
+#ifndef FPGA_FEATURE_INDEX_H
+#define FPGA_FEATURE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+#include "fpga/database-snapshot.h"
+#include "fpga/memory-mapped-file.h"
+
+namespace fpga {
+// Frame bit set by a feature address, as stored in the index.
+class IndexedBit {
+ public:
+  IndexedBit(ConfigBusType bus, uint32_t frame_address, uint32_t word,
+             uint32_t index, bool value)
+      : frame_address_(frame_address),
+        packed_((word * 32 + index) | (uint32_t(bus) << kBusShift) |
+                (value ? kValueFlag : 0)) {}
+
+  ConfigBusType bus() const {
+    return ConfigBusType((packed_ >> kBusShift) & 0x7f);
+  }
+  uint32_t frame_address() const { return frame_address_; }
+  uint32_t word() const { return (packed_ & kPositionMask) / 32; }
+  uint32_t index() const { return (packed_ & kPositionMask) % 32; }
+  bool value() const { return packed_ & kValueFlag; }
+
+ private:
+  static constexpr int kBusShift = 24;
+  static constexpr uint32_t kPositionMask = (uint32_t(1) << kBusShift) - 1;
+  static constexpr uint32_t kValueFlag = uint32_t(1) << 31;
+
+  uint32_t frame_address_;
+  uint32_t packed_;
+};
+static_assert(sizeof(IndexedBit) == 8, "IndexedBit is stored as is");
+
+class FeatureIndexBuilder;
+
+// Read-only, memory mapped table from "tile.feature[address]" to the absolute
+// frame bits it sets, compiled for one part. Looking up a feature is a single
+// hash table probe sequence, without going through the tile grid, aliases
+// and segbits.
+//
+// The file is a native endian image of the tables, so it is only meant to be
+// used on the machine that compiled it.
+class FeatureIndex {
+ public:
+  // Map the index at "path". Fails with FailedPrecondition if it was compiled
+  // for another "fingerprint", e.g. another database or part, or if any of
+  // the sources it was compiled from changed since.
+  static absl::StatusOr<FeatureIndex> Open(std::string_view path,
+                                           std::string_view fingerprint);
+
+  // Returns true and sets "bits" to the bits of
+  // "tile_name"."feature"["address"] if the index knows it.
+  bool Find(std::string_view tile_name, std::string_view feature,
+            uint32_t address, absl::Span<const IndexedBit> &bits) const;
+
+  size_t size() const { return entry_count_; }
+
+ private:
+  // A slot of the open addressing hash table; "tile" is kEmptySlot for
+  // unused slots. "tile" and "feature" are ids of interned names.
+  struct Slot {
+    uint32_t tile;
+    uint32_t feature;
+    uint32_t address;
+    uint32_t bits_begin;
+    uint32_t bits_count;
+  };
+  // Offset and size of an interned name in the string pool.
+  struct Name {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  friend class FeatureIndexBuilder;
+  static constexpr uint32_t kEmptySlot = ~uint32_t(0);
+  static uint64_t Hash(std::string_view tile_name, std::string_view feature,
+                       uint32_t address);
+
+  FeatureIndex() = default;
+
+  std::string_view NameAt(uint32_t id) const {
+    return strings_.substr(names_[id].offset, names_[id].size);
+  }
+
+  std::unique_ptr<MemoryBlock> content_;
+  size_t entry_count_ = 0;
+  absl::Span<const Slot> slots_;
+  absl::Span<const Name> names_;
+  absl::Span<const IndexedBit> bits_;
+  std::string_view strings_;
+};
+
+// Collects the frame bits of every feature address of a part, to be written
+// as a FeatureIndex.
+class FeatureIndexBuilder {
+ public:
+  // Add the bits of "tile_name"."feature"["address"]. Tile names and
+  // features are stored once, however many addresses refer to them.
+  void Add(std::string_view tile_name, std::string_view feature,
+           uint32_t address, const std::vector<IndexedBit> &bits);
+
+  size_t size() const { return entries_.size(); }
+
+  // Write the index for "fingerprint", compiled from "sources", to "path".
+  absl::Status Write(std::string_view path, std::string_view fingerprint,
+                     const std::vector<SnapshotSource> &sources) const;
+
+ private:
+  uint32_t Intern(std::string_view name);
+
+  absl::flat_hash_map<std::string, uint32_t> name_ids_;
+  std::vector<std::string> names_;
+  std::vector<FeatureIndex::Slot> entries_;
+  std::vector<IndexedBit> bits_;
+};
+}  // namespace fpga
+#endif  // FPGA_FEATURE_INDEX_H
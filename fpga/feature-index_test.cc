@@ -0,0 +1,116 @@
+#include "fpga/feature-index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+#include "fpga/database-snapshot.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+std::string TestPath(const char *name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+TEST(IndexedBit, PacksAllFields) {
+  const IndexedBit bit(ConfigBusType::kBlockRam, 0x00c20f80, 100, 31, true);
+  EXPECT_EQ(bit.bus(), ConfigBusType::kBlockRam);
+  EXPECT_EQ(bit.frame_address(), 0x00c20f80);
+  EXPECT_EQ(bit.word(), 100);
+  EXPECT_EQ(bit.index(), 31);
+  EXPECT_TRUE(bit.value());
+  EXPECT_FALSE(IndexedBit(ConfigBusType::kCLBIOCLK, 0, 0, 0, false).value());
+}
+
+TEST(FeatureIndex, WriteAndFindRoundTrip) {
+  const std::string path = TestPath("roundtrip.index");
+  FeatureIndexBuilder builder;
+  // Enough entries for the probe sequences to collide.
+  for (uint32_t address = 0; address < 64; ++address) {
+    builder.Add("CLBLL_L_X2Y10", "SLICEL_X0.ALUT.INIT", address,
+                {IndexedBit(ConfigBusType::kCLBIOCLK, 0x100 + address % 4,
+                            address % 101, 3, true)});
+  }
+  builder.Add("CLBLL_L_X2Y11", "SLICEL_X0.ALUT.INIT", 0,
+              {IndexedBit(ConfigBusType::kCLBIOCLK, 0x200, 1, 2, true),
+               IndexedBit(ConfigBusType::kCLBIOCLK, 0x201, 3, 4, false)});
+  ASSERT_TRUE(builder.Write(path, "db:part", {}).ok());
+
+  const absl::StatusOr<FeatureIndex> index =
+    FeatureIndex::Open(path, "db:part");
+  ASSERT_TRUE(index.ok()) << index.status();
+  EXPECT_EQ(index->size(), 65);
+  absl::Span<const IndexedBit> bits;
+  for (uint32_t address = 0; address < 64; ++address) {
+    ASSERT_TRUE(
+      index->Find("CLBLL_L_X2Y10", "SLICEL_X0.ALUT.INIT", address, bits));
+    ASSERT_EQ(bits.size(), 1);
+    EXPECT_EQ(bits[0].frame_address(), 0x100 + address % 4);
+    EXPECT_EQ(bits[0].word(), address % 101);
+  }
+  ASSERT_TRUE(index->Find("CLBLL_L_X2Y11", "SLICEL_X0.ALUT.INIT", 0, bits));
+  ASSERT_EQ(bits.size(), 2);
+  EXPECT_EQ(bits[1].frame_address(), 0x201);
+  EXPECT_FALSE(bits[1].value());
+
+  EXPECT_FALSE(index->Find("CLBLL_L_X2Y11", "SLICEL_X0.ALUT.INIT", 1, bits));
+  EXPECT_FALSE(index->Find("CLBLL_L_X2Y11", "SLICEL_X0.BLUT.INIT", 0, bits));
+  EXPECT_FALSE(index->Find("CLBLL_L_X2Y12", "SLICEL_X0.ALUT.INIT", 0, bits));
+}
+
+TEST(FeatureIndex, EmptyIndex) {
+  const std::string path = TestPath("empty.index");
+  ASSERT_TRUE(FeatureIndexBuilder().Write(path, "db:part", {}).ok());
+  const absl::StatusOr<FeatureIndex> index =
+    FeatureIndex::Open(path, "db:part");
+  ASSERT_TRUE(index.ok()) << index.status();
+  absl::Span<const IndexedBit> bits;
+  EXPECT_FALSE(index->Find("TILE", "FEATURE", 0, bits));
+}
+
+TEST(FeatureIndex, RejectsOtherFingerprint) {
+  const std::string path = TestPath("fingerprint.index");
+  ASSERT_TRUE(FeatureIndexBuilder().Write(path, "db:part", {}).ok());
+  EXPECT_EQ(FeatureIndex::Open(path, "db:other-part").status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(FeatureIndex, RejectsChangedSegbits) {
+  const std::string segbits_path = TestPath("segbits_clbll_l.db");
+  std::ofstream(segbits_path) << "CLBLL_L.SLICEL_X0.ALUT.INIT[00] 32_15\n";
+  const absl::StatusOr<std::vector<SnapshotSource>> sources =
+    StatSnapshotSources({segbits_path});
+  ASSERT_TRUE(sources.ok()) << sources.status();
+  const std::string path = TestPath("sources.index");
+  ASSERT_TRUE(
+    FeatureIndexBuilder().Write(path, "db:part", sources.value()).ok());
+  ASSERT_TRUE(FeatureIndex::Open(path, "db:part").ok());
+
+  std::ofstream(segbits_path, std::ios::app)
+    << "CLBLL_L.SLICEL_X0.ALUT.INIT[01] 32_14\n";
+  EXPECT_EQ(FeatureIndex::Open(path, "db:part").status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(FeatureIndex, RejectsTruncatedFile) {
+  const std::string path = TestPath("truncated.index");
+  FeatureIndexBuilder builder;
+  builder.Add("TILE", "FEATURE", 0,
+              {IndexedBit(ConfigBusType::kCLBIOCLK, 0x100, 1, 2, true)});
+  ASSERT_TRUE(builder.Write(path, "db:part", {}).ok());
+  const size_t size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - 1);
+  EXPECT_FALSE(FeatureIndex::Open(path, "db:part").ok());
+}
+}  // namespace
+}  // namespace fpga
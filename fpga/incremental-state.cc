@@ -0,0 +1,230 @@
+#include "fpga/incremental-state.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "fpga/database-snapshot.h"
+#include "fpga/memory-mapped-file.h"
+
+namespace fpga {
+namespace {
+// File layout, all integers little endian and strings prefixed with their
+// u32 size:
+//   magic, fingerprint, u32 source count, sources as (path, u64 mtime,
+//   u64 size), u64 entry count, then entries of key, u32 touched frame
+//   count, touched frames as u32, u32 bit count, bits as pairs of u32 (frame
+//   address, offset), then u64 frame count and frames of u32 address, u32
+//   word count and words as u32.
+constexpr std::string_view kMagic = "FASMINC2";
+
+void SetBit(std::vector<uint32_t> &words, uint32_t offset) {
+  const uint32_t word = offset / 32;
+  if (words.size() <= word) {
+    words.resize(word + 1);
+  }
+  words[word] |= uint32_t{1} << (offset % 32);
+}
+}  // namespace
+
+std::string FeatureKey(std::string_view name, int start_bit, int width,
+                       uint64_t bits) {
+  return absl::StrFormat("%s[%d+:%d]=%x", name, start_bit, width, bits);
+}
+
+void IncrementalState::SetBits(const FeatureContribution &contribution) {
+  for (const uint32_t frame_address : contribution.touched_frames) {
+    frames_.try_emplace(frame_address);
+  }
+  for (const FeatureContribution::Bit &bit : contribution.bits) {
+    SetBit(frames_[bit.frame_address], bit.offset);
+  }
+}
+
+void IncrementalState::Add(std::string key, FeatureContribution contribution) {
+  const auto [it, inserted] =
+    contributions_.try_emplace(std::move(key), std::move(contribution));
+  if (inserted) {
+    SetBits(it->second);
+  }
+}
+
+size_t IncrementalState::Retain(const absl::flat_hash_set<std::string> &keys) {
+  absl::flat_hash_set<uint32_t> stale_frames;
+  size_t removed = 0;
+  for (auto it = contributions_.begin(); it != contributions_.end();) {
+    if (keys.contains(it->first)) {
+      ++it;
+      continue;
+    }
+    stale_frames.insert(it->second.touched_frames.begin(),
+                        it->second.touched_frames.end());
+    contributions_.erase(it++);
+    ++removed;
+  }
+  if (stale_frames.empty()) {
+    return removed;
+  }
+  for (const uint32_t frame_address : stale_frames) {
+    frames_.erase(frame_address);
+  }
+  // Bits cannot be cleared from a frame, as other features may set them too,
+  // so the frames are set again from the features touching them.
+  for (const auto &[key, contribution] : contributions_) {
+    for (const uint32_t frame_address : contribution.touched_frames) {
+      if (stale_frames.contains(frame_address)) {
+        frames_.try_emplace(frame_address);
+      }
+    }
+    for (const FeatureContribution::Bit &bit : contribution.bits) {
+      if (stale_frames.contains(bit.frame_address)) {
+        SetBit(frames_[bit.frame_address], bit.offset);
+      }
+    }
+  }
+  return removed;
+}
+
+absl::StatusOr<IncrementalState> IncrementalState::Load(
+  std::string_view path, std::string_view fingerprint) {
+  const absl::StatusOr<std::unique_ptr<MemoryBlock>> content =
+    MemoryMapFile(path);
+  if (!content.ok()) {
+    return content.status();
+  }
+  const absl::Status truncated = absl::DataLossError(
+    absl::StrFormat("incremental state file \"%s\" is truncated", path));
+  SnapshotReader reader(content.value()->AsStringView());
+  if (reader.Bytes(kMagic.size()) != kMagic) {
+    return absl::InvalidArgumentError(
+      absl::StrFormat("\"%s\" is not an incremental state file", path));
+  }
+  if (reader.String() != fingerprint) {
+    return absl::FailedPreconditionError(absl::StrFormat(
+      "\"%s\" was created for another database or part", path));
+  }
+  const uint32_t source_count = reader.U32();
+  std::vector<SnapshotSource> sources;
+  for (uint32_t i = 0; i < source_count && reader.ok(); ++i) {
+    SnapshotSource &source = sources.emplace_back();
+    source.path = reader.String();
+    source.mtime_ns = static_cast<int64_t>(reader.U64());
+    source.size = reader.U64();
+  }
+  if (!reader.ok()) {
+    return truncated;
+  }
+  if (absl::Status status = CheckSnapshotSources(path, sources);
+      !status.ok()) {
+    return status;
+  }
+  IncrementalState state{std::string(fingerprint), std::move(sources)};
+  const uint64_t count = reader.U64();
+  for (uint64_t i = 0; i < count && reader.ok(); ++i) {
+    const std::string_view key = reader.String();
+    FeatureContribution contribution;
+    const uint32_t touched_count = reader.U32();
+    if (!reader.Fits(touched_count, 4)) {
+      break;
+    }
+    contribution.touched_frames.reserve(touched_count);
+    for (uint32_t t = 0; t < touched_count; ++t) {
+      contribution.touched_frames.push_back(reader.U32());
+    }
+    const uint32_t bit_count = reader.U32();
+    if (!reader.Fits(bit_count, 8)) {
+      break;
+    }
+    contribution.bits.reserve(bit_count);
+    for (uint32_t b = 0; b < bit_count; ++b) {
+      const uint32_t frame_address = reader.U32();
+      contribution.bits.push_back({frame_address, reader.U32()});
+    }
+    state.contributions_.emplace(key, std::move(contribution));
+  }
+  if (!reader.ok() || state.size() != count) {
+    return truncated;
+  }
+  const uint64_t frame_count = reader.U64();
+  for (uint64_t i = 0; i < frame_count && reader.ok(); ++i) {
+    std::vector<uint32_t> &words = state.frames_[reader.U32()];
+    const uint32_t word_count = reader.U32();
+    if (!reader.Fits(word_count, 4)) {
+      break;
+    }
+    words.reserve(word_count);
+    for (uint32_t w = 0; w < word_count; ++w) {
+      words.push_back(reader.U32());
+    }
+  }
+  if (!reader.ok() || state.frames_.size() != frame_count) {
+    return truncated;
+  }
+  return state;
+}
+
+absl::Status IncrementalState::Save(std::string_view path) const {
+  SnapshotWriter out;
+  out.Bytes(kMagic);
+  out.String(fingerprint_);
+  out.U32(sources_.size());
+  for (const SnapshotSource &source : sources_) {
+    out.String(source.path);
+    out.U64(static_cast<uint64_t>(source.mtime_ns));
+    out.U64(source.size);
+  }
+  out.U64(contributions_.size());
+  for (const auto &[key, contribution] : contributions_) {
+    out.String(key);
+    out.U32(contribution.touched_frames.size());
+    for (const uint32_t frame_address : contribution.touched_frames) {
+      out.U32(frame_address);
+    }
+    out.U32(contribution.bits.size());
+    for (const FeatureContribution::Bit &bit : contribution.bits) {
+      out.U32(bit.frame_address);
+      out.U32(bit.offset);
+    }
+  }
+  out.U64(frames_.size());
+  for (const auto &[frame_address, words] : frames_) {
+    out.U32(frame_address);
+    out.U32(words.size());
+    for (const uint32_t word : words) {
+      out.U32(word);
+    }
+  }
+
+  // Write next to the destination and move in place, so an interrupted run
+  // does not leave a truncated state behind.
+  const std::string tmp_path = absl::StrFormat("%s.tmp", path);
+  std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+      absl::StrFormat("cannot open \"%s\" for writing", tmp_path));
+  }
+  file.write(out.data().data(), out.data().size());
+  file.close();
+  if (file.fail()) {
+    return absl::InternalError(
+      absl::StrFormat("failed writing \"%s\"", tmp_path));
+  }
+  if (std::rename(tmp_path.c_str(), std::string(path).c_str()) != 0) {
+    return absl::ErrnoToStatus(
+      errno, absl::StrFormat("cannot rename \"%s\"", tmp_path));
+  }
+  return absl::OkStatus();
+}
+}  // namespace fpga
@@ -0,0 +1,109 @@
+#ifndef FPGA_INCREMENTAL_STATE_H
+#define FPGA_INCREMENTAL_STATE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-snapshot.h"
+
+namespace fpga {
+// Frame bits resolved from a single fasm feature assignment. As resolving a
+// feature only ever sets bits, the frames of a design are the OR of the
+// contributions of all its features.
+struct FeatureContribution {
+  // Frames marked as used by the feature, sorted and unique.
+  std::vector<uint32_t> touched_frames;
+
+  struct Bit {
+    uint32_t frame_address;
+    // Bit position within the frame: word * 32 + bit index.
+    uint32_t offset;
+  };
+  std::vector<Bit> bits;
+
+  void Touch(uint32_t frame_address) {
+    touched_frames.push_back(frame_address);
+  }
+  void SetBit(uint32_t frame_address, uint32_t word, uint32_t index) {
+    touched_frames.push_back(frame_address);
+    bits.push_back({frame_address, word * 32 + index});
+  }
+
+  // Sort and deduplicate touched_frames; call once done recording.
+  void Finalize() {
+    std::sort(touched_frames.begin(), touched_frames.end());
+    touched_frames.erase(
+      std::unique(touched_frames.begin(), touched_frames.end()),
+      touched_frames.end());
+  }
+};
+
+// Identifies a feature assignment, e.g. one line of fasm, by all of its
+// values.
+std::string FeatureKey(std::string_view name, int start_bit, int width,
+                       uint64_t bits);
+
+// Contributions of the features of a previous run and the frames they
+// assemble to, persisted between runs so that only features not seen before
+// need to be resolved again and only the frames they touch updated.
+class IncrementalState {
+ public:
+  // "fingerprint" identifies the database and part the contributions were
+  // resolved with and "sources" the files they were resolved from; a state
+  // is only reused for the same fingerprint and unchanged sources.
+  IncrementalState(std::string fingerprint, std::vector<SnapshotSource> sources)
+      : fingerprint_(std::move(fingerprint)), sources_(std::move(sources)) {}
+
+  // Load a state saved with Save(). Fails with FailedPrecondition if it was
+  // saved with another fingerprint or if any of its sources changed since.
+  static absl::StatusOr<IncrementalState> Load(std::string_view path,
+                                               std::string_view fingerprint);
+
+  absl::Status Save(std::string_view path) const;
+
+  const std::string &fingerprint() const { return fingerprint_; }
+  const std::vector<SnapshotSource> &sources() const { return sources_; }
+  size_t size() const { return contributions_.size(); }
+
+  // Returns the contribution of the feature "key" or nullptr if unknown.
+  const FeatureContribution *Find(std::string_view key) const {
+    const auto found = contributions_.find(key);
+    return found == contributions_.end() ? nullptr : &found->second;
+  }
+
+  // Add the contribution of the feature "key" and set its bits in frames().
+  // Does nothing if "key" is known, as the contribution of a feature only
+  // depends on the database.
+  void Add(std::string key, FeatureContribution contribution);
+
+  // Remove the contributions of all features but "keys" and rebuild the
+  // frames they touched from the remaining contributions. Returns the
+  // number of contributions removed.
+  size_t Retain(const absl::flat_hash_set<std::string> &keys);
+
+  // Words of every frame touched by the contributions, OR-ed together, by
+  // frame address. Frames are only as long as their last word with a bit
+  // set; missing words are zero.
+  using Frames = absl::btree_map<uint32_t, std::vector<uint32_t>>;
+  const Frames &frames() const { return frames_; }
+
+ private:
+  void SetBits(const FeatureContribution &contribution);
+
+  std::string fingerprint_;
+  std::vector<SnapshotSource> sources_;
+  absl::flat_hash_map<std::string, FeatureContribution> contributions_;
+  Frames frames_;
+};
+}  // namespace fpga
+#endif  // FPGA_INCREMENTAL_STATE_H
@@ -0,0 +1,165 @@
+#include "fpga/incremental-state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "fpga/database-snapshot.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+std::string TestPath(const char *name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+FeatureContribution SampleContribution(uint32_t base) {
+  FeatureContribution contribution;
+  contribution.Touch(base + 2);
+  contribution.SetBit(base, 3, 7);
+  contribution.SetBit(base, 100, 31);
+  contribution.Touch(base);
+  contribution.Finalize();
+  return contribution;
+}
+
+TEST(FeatureContribution, FinalizeSortsTouchedFrames) {
+  const FeatureContribution contribution = SampleContribution(0x100);
+  EXPECT_EQ(contribution.touched_frames,
+            (std::vector<uint32_t>{0x100, 0x102}));
+  ASSERT_EQ(contribution.bits.size(), 2);
+  EXPECT_EQ(contribution.bits[0].frame_address, 0x100);
+  EXPECT_EQ(contribution.bits[0].offset, 3 * 32 + 7);
+  EXPECT_EQ(contribution.bits[1].offset, 100 * 32 + 31);
+}
+
+TEST(FeatureKey, DistinguishesAllValues) {
+  const std::string key = FeatureKey("TILE.FEATURE", 0, 1, 1);
+  EXPECT_NE(key, FeatureKey("TILE.FEATURE", 1, 1, 1));
+  EXPECT_NE(key, FeatureKey("TILE.FEATURE", 0, 2, 1));
+  EXPECT_NE(key, FeatureKey("TILE.FEATURE", 0, 1, 0));
+  EXPECT_NE(key, FeatureKey("TILE.OTHER", 0, 1, 1));
+  EXPECT_EQ(key, FeatureKey("TILE.FEATURE", 0, 1, 1));
+}
+
+TEST(IncrementalState, SaveAndLoadRoundTrip) {
+  const std::string path = TestPath("roundtrip.state");
+  IncrementalState state("db:part", {});
+  state.Add("A", SampleContribution(0x100));
+  state.Add("B", SampleContribution(0x200));
+  state.Add("EMPTY", FeatureContribution{});
+  ASSERT_TRUE(state.Save(path).ok());
+
+  absl::StatusOr<IncrementalState> loaded =
+    IncrementalState::Load(path, "db:part");
+  ASSERT_TRUE(loaded.ok()) << loaded.status();
+  EXPECT_EQ(loaded->size(), 3);
+  const FeatureContribution *b = loaded->Find("B");
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(b->touched_frames, (std::vector<uint32_t>{0x200, 0x202}));
+  ASSERT_EQ(b->bits.size(), 2);
+  EXPECT_EQ(b->bits[1].frame_address, 0x200);
+  EXPECT_EQ(b->bits[1].offset, 100 * 32 + 31);
+  ASSERT_NE(loaded->Find("EMPTY"), nullptr);
+  EXPECT_EQ(loaded->Find("C"), nullptr);
+  EXPECT_EQ(loaded->frames(), state.frames());
+}
+
+TEST(IncrementalState, FramesAreTheContributionsOrTogether) {
+  IncrementalState state("db:part", {});
+  state.Add("A", SampleContribution(0x100));
+  FeatureContribution other;
+  other.SetBit(0x100, 3, 8);
+  other.SetBit(0x100, 3, 7);
+  other.Finalize();
+  state.Add("B", other);
+
+  ASSERT_EQ(state.frames().size(), 2);
+  const std::vector<uint32_t> &words = state.frames().at(0x100);
+  ASSERT_EQ(words.size(), 101);
+  EXPECT_EQ(words[3], (uint32_t{1} << 7) | (uint32_t{1} << 8));
+  EXPECT_EQ(words[100], uint32_t{1} << 31);
+  // Touched without bits set.
+  EXPECT_TRUE(state.frames().at(0x102).empty());
+
+  // Known features are not added twice.
+  state.Add("B", SampleContribution(0x200));
+  EXPECT_EQ(state.size(), 2);
+  EXPECT_FALSE(state.frames().contains(0x200));
+}
+
+TEST(IncrementalState, RetainRebuildsFramesOfRemovedFeatures) {
+  IncrementalState state("db:part", {});
+  state.Add("A", SampleContribution(0x100));
+  state.Add("B", SampleContribution(0x200));
+  FeatureContribution shared;
+  shared.SetBit(0x100, 3, 7);
+  shared.Finalize();
+  state.Add("SHARED", shared);
+
+  EXPECT_EQ(state.Retain({"B", "SHARED", "UNKNOWN"}), 1);
+  EXPECT_EQ(state.Find("A"), nullptr);
+  EXPECT_EQ(state.size(), 2);
+  // The bit also set by "SHARED" stays, the others of "A" are gone.
+  const std::vector<uint32_t> &words = state.frames().at(0x100);
+  EXPECT_EQ(words[3], uint32_t{1} << 7);
+  EXPECT_EQ(words.size(), 4);
+  EXPECT_FALSE(state.frames().contains(0x102));
+  // Untouched by "A".
+  EXPECT_EQ(state.frames().at(0x200).size(), 101);
+
+  EXPECT_EQ(state.Retain({}), 2);
+  EXPECT_TRUE(state.frames().empty());
+}
+
+TEST(IncrementalState, RejectsOtherFingerprint) {
+  const std::string path = TestPath("fingerprint.state");
+  ASSERT_TRUE(IncrementalState("db:part", {}).Save(path).ok());
+  const absl::StatusOr<IncrementalState> loaded =
+    IncrementalState::Load(path, "db:other-part");
+  EXPECT_EQ(loaded.status().code(), absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(IncrementalState, RejectsChangedSources) {
+  const std::string source_path = TestPath("source.db");
+  std::ofstream(source_path) << "1_3\n";
+  const absl::StatusOr<SnapshotSource> source =
+    StatSnapshotSource(source_path);
+  ASSERT_TRUE(source.ok()) << source.status();
+  const std::string path = TestPath("sources.state");
+  ASSERT_TRUE(IncrementalState("db:part", {source.value()}).Save(path).ok());
+  ASSERT_TRUE(IncrementalState::Load(path, "db:part").ok());
+
+  std::ofstream(source_path, std::ios::app) << "0_33\n";
+  const absl::StatusOr<IncrementalState> loaded =
+    IncrementalState::Load(path, "db:part");
+  EXPECT_EQ(loaded.status().code(), absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(IncrementalState, RejectsTruncatedFile) {
+  const std::string path = TestPath("truncated.state");
+  IncrementalState state("db:part", {});
+  state.Add("A", SampleContribution(0x100));
+  ASSERT_TRUE(state.Save(path).ok());
+
+  std::string content;
+  {
+    std::ifstream in(path, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+  }
+  for (const size_t cut : {size_t(4), content.size() / 2, content.size() - 1}) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(content.data(), cut);
+    EXPECT_FALSE(IncrementalState::Load(path, "db:part").ok()) << cut;
+  }
+}
+}  // namespace
+}  // namespace fpga
@@ -0,0 +1,179 @@
+#include "fpga/lazy-tile-grid.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/call_once.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "fpga/database-parsers.h"
+#include "fpga/memory-mapped-file.h"
+#include "fpga/symbol-table.h"
+
+namespace fpga {
+LazyTileGrid::LazyTileGrid(TileGrid grid) {
+  names_.reserve(grid.size());
+  entries_ = std::make_unique<Entry[]>(grid.size());
+  std::vector<Location> coords;
+  coords.reserve(grid.size());
+  for (auto &[name, tile] : grid) {
+    tile_types_.insert(tile.type);
+    for (const auto &[bus, bits_block] : tile.bits) {
+      if (bits_block.alias.has_value()) {
+        tile_types_.insert(bits_block.alias->type);
+      }
+    }
+    coords.push_back(tile.coord);
+    entries_[names_.size()].tile = std::move(tile);
+    names_.push_back(name);
+  }
+  Index(coords);
+}
+
+absl::StatusOr<LazyTileGrid> LazyTileGrid::FromJSON(
+  std::shared_ptr<const MemoryBlock> file) {
+  const absl::StatusOr<TileGridJSONIndex> index =
+    IndexTileGridJSON(file->AsStringView());
+  if (!index.ok()) {
+    return index.status();
+  }
+  LazyTileGrid grid;
+  grid.names_.reserve(index->tiles.size());
+  grid.entries_ = std::make_unique<Entry[]>(index->tiles.size());
+  std::vector<Location> coords;
+  coords.reserve(index->tiles.size());
+  for (const TileGridJSONIndex::Entry &tile : index->tiles) {
+    grid.entries_[grid.names_.size()].encoded = tile.json;
+    grid.names_.emplace_back(tile.name);
+    coords.push_back(tile.coord);
+  }
+  for (const std::string_view type : index->types) {
+    grid.tile_types_.emplace(type);
+  }
+  grid.Index(coords);
+  grid.file_ = std::move(file);
+  grid.decode_ = ParseTileJSON;
+  return grid;
+}
+
+LazyTileGrid LazyTileGrid::FromEncoded(
+  std::shared_ptr<const MemoryBlock> file,
+  const std::vector<EncodedTile> &tiles,
+  absl::flat_hash_set<Symbol> tile_types, TileDecoder decode) {
+  LazyTileGrid grid;
+  grid.names_.reserve(tiles.size());
+  grid.entries_ = std::make_unique<Entry[]>(tiles.size());
+  std::vector<Location> coords;
+  coords.reserve(tiles.size());
+  for (const EncodedTile &tile : tiles) {
+    grid.entries_[grid.names_.size()].encoded = tile.encoded;
+    grid.names_.emplace_back(tile.name);
+    coords.push_back(tile.coord);
+  }
+  grid.tile_types_ = std::move(tile_types);
+  grid.Index(coords);
+  grid.file_ = std::move(file);
+  grid.decode_ = decode;
+  return grid;
+}
+
+void LazyTileGrid::Index(const std::vector<Location> &coords) {
+  ids_.reserve(names_.size());
+  coord_ids_.reserve(names_.size());
+  for (TileId id = 0; id < names_.size(); ++id) {
+    // Names are unique in tilegrid.json; should a name or a position be
+    // repeated anyway, the first tile wins.
+    ids_.try_emplace(names_[id], id);
+    coord_ids_.try_emplace(CoordKey(coords[id]), id);
+  }
+}
+
+std::optional<TileId> LazyTileGrid::FindId(std::string_view name) const {
+  const auto found = ids_.find(name);
+  if (found == ids_.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+std::optional<TileId> LazyTileGrid::FindId(Location coord) const {
+  const auto found = coord_ids_.find(CoordKey(coord));
+  if (found == coord_ids_.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+const Tile &LazyTileGrid::tile(TileId id) const {
+  Entry &entry = entries_[id];
+  absl::call_once(entry.decoded, [this, id, &entry] {
+    if (entry.encoded.empty()) {
+      return;
+    }
+    absl::StatusOr<Tile> tile = decode_(names_[id], entry.encoded);
+    if (!tile.ok()) {
+      entry.status = tile.status();
+      return;
+    }
+    entry.tile = std::move(tile.value());
+  });
+  return entry.tile;
+}
+
+absl::Status LazyTileGrid::status(TileId id) const {
+  tile(id);
+  return entries_[id].status;
+}
+
+const Tile *LazyTileGrid::find(std::string_view name) const {
+  const std::optional<TileId> id = FindId(name);
+  if (!id.has_value() || !status(*id).ok()) {
+    return nullptr;
+  }
+  return &tile(*id);
+}
+
+const Tile &LazyTileGrid::at(std::string_view name) const {
+  const Tile *const tile = find(name);
+  CHECK(tile != nullptr) << "unknown tile " << name;
+  return *tile;
+}
+
+absl::Status LazyTileGrid::ForEach(const TileFn &fn) const {
+  absl::Status status;
+  for (TileId id = 0; id < names_.size(); ++id) {
+    const Tile &decoded = tile(id);
+    if (!entries_[id].status.ok()) {
+      status.Update(entries_[id].status);
+      continue;
+    }
+    fn(names_[id], decoded);
+  }
+  return status;
+}
+
+absl::Status LazyTileGrid::ForEachMentioning(std::string_view text,
+                                             const TileFn &fn) const {
+  absl::Status status;
+  for (TileId id = 0; id < names_.size(); ++id) {
+    const std::string_view encoded = entries_[id].encoded;
+    if (!encoded.empty() && !absl::StrContains(encoded, text)) {
+      continue;
+    }
+    const Tile &decoded = tile(id);
+    if (!entries_[id].status.ok()) {
+      status.Update(entries_[id].status);
+      continue;
+    }
+    fn(names_[id], decoded);
+  }
+  return status;
+}
+}  // namespace fpga
@@ -0,0 +1,134 @@
+#ifndef FPGA_LAZY_TILE_GRID_H
+#define FPGA_LAZY_TILE_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/call_once.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-parsers.h"
+#include "fpga/memory-mapped-file.h"
+#include "fpga/symbol-table.h"
+
+namespace fpga {
+// Dense id of a tile of a LazyTileGrid, from 0 to size() - 1. Only valid for
+// the grid it was obtained from.
+using TileId = uint32_t;
+
+// The tiles of a part. When created from tilegrid.json or from a database
+// snapshot, only the position of each tile in the file is recorded up front
+// and a tile is decoded the first time it is accessed, so that the cost
+// scales with the tiles a design uses rather than with the size of the
+// device.
+// Tile names are interned into ids when the grid is created, so that once a
+// name is looked up, the tile can be accessed without hashing it again.
+// Safe to be accessed concurrently.
+class LazyTileGrid {
+ public:
+  LazyTileGrid() = default;
+
+  // A grid of tiles that are already decoded.
+  explicit LazyTileGrid(TileGrid grid);
+
+  // Index the tilegrid.json in "file", which is kept for decoding the tiles.
+  static absl::StatusOr<LazyTileGrid> FromJSON(
+    std::shared_ptr<const MemoryBlock> file);
+
+  // A tile as found in an encoded file, decoded on first access.
+  struct EncodedTile {
+    std::string_view name;
+    Location coord;
+    std::string_view encoded;
+  };
+  using TileDecoder = absl::StatusOr<Tile> (*)(std::string_view name,
+                                               std::string_view encoded);
+
+  // A grid of "tiles" encoded in "file", which is kept for decoding them
+  // with "decode". "tile_types" are the types of the tiles and the types
+  // they are aliased to.
+  static LazyTileGrid FromEncoded(std::shared_ptr<const MemoryBlock> file,
+                                  const std::vector<EncodedTile> &tiles,
+                                  absl::flat_hash_set<Symbol> tile_types,
+                                  TileDecoder decode);
+
+  size_t size() const { return names_.size(); }
+  bool contains(std::string_view name) const { return ids_.contains(name); }
+
+  // Id of the tile "name", if there is one.
+  std::optional<TileId> FindId(std::string_view name) const;
+
+  // Id of the tile at "coord" of the grid, if there is one. Known without
+  // decoding the tiles.
+  std::optional<TileId> FindId(Location coord) const;
+
+  const std::string &name(TileId id) const { return names_[id]; }
+
+  // The tile "id". A tile that cannot be decoded is returned empty, without
+  // type nor bits; status() tells why.
+  const Tile &tile(TileId id) const;
+
+  // Whether the tile "id" could be decoded, decoding it if needed.
+  absl::Status status(TileId id) const;
+
+  // The tile "name", or nullptr if there is none or it cannot be decoded.
+  const Tile *find(std::string_view name) const;
+
+  // Same as find(), but the tile must exist.
+  const Tile &at(std::string_view name) const;
+
+  using TileFn = std::function<void(const std::string &name, const Tile &)>;
+
+  // Call "fn" for every tile in id order, decoding all of them. Tiles that
+  // cannot be decoded are skipped; the first such error is returned.
+  absl::Status ForEach(const TileFn &fn) const;
+
+  // Call "fn" for the tiles with "text" anywhere in their encoding, which are
+  // the only ones decoded. Both JSON and snapshots store names as is. Tiles
+  // that were created decoded are all passed. Errors are handled as in
+  // ForEach().
+  absl::Status ForEachMentioning(std::string_view text,
+                                 const TileFn &fn) const;
+
+  // The types of the tiles and the types they are aliased to, known without
+  // decoding the tiles. May contain a few more.
+  const absl::flat_hash_set<Symbol> &tile_types() const {
+    return tile_types_;
+  }
+
+ private:
+  struct Entry {
+    // Encoding of the tile, empty if it was created decoded.
+    std::string_view encoded;
+    absl::once_flag decoded;
+    absl::Status status;
+    Tile tile;
+  };
+
+  static uint64_t CoordKey(Location coord) {
+    return (uint64_t{coord.x} << 32) | coord.y;
+  }
+
+  // Set up the lookups once all the names are known.
+  void Index(const std::vector<Location> &coords);
+
+  std::shared_ptr<const MemoryBlock> file_;
+  TileDecoder decode_ = nullptr;
+  // Both indexed by tile id. Neither is resized after creation, so the grid
+  // can be read without a lock and the views in "ids_" stay valid.
+  std::vector<std::string> names_;
+  std::unique_ptr<Entry[]> entries_;
+  absl::flat_hash_map<std::string_view, TileId> ids_;
+  absl::flat_hash_map<uint64_t, TileId> coord_ids_;
+  absl::flat_hash_set<Symbol> tile_types_;
+};
+}  // namespace fpga
+#endif  // FPGA_LAZY_TILE_GRID_H
@@ -0,0 +1,153 @@
+#include "fpga/lazy-tile-grid.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-parsers.h"
+#include "fpga/memory-mapped-file.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+class StringMemoryBlock final : public MemoryBlock {
+ public:
+  explicit StringMemoryBlock(std::string content)
+      : content_(std::move(content)) {}
+  std::string_view AsStringView() const final { return content_; }
+
+ private:
+  const std::string content_;
+};
+
+// TILE_B lacks most of its members, so it cannot be decoded.
+constexpr std::string_view kTileGridJSON = R"({
+  "TILE_A": {
+    "bits": {
+      "CLB_IO_CLK": {
+        "alias": {"sites": {}, "start_offset": 2, "type": "LIOB33"},
+        "baseaddr": "0x00400000",
+        "frames": 42,
+        "offset": 0,
+        "words": 2
+      }
+    },
+    "grid_x": 0,
+    "grid_y": 155,
+    "pin_functions": {"IOB_X0Y0": "IO_L6P_T0_PUDC_B_14"},
+    "prohibited_sites": [],
+    "sites": {"IOB_X0Y0": "IOB33"},
+    "type": "LIOB33_SING"
+  },
+  "TILE_B": {"type": "NULL", "note": "{\"type\": \"}"}
+})";
+
+absl::StatusOr<LazyTileGrid> TestGrid() {
+  return LazyTileGrid::FromJSON(
+    std::make_shared<StringMemoryBlock>(std::string(kTileGridJSON)));
+}
+
+TEST(LazyTileGrid, DecodesTilesOnFirstAccess) {
+  const absl::StatusOr<LazyTileGrid> grid = TestGrid();
+  ASSERT_TRUE(grid.ok()) << grid.status();
+  EXPECT_EQ(grid->size(), 2);
+  EXPECT_TRUE(grid->contains("TILE_B"));
+  EXPECT_EQ(grid->find("TILE_C"), nullptr);
+
+  const Tile *tile = grid->find("TILE_A");
+  ASSERT_NE(tile, nullptr);
+  EXPECT_EQ(tile, &grid->at("TILE_A"));
+  EXPECT_EQ(tile->type, "LIOB33_SING");
+  EXPECT_EQ(tile->coord.y, 155);
+  EXPECT_EQ(tile->bits.at(ConfigBusType::kCLBIOCLK).base_address, 0x400000);
+  EXPECT_THAT(grid->tile_types(),
+              ::testing::IsSupersetOf({"LIOB33_SING", "LIOB33", "NULL"}));
+}
+
+TEST(LazyTileGrid, LooksUpTileIdsByNameAndCoordinates) {
+  const absl::StatusOr<LazyTileGrid> grid = TestGrid();
+  ASSERT_TRUE(grid.ok()) << grid.status();
+  // Ids are given in file order.
+  EXPECT_EQ(grid->FindId("TILE_A"), 0);
+  EXPECT_EQ(grid->FindId("TILE_B"), 1);
+  EXPECT_EQ(grid->FindId("TILE_C"), std::nullopt);
+  EXPECT_EQ(grid->name(1), "TILE_B");
+  // Coordinates are known without decoding.
+  EXPECT_EQ(grid->FindId(Location{0, 155}), 0);
+  EXPECT_EQ(grid->FindId(Location{1, 155}), std::nullopt);
+  EXPECT_EQ(grid->tile(0).type, "LIOB33_SING");
+}
+
+TEST(LazyTileGrid, ForEachMentioningDecodesMatchingTilesOnly) {
+  const absl::StatusOr<LazyTileGrid> grid = TestGrid();
+  ASSERT_TRUE(grid.ok()) << grid.status();
+  std::vector<std::string> names;
+  const absl::Status status = grid->ForEachMentioning(
+    "PUDC_B", [&names](const std::string &name, const Tile &tile) {
+      names.push_back(name);
+      EXPECT_EQ(tile.pin_functions.size(), 1);
+    });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_THAT(names, ::testing::ElementsAre("TILE_A"));
+}
+
+TEST(LazyTileGrid, TileThatCannotBeDecodedIsAnError) {
+  const absl::StatusOr<LazyTileGrid> grid = TestGrid();
+  ASSERT_TRUE(grid.ok()) << grid.status();
+  EXPECT_FALSE(grid->status(1).ok());
+  EXPECT_TRUE(grid->tile(1).type.empty());
+  EXPECT_TRUE(grid->tile(1).bits.empty());
+  EXPECT_EQ(grid->find("TILE_B"), nullptr);
+  EXPECT_TRUE(grid->status(0).ok());
+  // The other tiles are still visited.
+  std::vector<std::string> names;
+  const absl::Status status =
+    grid->ForEach([&names](const std::string &name, const Tile &) {
+      names.push_back(name);
+    });
+  EXPECT_FALSE(status.ok());
+  EXPECT_THAT(names, ::testing::ElementsAre("TILE_A"));
+}
+
+TEST(LazyTileGrid, FromDecodedTiles) {
+  TileGrid tiles;
+  tiles["CLBLL_L_X2Y10"].type = Symbol("CLBLL_L");
+  tiles["LIOB33_X0Y1"].bits[ConfigBusType::kCLBIOCLK].alias =
+    BitsBlockAlias{.sites = {},
+                   .start_offset = 0,
+                   .type = Symbol("LIOB33_SING")};
+  tiles["CLBLL_L_X2Y10"].coord = {2, 10};
+  tiles["LIOB33_X0Y1"].coord = {0, 1};
+  const LazyTileGrid grid(std::move(tiles));
+  EXPECT_EQ(grid.at("CLBLL_L_X2Y10").type, "CLBLL_L");
+  const std::optional<TileId> id = grid.FindId(Location{2, 10});
+  ASSERT_TRUE(id.has_value());
+  EXPECT_EQ(grid.name(*id), "CLBLL_L_X2Y10");
+  EXPECT_EQ(grid.FindId("CLBLL_L_X2Y10"), id);
+  EXPECT_THAT(grid.tile_types(),
+              ::testing::IsSupersetOf({"CLBLL_L", "LIOB33_SING"}));
+  int count = 0;
+  EXPECT_TRUE(grid
+                .ForEachMentioning("PUDC_B",
+                                   [&count](const std::string &,
+                                            const Tile &) { ++count; })
+                .ok());
+  EXPECT_EQ(count, 2);
+}
+
+TEST(LazyTileGrid, InvalidJSONIsRejected) {
+  for (const char *json : {"", "[]", "{", R"({"TILE_A": 1})",
+                           R"({"TILE_A": {"type": "A"})", R"({} {})"}) {
+    EXPECT_FALSE(
+      LazyTileGrid::FromJSON(std::make_shared<StringMemoryBlock>(json)).ok())
+      << json;
+  }
+}
+}  // namespace
+}  // namespace fpga
@@ -0,0 +1,113 @@
+#include "fpga/packed-segments-bits.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+
+namespace fpga {
+size_t PackedSegmentsBits::Hash(std::string_view tile_feature,
+                                uint32_t address) {
+  return absl::HashOf(tile_feature, address);
+}
+
+bool PackedSegmentsBits::Find(std::string_view tile_feature, uint32_t address,
+                              absl::Span<const PackedSegmentBit> &bits) const {
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = Hash(tile_feature, address) & mask;; i = (i + 1) & mask) {
+    const uint32_t slot = slots_[i];
+    if (slot == kEmptySlot) {
+      return false;
+    }
+    const Feature candidate = feature(slot);
+    if (candidate.address == address &&
+        candidate.tile_feature == tile_feature) {
+      bits = candidate.bits;
+      return true;
+    }
+  }
+}
+
+absl::Status PackedSegmentsBitsBuilder::Add(std::string_view tile_feature,
+                                            uint32_t address,
+                                            absl::Span<const SegmentBit> bits) {
+  constexpr size_t kMaxCount = std::numeric_limits<uint16_t>::max();
+  if (tile_feature.size() > kMaxCount || bits.size() > kMaxCount ||
+      packed_.features_.size() >= PackedSegmentsBits::kEmptySlot / 2) {
+    return absl::ResourceExhaustedError(
+      absl::StrFormat("feature \"%s\" too large to pack", tile_feature));
+  }
+  for (const SegmentBit &bit : bits) {
+    if (bit.word_column > PackedSegmentBit::kMaxWordColumn ||
+        bit.word_bit > PackedSegmentBit::kMaxWordBit) {
+      return absl::OutOfRangeError(absl::StrFormat(
+        "bit %d_%d of \"%s\" out of range", bit.word_column, bit.word_bit,
+        tile_feature));
+    }
+  }
+  // Names and bits are referred to by 32 bit offsets.
+  constexpr size_t kMaxOffset = std::numeric_limits<uint32_t>::max();
+  if (packed_.names_.size() > kMaxOffset - tile_feature.size() ||
+      packed_.bits_.size() > kMaxOffset - bits.size()) {
+    return absl::ResourceExhaustedError(absl::StrFormat(
+      "too many features to pack, cannot add \"%s\"", tile_feature));
+  }
+  const size_t bits_begin = packed_.bits_.size();
+  for (const SegmentBit &bit : bits) {
+    packed_.bits_.emplace_back(bit.word_column, bit.word_bit, bit.is_set);
+  }
+  packed_.features_.push_back({
+    .name_offset = static_cast<uint32_t>(packed_.names_.size()),
+    .name_size = static_cast<uint16_t>(tile_feature.size()),
+    .bits_count = static_cast<uint16_t>(bits.size()),
+    .address = address,
+    .bits_begin = static_cast<uint32_t>(bits_begin),
+  });
+  packed_.names_.append(tile_feature);
+  return absl::OkStatus();
+}
+
+PackedSegmentsBits PackedSegmentsBitsBuilder::Build() && {
+  PackedSegmentsBits packed = std::move(packed_);
+  // At most half full, so that probe sequences stay short.
+  packed.slots_.assign(std::bit_ceil(2 * packed.features_.size() + 1),
+                       PackedSegmentsBits::kEmptySlot);
+  const size_t mask = packed.slots_.size() - 1;
+  for (size_t f = 0; f < packed.features_.size(); ++f) {
+    const PackedSegmentsBits::Feature feature = packed.feature(f);
+    size_t i = PackedSegmentsBits::Hash(feature.tile_feature, feature.address) &
+               mask;
+    while (packed.slots_[i] != PackedSegmentsBits::kEmptySlot) {
+      i = (i + 1) & mask;
+    }
+    packed.slots_[i] = f;
+  }
+  packed.features_.shrink_to_fit();
+  packed.bits_.shrink_to_fit();
+  packed.names_.shrink_to_fit();
+  return packed;
+}
+
+absl::StatusOr<PackedSegmentsBits> PackSegmentsBits(
+  const SegmentsBits &segbits) {
+  PackedSegmentsBitsBuilder builder;
+  for (const auto &[feature, bits] : segbits) {
+    const absl::Status status =
+      builder.Add(feature.tile_feature, feature.address, bits);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return std::move(builder).Build();
+}
+}  // namespace fpga
@@ -0,0 +1,102 @@
+#ifndef FPGA_PACKED_SEGMENTS_BITS_H
+#define FPGA_PACKED_SEGMENTS_BITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+
+namespace fpga {
+// A SegmentBit in 32 bits: the word bit in the low 16 bits, the word column
+// in the next 15 and whether the bit is set in the top one.
+class PackedSegmentBit {
+ public:
+  static constexpr uint32_t kMaxWordColumn = (1 << 15) - 1;
+  static constexpr uint32_t kMaxWordBit = (1 << 16) - 1;
+
+  PackedSegmentBit(uint32_t word_column, uint32_t word_bit, bool is_set)
+      : value_(word_bit | word_column << 16 | uint32_t(is_set) << 31) {}
+
+  uint32_t word_column() const { return (value_ >> 16) & kMaxWordColumn; }
+  uint32_t word_bit() const { return value_ & kMaxWordBit; }
+  bool is_set() const { return value_ >> 31; }
+
+ private:
+  uint32_t value_;
+};
+
+// Read-only SegmentsBits stored in three contiguous arrays: the features,
+// their bits and the feature names. Features are found through an open
+// addressing table of indices into the features.
+class PackedSegmentsBits {
+ public:
+  struct Feature {
+    std::string_view tile_feature;
+    uint32_t address;
+    absl::Span<const PackedSegmentBit> bits;
+  };
+
+  // Number of features.
+  size_t size() const { return features_.size(); }
+
+  // The i-th feature, in the order they were added.
+  Feature feature(size_t i) const {
+    const Entry &entry = features_[i];
+    return {
+      .tile_feature =
+        std::string_view(names_).substr(entry.name_offset, entry.name_size),
+      .address = entry.address,
+      .bits = absl::MakeConstSpan(bits_).subspan(entry.bits_begin,
+                                                 entry.bits_count),
+    };
+  }
+
+  // Look up the bits of the "tile_feature" at "address". Returns false if
+  // there is no such feature.
+  bool Find(std::string_view tile_feature, uint32_t address,
+            absl::Span<const PackedSegmentBit> &bits) const;
+
+ private:
+  friend class PackedSegmentsBitsBuilder;
+
+  struct Entry {
+    uint32_t name_offset;
+    uint16_t name_size;
+    uint16_t bits_count;
+    uint32_t address;
+    uint32_t bits_begin;
+  };
+  static constexpr uint32_t kEmptySlot = 0xffffffff;
+
+  static size_t Hash(std::string_view tile_feature, uint32_t address);
+
+  std::vector<Entry> features_;
+  std::vector<PackedSegmentBit> bits_;
+  std::string names_;
+  // Indices into "features_", a power of two in size.
+  std::vector<uint32_t> slots_ = {kEmptySlot};
+};
+
+class PackedSegmentsBitsBuilder {
+ public:
+  // Add a feature; each feature and address may only be added once. Fails if
+  // it does not fit the packed form.
+  absl::Status Add(std::string_view tile_feature, uint32_t address,
+                   absl::Span<const SegmentBit> bits);
+
+  PackedSegmentsBits Build() &&;
+
+ private:
+  PackedSegmentsBits packed_;
+};
+
+absl::StatusOr<PackedSegmentsBits> PackSegmentsBits(
+  const SegmentsBits &segbits);
+}  // namespace fpga
+#endif  // FPGA_PACKED_SEGMENTS_BITS_H
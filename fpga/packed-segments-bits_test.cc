@@ -0,0 +1,86 @@
+#include "fpga/packed-segments-bits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "fpga/database-parsers.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+TEST(PackedSegmentBit, PacksAllFields) {
+  const PackedSegmentBit bit(PackedSegmentBit::kMaxWordColumn,
+                             PackedSegmentBit::kMaxWordBit, true);
+  EXPECT_EQ(bit.word_column(), PackedSegmentBit::kMaxWordColumn);
+  EXPECT_EQ(bit.word_bit(), PackedSegmentBit::kMaxWordBit);
+  EXPECT_TRUE(bit.is_set());
+  const PackedSegmentBit unset(27, 301, false);
+  EXPECT_EQ(unset.word_column(), 27);
+  EXPECT_EQ(unset.word_bit(), 301);
+  EXPECT_FALSE(unset.is_set());
+}
+
+TEST(PackedSegmentsBits, FindsEveryFeature) {
+  SegmentsBits segbits;
+  // Enough features for the probe sequences to collide.
+  for (uint32_t address = 0; address < 64; ++address) {
+    segbits[{"BRAM_L.RAMB18_Y0.INIT_00", address}] = {
+      {address % 128, address * 5, address % 2 == 0}};
+  }
+  segbits[{"BRAM_L.RAMB18_Y0.IN_USE", 0}] = {{27, 100, true}, {28, 3, false}};
+  const absl::StatusOr<PackedSegmentsBits> packed = PackSegmentsBits(segbits);
+  ASSERT_TRUE(packed.ok()) << packed.status();
+  EXPECT_EQ(packed->size(), segbits.size());
+
+  for (const auto &[feature, expected] : segbits) {
+    absl::Span<const PackedSegmentBit> bits;
+    ASSERT_TRUE(packed->Find(feature.tile_feature, feature.address, bits))
+      << feature.tile_feature << " " << feature.address;
+    ASSERT_EQ(bits.size(), expected.size());
+    for (size_t i = 0; i < bits.size(); ++i) {
+      EXPECT_EQ(bits[i].word_column(), expected[i].word_column);
+      EXPECT_EQ(bits[i].word_bit(), expected[i].word_bit);
+      EXPECT_EQ(bits[i].is_set(), expected[i].is_set);
+    }
+  }
+  absl::Span<const PackedSegmentBit> bits;
+  EXPECT_FALSE(packed->Find("BRAM_L.RAMB18_Y0.IN_USE", 1, bits));
+  EXPECT_FALSE(packed->Find("BRAM_L.RAMB18_Y1.IN_USE", 0, bits));
+}
+
+TEST(PackedSegmentsBits, EnumeratesFeatures) {
+  PackedSegmentsBitsBuilder builder;
+  for (int i = 0; i < 3; ++i) {
+    const SegmentBit bit = {.word_column = 1, .word_bit = 2, .is_set = true};
+    ASSERT_TRUE(builder.Add(absl::StrCat("CLBLL_L.F", i), i, {bit}).ok());
+  }
+  const PackedSegmentsBits packed = std::move(builder).Build();
+  ASSERT_EQ(packed.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    const PackedSegmentsBits::Feature feature = packed.feature(i);
+    EXPECT_EQ(feature.tile_feature, absl::StrCat("CLBLL_L.F", i));
+    EXPECT_EQ(feature.address, i);
+    EXPECT_EQ(feature.bits.size(), 1);
+  }
+}
+
+TEST(PackedSegmentsBits, EmptyFindsNothing) {
+  const PackedSegmentsBits packed;
+  absl::Span<const PackedSegmentBit> bits;
+  EXPECT_FALSE(packed.Find("CLBLL_L.SLICEL_X0.ALUT.INIT", 0, bits));
+}
+
+TEST(PackedSegmentsBits, RejectsBitsOutOfRange) {
+  SegmentsBits segbits;
+  segbits[{"CLBLL_L.F", 0}] = {{PackedSegmentBit::kMaxWordColumn + 1, 0, true}};
+  EXPECT_EQ(PackSegmentsBits(segbits).status().code(),
+            absl::StatusCode::kOutOfRange);
+}
+}  // namespace
+}  // namespace fpga
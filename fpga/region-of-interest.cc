@@ -0,0 +1,151 @@
+#include "fpga/region-of-interest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+
+namespace fpga {
+namespace {
+constexpr std::string_view kTilesPrefix = "tiles:";
+constexpr std::string_view kClockRegionsPrefix = "clock_regions:";
+
+// Parse "X<x>Y<y>", as used for tile and clock region names.
+std::optional<Location> ParseLocation(std::string_view text) {
+  if (!absl::ConsumePrefix(&text, "X")) {
+    return {};
+  }
+  const size_t y_pos = text.find('Y');
+  if (y_pos == std::string_view::npos) {
+    return {};
+  }
+  Location location;
+  if (!absl::SimpleAtoi(text.substr(0, y_pos), &location.x) ||
+      !absl::SimpleAtoi(text.substr(y_pos + 1), &location.y)) {
+    return {};
+  }
+  return location;
+}
+}  // namespace
+
+absl::StatusOr<RegionOfInterest> RegionOfInterest::Parse(
+  std::string_view region, std::string_view buses) {
+  Kind kind;
+  std::string_view corners = region;
+  if (absl::ConsumePrefix(&corners, kTilesPrefix)) {
+    kind = Kind::kTiles;
+  } else if (absl::ConsumePrefix(&corners, kClockRegionsPrefix)) {
+    kind = Kind::kClockRegions;
+  } else {
+    return absl::InvalidArgumentError(absl::StrFormat(
+      "region \"%s\" does not start with \"%s\" or \"%s\"", region,
+      kTilesPrefix, kClockRegionsPrefix));
+  }
+  const std::vector<std::string_view> corner_names =
+    absl::StrSplit(corners, ':');
+  const std::optional<Location> a =
+    corner_names.size() == 2 ? ParseLocation(corner_names[0]) : std::nullopt;
+  const std::optional<Location> b =
+    corner_names.size() == 2 ? ParseLocation(corner_names[1]) : std::nullopt;
+  if (!a.has_value() || !b.has_value()) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+      "region \"%s\": expected corners as X<x>Y<y>:X<x>Y<y>", region));
+  }
+  const Location min = {std::min(a->x, b->x), std::min(a->y, b->y)};
+  const Location max = {std::max(a->x, b->x), std::max(a->y, b->y)};
+
+  absl::flat_hash_set<ConfigBusType> bus_set;
+  for (const std::string_view bus_name :
+       absl::StrSplit(buses, ',', absl::SkipEmpty())) {
+    const std::optional<ConfigBusType> bus = ParseConfigBusType(bus_name);
+    if (!bus.has_value()) {
+      return absl::InvalidArgumentError(
+        absl::StrFormat("unknown bus \"%s\"", bus_name));
+    }
+    bus_set.insert(*bus);
+  }
+  return RegionOfInterest(kind, min, max, std::move(bus_set));
+}
+
+bool RegionOfInterest::Contains(const Tile &tile) const {
+  if (kind_ == Kind::kTiles) {
+    return Contains(tile.coord);
+  }
+  if (!tile.clock_region.has_value()) {
+    return false;
+  }
+  const std::optional<Location> clock_region =
+    ParseLocation(tile.clock_region->str());
+  return clock_region.has_value() && Contains(*clock_region);
+}
+
+absl::btree_set<uint32_t> RegionOfInterest::Frames(
+  const LazyTileGrid &grid) const {
+  absl::btree_set<uint32_t> frames;
+  auto add_frames = [this, &frames](const Tile &tile) {
+    for (const auto &[bus, block] : tile.bits) {
+      if (!AllowsBus(bus)) {
+        continue;
+      }
+      for (uint32_t i = 0; i < block.frames; ++i) {
+        frames.insert(block.base_address + i);
+      }
+    }
+  };
+  const uint64_t width = uint64_t{max_.x} - min_.x + 1;
+  const uint64_t height = uint64_t{max_.y} - min_.y + 1;
+  if (kind_ == Kind::kTiles && width * height <= grid.size()) {
+    // Only the tiles within the rectangle need to be decoded.
+    for (uint64_t x = min_.x; x <= max_.x; ++x) {
+      for (uint64_t y = min_.y; y <= max_.y; ++y) {
+        const std::optional<TileId> tile =
+          grid.FindId(Location{uint32_t(x), uint32_t(y)});
+        if (tile.has_value()) {
+          add_frames(grid.tile(*tile));
+        }
+      }
+    }
+    return frames;
+  }
+  // Tiles that cannot be decoded have no frames to add; they are reported
+  // when their features are resolved.
+  grid
+    .ForEach([this, &add_frames](const std::string &, const Tile &tile) {
+      if (Contains(tile)) {
+        add_frames(tile);
+      }
+    })
+    .IgnoreError();
+  return frames;
+}
+
+bool RegionFrames::ContainsFeature(std::string_view feature) const {
+  const std::string_view tile_name = feature.substr(0, feature.find('.'));
+  const Tile *const tile = grid_.find(tile_name);
+  if (tile == nullptr) {
+    return false;
+  }
+  for (const auto &[bus, block] : tile->bits) {
+    const auto first = frames_.lower_bound(block.base_address);
+    if (first != frames_.end() &&
+        *first - block.base_address < block.frames) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace fpga
@@ -0,0 +1,79 @@
+#ifndef FPGA_REGION_OF_INTEREST_H
+#define FPGA_REGION_OF_INTEREST_H
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+
+namespace fpga {
+// Part of the device to assemble: the tiles within a rectangle of the tile
+// grid or of the clock regions, restricted to a set of configuration buses.
+//
+// Frames span all tiles of a column within a clock region row, so a region
+// that does not cover whole clock region heights still gets the frames of
+// the tiles above and below it; see RegionFrames.
+class RegionOfInterest {
+ public:
+  // "region" is either "tiles:X<x>Y<y>:X<x>Y<y>", a rectangle of the tile
+  // grid, or "clock_regions:X<x>Y<y>:X<x>Y<y>", a rectangle of clock
+  // regions, given by two opposite corners that are both included.
+  // "buses" is a comma separated list of bus names, e.g.
+  // "CLB_IO_CLK,BLOCK_RAM"; all buses if empty.
+  static absl::StatusOr<RegionOfInterest> Parse(std::string_view region,
+                                                std::string_view buses);
+
+  bool Contains(const Tile &tile) const;
+
+  bool AllowsBus(ConfigBusType bus) const {
+    return buses_.empty() || buses_.contains(bus);
+  }
+
+  // Addresses of the frames holding the configuration of the tiles in the
+  // region on the allowed buses. A rectangle of tiles is looked up by grid
+  // coordinates; for clock regions, all the tiles of "grid" are decoded.
+  absl::btree_set<uint32_t> Frames(const LazyTileGrid &grid) const;
+
+ private:
+  enum class Kind { kTiles, kClockRegions };
+
+  RegionOfInterest(Kind kind, Location min, Location max,
+                   absl::flat_hash_set<ConfigBusType> buses)
+      : kind_(kind), min_(min), max_(max), buses_(std::move(buses)) {}
+
+  bool Contains(Location location) const {
+    return location.x >= min_.x && location.x <= max_.x &&
+           location.y >= min_.y && location.y <= max_.y;
+  }
+
+  Kind kind_;
+  Location min_;
+  Location max_;
+  absl::flat_hash_set<ConfigBusType> buses_;
+};
+
+// The frames of a region of interest in "grid". A partial bitstream writes
+// these frames whole, so it needs the features of every tile with bits in
+// them, also of the tiles outside of the region sharing a frame with it.
+class RegionFrames {
+ public:
+  RegionFrames(const RegionOfInterest &roi, const LazyTileGrid &grid)
+      : grid_(grid), frames_(roi.Frames(grid)) {}
+
+  const absl::btree_set<uint32_t> &frames() const { return frames_; }
+
+  // Returns true if the tile of "feature", i.e. the part of its name up to
+  // the first dot, is in the grid and has bits in one of the frames.
+  bool ContainsFeature(std::string_view feature) const;
+
+ private:
+  const LazyTileGrid &grid_;
+  absl::btree_set<uint32_t> frames_;
+};
+}  // namespace fpga
+#endif  // FPGA_REGION_OF_INTEREST_H
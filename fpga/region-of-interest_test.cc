@@ -0,0 +1,146 @@
+#include "fpga/region-of-interest.h"
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/btree_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "fpga/database-parsers.h"
+#include "fpga/lazy-tile-grid.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+Tile MakeTile(uint32_t x, uint32_t y, const char *clock_region) {
+  Tile tile;
+  tile.type = Symbol("CLBLL_L");
+  tile.coord = {x, y};
+  tile.clock_region = Symbol(clock_region);
+  return tile;
+}
+
+TileGrid TestGrid() {
+  TileGrid grid;
+  Tile a = MakeTile(2, 10, "X0Y0");
+  a.bits[ConfigBusType::kCLBIOCLK] = {.alias = {},
+                                      .base_address = 0x100,
+                                      .frames = 3,
+                                      .offset = 0,
+                                      .words = 2};
+  a.bits[ConfigBusType::kBlockRam] = {.alias = {},
+                                      .base_address = 0x800000,
+                                      .frames = 2,
+                                      .offset = 0,
+                                      .words = 10};
+  grid.emplace("CLBLL_L_X2Y10", a);
+  // Above "a" in the same frames, at other words.
+  Tile a_above = MakeTile(2, 9, "X0Y0");
+  a_above.bits[ConfigBusType::kCLBIOCLK] = {.alias = {},
+                                            .base_address = 0x100,
+                                            .frames = 3,
+                                            .offset = 2,
+                                            .words = 2};
+  grid.emplace("CLBLL_L_X2Y9", a_above);
+  Tile b = MakeTile(30, 80, "X1Y1");
+  b.bits[ConfigBusType::kCLBIOCLK] = {.alias = {},
+                                      .base_address = 0x20000,
+                                      .frames = 2,
+                                      .offset = 0,
+                                      .words = 2};
+  grid.emplace("CLBLL_L_X30Y80", b);
+  return grid;
+}
+
+TEST(RegionOfInterest, RejectsMalformedRegions) {
+  for (const char *region :
+       {"", "X0Y0:X1Y1", "tiles:X0Y0", "tiles:X0Y0:X1", "tiles:0,0:1,1",
+        "clock_regions:X0Y0:X1Y1:X2Y2", "rows:X0Y0:X1Y1"}) {
+    EXPECT_EQ(RegionOfInterest::Parse(region, "").status().code(),
+              absl::StatusCode::kInvalidArgument)
+      << region;
+  }
+  EXPECT_FALSE(RegionOfInterest::Parse("tiles:X0Y0:X1Y1", "NO_BUS").ok());
+}
+
+TEST(RegionOfInterest, TileRectangleWithCornersInAnyOrder) {
+  const absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("tiles:X10Y20:X0Y0", "");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_TRUE(roi->Contains(MakeTile(0, 0, "X0Y0")));
+  EXPECT_TRUE(roi->Contains(MakeTile(10, 20, "X5Y5")));
+  EXPECT_FALSE(roi->Contains(MakeTile(11, 20, "X0Y0")));
+  EXPECT_FALSE(roi->Contains(MakeTile(0, 21, "X0Y0")));
+  EXPECT_TRUE(roi->AllowsBus(ConfigBusType::kBlockRam));
+}
+
+TEST(RegionOfInterest, ClockRegionRectangle) {
+  const absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("clock_regions:X0Y0:X0Y1", "");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_TRUE(roi->Contains(MakeTile(100, 100, "X0Y1")));
+  EXPECT_FALSE(roi->Contains(MakeTile(0, 0, "X1Y0")));
+  Tile no_clock_region = MakeTile(0, 0, "X0Y0");
+  no_clock_region.clock_region.reset();
+  EXPECT_FALSE(roi->Contains(no_clock_region));
+}
+
+TEST(RegionFrames, ContainsFeaturesOfTilesSharingFrames) {
+  const LazyTileGrid grid(TestGrid());
+  const absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("tiles:X2Y10:X2Y10", "");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  ASSERT_FALSE(roi->Contains(MakeTile(2, 9, "X0Y0")));
+  const RegionFrames region_frames(*roi, grid);
+  EXPECT_TRUE(
+    region_frames.ContainsFeature("CLBLL_L_X2Y10.SLICEL_X0.AFF.ZINI"));
+  // Outside of the region, but written with the frames of "CLBLL_L_X2Y10".
+  EXPECT_TRUE(region_frames.ContainsFeature("CLBLL_L_X2Y9.SLICEL_X0.AFF.ZINI"));
+  EXPECT_FALSE(
+    region_frames.ContainsFeature("CLBLL_L_X30Y80.SLICEL_X0.AFF.ZINI"));
+  EXPECT_FALSE(region_frames.ContainsFeature("UNKNOWN_X0Y0.FEATURE"));
+}
+
+TEST(RegionFrames, FeaturesOfOtherBusesAreNotContained) {
+  const LazyTileGrid grid(TestGrid());
+  const absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("tiles:X2Y9:X2Y9", "BLOCK_RAM");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  // "CLBLL_L_X2Y9" has no block RAM frames.
+  const RegionFrames region_frames(*roi, grid);
+  EXPECT_TRUE(region_frames.frames().empty());
+  EXPECT_FALSE(
+    region_frames.ContainsFeature("CLBLL_L_X2Y9.SLICEL_X0.AFF.ZINI"));
+}
+
+TEST(RegionOfInterest, FramesOfAllowedBuses) {
+  const LazyTileGrid grid(TestGrid());
+  absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("clock_regions:X0Y0:X0Y0", "");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_EQ(roi->Frames(grid), (absl::btree_set<uint32_t>{
+                                 0x100, 0x101, 0x102, 0x800000, 0x800001}));
+
+  roi = RegionOfInterest::Parse("clock_regions:X0Y0:X1Y1", "CLB_IO_CLK");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_FALSE(roi->AllowsBus(ConfigBusType::kBlockRam));
+  EXPECT_EQ(roi->Frames(grid), (absl::btree_set<uint32_t>{
+                                 0x100, 0x101, 0x102, 0x20000, 0x20001}));
+}
+
+TEST(RegionOfInterest, FramesOfTileRectangle) {
+  const LazyTileGrid grid(TestGrid());
+  // Small enough to be looked up by coordinates.
+  absl::StatusOr<RegionOfInterest> roi =
+    RegionOfInterest::Parse("tiles:X2Y10:X2Y10", "CLB_IO_CLK");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_EQ(roi->Frames(grid),
+            (absl::btree_set<uint32_t>{0x100, 0x101, 0x102}));
+
+  roi = RegionOfInterest::Parse("tiles:X0Y0:X30Y80", "CLB_IO_CLK");
+  ASSERT_TRUE(roi.ok()) << roi.status();
+  EXPECT_EQ(roi->Frames(grid), (absl::btree_set<uint32_t>{
+                                 0x100, 0x101, 0x102, 0x20000, 0x20001}));
+}
+}  // namespace
+}  // namespace fpga
@@ -0,0 +1,98 @@
+#include "fpga/symbol-table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "absl/log/check.h"
+#include "absl/synchronization/mutex.h"
+
+namespace fpga {
+SymbolTable::SymbolTable() {
+  const uint32_t empty = Intern("");
+  CHECK_EQ(empty, 0);
+}
+
+SymbolTable &SymbolTable::Global() {
+  // Never destroyed, symbols may still be used by other static destructors.
+  static SymbolTable *const table = new SymbolTable();
+  return *table;
+}
+
+uint32_t SymbolTable::Intern(std::string_view str) {
+  {
+    const absl::ReaderMutexLock lock(&mu_);
+    const auto found = ids_.find(str);
+    if (found != ids_.end()) {
+      return found->second;
+    }
+  }
+  const absl::MutexLock lock(&mu_);
+  const auto found = ids_.find(str);
+  if (found != ids_.end()) {
+    return found->second;
+  }
+  const uint32_t id = ids_.size();
+  const auto [segment, offset] = Locate(id);
+  std::string_view *strings =
+    segments_[segment].load(std::memory_order_relaxed);
+  if (strings == nullptr) {
+    const size_t segment_size = size_t{kFirstSegmentSize} << segment;
+    segment_storage_.push_back(
+      std::make_unique<std::string_view[]>(segment_size));
+    strings = segment_storage_.back().get();
+    segments_[segment].store(strings, std::memory_order_release);
+  }
+  const std::string_view stored = Store(str);
+  strings[offset] = stored;
+  ids_.emplace(stored, id);
+  return id;
+}
+
+std::optional<uint32_t> SymbolTable::Find(std::string_view str) const {
+  const absl::ReaderMutexLock lock(&mu_);
+  const auto found = ids_.find(str);
+  if (found == ids_.end()) {
+    return std::nullopt;
+  }
+  return found->second;
+}
+
+size_t SymbolTable::size() const {
+  const absl::ReaderMutexLock lock(&mu_);
+  return ids_.size();
+}
+
+std::string_view SymbolTable::Store(std::string_view str) {
+  if (str.empty()) {
+    return {};
+  }
+  if (str.size() > arena_free_) {
+    // Strings larger than a block get a block of their own.
+    const size_t block_size = std::max(str.size(), kArenaBlockSize);
+    arena_.push_back(std::make_unique<char[]>(block_size));
+    arena_next_ = arena_.back().get();
+    arena_free_ = block_size;
+  }
+  char *const begin = arena_next_;
+  std::memcpy(begin, str.data(), str.size());
+  arena_next_ += str.size();
+  arena_free_ -= str.size();
+  return {begin, str.size()};
+}
+
+std::optional<Symbol> Symbol::Find(std::string_view str) {
+  const std::optional<uint32_t> id = SymbolTable::Global().Find(str);
+  if (!id.has_value()) {
+    return std::nullopt;
+  }
+  Symbol symbol;
+  symbol.id_ = *id;
+  return symbol;
+}
+}  // namespace fpga
@@ -0,0 +1,116 @@
+#ifndef FPGA_SYMBOL_TABLE_H
+#define FPGA_SYMBOL_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace fpga {
+// Interns strings into dense 32-bit ids. Interned strings are copied into an
+// arena owned by the table, so their views stay valid as long as the table
+// lives; the empty string is always id 0.
+// Safe to be used concurrently; looking up the string of an id never takes a
+// lock.
+class SymbolTable {
+ public:
+  SymbolTable();
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+
+  // The table all Symbols are interned in.
+  static SymbolTable &Global();
+
+  // Id of "str", which is added if it is not in the table yet.
+  uint32_t Intern(std::string_view str);
+
+  // Id of "str" if it was interned.
+  std::optional<uint32_t> Find(std::string_view str) const;
+
+  // The string of "id", which must have been returned by this table.
+  std::string_view str(uint32_t id) const {
+    const auto [segment, offset] = Locate(id);
+    return segments_[segment].load(std::memory_order_acquire)[offset];
+  }
+
+  // Number of strings interned so far.
+  size_t size() const;
+
+ private:
+  // Ids are stored in segments of doubling size, so that stored strings
+  // never move and existing segments can be read while new ones are added.
+  static constexpr uint32_t kFirstSegmentSize = 1024;
+  static constexpr size_t kSegmentCount = 23;
+  static constexpr size_t kArenaBlockSize = 64 * 1024;
+
+  static std::pair<size_t, uint32_t> Locate(uint32_t id) {
+    const uint32_t slot = id / kFirstSegmentSize + 1;
+    const size_t segment = std::bit_width(slot) - 1;
+    return {segment, id - kFirstSegmentSize * ((uint32_t{1} << segment) - 1)};
+  }
+
+  // Copy "str" into the arena.
+  std::string_view Store(std::string_view str)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<std::string_view, uint32_t> ids_ ABSL_GUARDED_BY(mu_);
+  std::array<std::atomic<std::string_view *>, kSegmentCount> segments_ = {};
+  std::vector<std::unique_ptr<std::string_view[]>> segment_storage_
+    ABSL_GUARDED_BY(mu_);
+  std::vector<std::unique_ptr<char[]>> arena_ ABSL_GUARDED_BY(mu_);
+  char *arena_next_ ABSL_GUARDED_BY(mu_) = nullptr;
+  size_t arena_free_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+// A string interned in the global SymbolTable. Comparing and hashing symbols
+// only looks at their ids, so they are cheaper than the strings as keys, and
+// each distinct string is only stored once.
+class Symbol {
+ public:
+  // The empty string.
+  Symbol() = default;
+
+  // Interns "str", which is then kept for the lifetime of the process. Only
+  // for strings that are part of the database; look up strings of other
+  // origin with Find().
+  explicit Symbol(std::string_view str)
+      : id_(SymbolTable::Global().Intern(str)) {}
+
+  // The symbol of "str" if it was interned already, without interning it.
+  static std::optional<Symbol> Find(std::string_view str);
+
+  uint32_t id() const { return id_; }
+  std::string_view str() const { return SymbolTable::Global().str(id_); }
+  bool empty() const { return id_ == 0; }
+
+  friend bool operator==(Symbol a, Symbol b) { return a.id_ == b.id_; }
+  // Compares the string, so that it does not need to be interned.
+  friend bool operator==(Symbol a, std::string_view b) { return a.str() == b; }
+
+  template <typename H>
+  friend H AbslHashValue(H h, Symbol symbol) {
+    return H::combine(std::move(h), symbol.id_);
+  }
+
+  friend std::ostream &operator<<(std::ostream &out, Symbol symbol) {
+    return out << symbol.str();
+  }
+
+ private:
+  uint32_t id_ = 0;
+};
+}  // namespace fpga
+#endif  // FPGA_SYMBOL_TABLE_H
@@ -0,0 +1,75 @@
+#include "fpga/symbol-table.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "fpga/thread-pool.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+TEST(SymbolTable, InternsEachStringOnce) {
+  SymbolTable table;
+  EXPECT_EQ(table.Intern(""), 0);
+  const uint32_t a = table.Intern("CLBLL_L");
+  const uint32_t b = table.Intern("CLBLM_R");
+  EXPECT_NE(a, b);
+  EXPECT_EQ(table.Intern(std::string("CLBLL_L")), a);
+  EXPECT_EQ(table.str(a), "CLBLL_L");
+  EXPECT_EQ(table.Find("CLBLM_R"), b);
+  EXPECT_EQ(table.Find("LIOB33"), std::nullopt);
+  EXPECT_EQ(table.size(), 3);
+}
+
+TEST(SymbolTable, StringsStayValidAsTheTableGrows) {
+  SymbolTable table;
+  const std::string_view first = table.str(table.Intern("first"));
+  const std::string large(100 * 1024, 'x');
+  const uint32_t large_id = table.Intern(large);
+  // Enough to span a few segments.
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < 10000; ++i) {
+    ids.push_back(table.Intern("TILE_X" + std::to_string(i)));
+  }
+  EXPECT_EQ(first, "first");
+  EXPECT_EQ(table.str(large_id), large);
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(table.str(ids[i]), "TILE_X" + std::to_string(i));
+  }
+}
+
+TEST(SymbolTable, ConcurrentInterningAgreesOnIds) {
+  SymbolTable table;
+  std::vector<uint32_t> ids(4000);
+  ThreadPool pool(8);
+  pool.ParallelFor(ids.size(), [&table, &ids](size_t i) {
+    ids[i] = table.Intern("SITE_" + std::to_string(i % 1000));
+  });
+  for (size_t i = 1000; i < ids.size(); ++i) {
+    EXPECT_EQ(ids[i], ids[i % 1000]);
+  }
+  EXPECT_EQ(absl::flat_hash_set<uint32_t>(ids.begin(), ids.end()).size(),
+            1000);
+}
+
+TEST(Symbol, ComparesByInternedString) {
+  const Symbol type("LIOB33");
+  EXPECT_EQ(type, Symbol(std::string("LIOB33")));
+  EXPECT_NE(type, Symbol("LIOB33_SING"));
+  EXPECT_EQ(type.str(), "LIOB33");
+  EXPECT_TRUE(Symbol().empty());
+  EXPECT_EQ(Symbol::Find("LIOB33"), type);
+  EXPECT_EQ(Symbol::Find("NEVER_INTERNED_ANYWHERE"), std::nullopt);
+}
+
+TEST(Symbol, ComparesWithStringsWithoutInterning) {
+  const Symbol type("LIOB33");
+  EXPECT_TRUE(type == "LIOB33");
+  EXPECT_FALSE(type == "NEVER_INTERNED_BY_COMPARING");
+  EXPECT_EQ(Symbol::Find("NEVER_INTERNED_BY_COMPARING"), std::nullopt);
+}
+}  // namespace
+}  // namespace fpga
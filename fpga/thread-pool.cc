@@ -0,0 +1,79 @@
+#include "fpga/thread-pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+
+namespace fpga {
+ThreadPool::ThreadPool(int thread_count) {
+  const int count = std::max(thread_count, 1);
+  threads_.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    threads_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const absl::MutexLock lock(&mu_);
+    stopping_ = true;
+  }
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> work) {
+  const absl::MutexLock lock(&mu_);
+  queue_.push_back(std::move(work));
+  ++pending_;
+}
+
+void ThreadPool::Wait() {
+  const absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(
+    +[](size_t *pending) { return *pending == 0; }, &pending_));
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)> &fn) {
+  if (count == 0) return;
+  if (count == 1) {
+    fn(0);
+    return;
+  }
+  absl::BlockingCounter done(static_cast<int>(count));
+  for (size_t i = 0; i < count; ++i) {
+    Schedule([&fn, &done, i] {
+      fn(i);
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+}
+
+void ThreadPool::WorkerLoop() {
+  for (;;) {
+    std::function<void()> work;
+    {
+      const absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(
+        +[](ThreadPool *pool) {
+          return pool->stopping_ || !pool->queue_.empty();
+        },
+        this));
+      // Drain the queue before honoring a stop request.
+      if (queue_.empty()) return;
+      work = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    work();
+    const absl::MutexLock lock(&mu_);
+    --pending_;
+  }
+}
+}  // namespace fpga
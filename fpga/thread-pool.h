@@ -0,0 +1,49 @@
+#ifndef FPGA_THREAD_POOL_H
+#define FPGA_THREAD_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace fpga {
+// Fixed size pool of worker threads running scheduled closures in FIFO order.
+// The destructor waits for all the scheduled work to finish.
+class ThreadPool {
+ public:
+  // Creates a pool with "thread_count" workers; at least one is created.
+  explicit ThreadPool(int thread_count);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of worker threads.
+  int size() const { return static_cast<int>(threads_.size()); }
+
+  // Queue "work" to be run by one of the workers.
+  void Schedule(std::function<void()> work);
+
+  // Block until all the scheduled work is done.
+  void Wait();
+
+  // Run fn(0) ... fn(count - 1) on the pool and block until all of them
+  // returned. Must not be called from one of the pool workers.
+  void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+ private:
+  void WorkerLoop();
+
+  absl::Mutex mu_;
+  std::deque<std::function<void()>> queue_ ABSL_GUARDED_BY(mu_);
+  // Scheduled closures that did not finish yet.
+  size_t pending_ ABSL_GUARDED_BY(mu_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+  std::vector<std::thread> threads_;
+};
+}  // namespace fpga
+#endif  // FPGA_THREAD_POOL_H
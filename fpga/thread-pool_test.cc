@@ -0,0 +1,43 @@
+#include "fpga/thread-pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace {
+TEST(ThreadPool, RunsAllScheduledWork) {
+  std::atomic<int> counter = 0;
+  {
+    ThreadPool pool(4);
+    for (int i = 0; i < 1000; ++i) {
+      pool.Schedule([&counter] { ++counter; });
+    }
+    pool.Wait();
+    EXPECT_EQ(counter, 1000);
+    pool.Schedule([&counter] { ++counter; });
+  }
+  // Destructor waits for the remaining work.
+  EXPECT_EQ(counter, 1001);
+}
+
+TEST(ThreadPool, ParallelForVisitsEachIndexOnce) {
+  ThreadPool pool(3);
+  std::vector<int> visits(257, 0);
+  pool.ParallelFor(visits.size(), [&visits](size_t i) { ++visits[i]; });
+  for (const int v : visits) {
+    EXPECT_EQ(v, 1);
+  }
+}
+
+TEST(ThreadPool, AtLeastOneWorker) {
+  ThreadPool pool(0);
+  EXPECT_EQ(pool.size(), 1);
+  bool called = false;
+  pool.ParallelFor(2, [&called](size_t) { called = true; });
+  EXPECT_TRUE(called);
+}
+}  // namespace
+}  // namespace fpga
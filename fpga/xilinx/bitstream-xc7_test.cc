@@ -0,0 +1,150 @@
+#include "fpga/xilinx/bitstream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "fpga/xilinx/arch-types.h"
+#include "fpga/xilinx/arch-xc7-frame.h"
+#include "fpga/xilinx/bitstream-reader.h"
+#include "fpga/xilinx/configuration.h"
+#include "fpga/xilinx/dense-frames.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace xilinx {
+namespace {
+constexpr fpga::xilinx::Architecture kArch = fpga::xilinx::Architecture::kXC7;
+using ArchType = ArchitectureType<kArch>;
+using ConfigurationPacket = ArchType::ConfigurationPacket;
+using ConfigurationRegister = ArchType::ConfigurationRegister;
+using FrameAddress = ArchType::FrameAddress;
+using Part = ArchType::Part;
+using FrameWords = ArchType::FrameWords;
+using BitStreamType = BitStream<kArch>;
+using ConfigurationType = Configuration<kArch>;
+
+const std::vector<FrameAddress> &TestAddresses() {
+  static const std::vector<FrameAddress> addresses = {
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 1),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 2),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 1)};
+  return addresses;
+}
+
+Part TestPart() { return Part(0x1234, TestAddresses()); }
+
+// Frames with a few words set, as a design would leave them.
+DenseFrames<kArch> BaseFrames() {
+  DenseFrames<kArch> frames(TestPart());
+  frames.Touch(TestAddresses()[0])[0] = 0xAA;
+  frames.Touch(TestAddresses()[2])[100] = 0xBB;
+  frames.Touch(TestAddresses()[3])[50] = 0xCC;
+  return frames;
+}
+
+// A bitstream read back as the configuration it loads. The configuration
+// frames point into the reader's packets, so both are kept together.
+struct LoadedBitstream {
+  std::optional<BitstreamReader<kArch>> reader;
+  std::optional<ConfigurationType> configuration;
+};
+
+LoadedBitstream ReadConfiguration(const std::string &bitstream) {
+  LoadedBitstream loaded;
+  loaded.reader = BitstreamReader<kArch>::InitWithBytes(absl::MakeConstSpan(
+    reinterpret_cast<const uint8_t *>(bitstream.data()), bitstream.size()));
+  if (loaded.reader.has_value()) {
+    loaded.configuration =
+      ConfigurationType::InitWithPackets(TestPart(), loaded.reader.value());
+  }
+  return loaded;
+}
+
+// Addresses of the FAR writes of "bitstream", one per run of frames.
+std::vector<uint32_t> FrameAddressWrites(const std::string &bitstream) {
+  std::vector<uint32_t> writes;
+  auto reader = BitstreamReader<kArch>::InitWithBytes(absl::MakeConstSpan(
+    reinterpret_cast<const uint8_t *>(bitstream.data()), bitstream.size()));
+  EXPECT_TRUE(reader.has_value());
+  if (!reader.has_value()) {
+    return writes;
+  }
+  for (const ConfigurationPacket &packet : reader.value()) {
+    if (packet.opcode() == ConfigurationPacket::Opcode::kWrite &&
+        packet.address() == ConfigurationRegister::kFAR &&
+        !packet.data().empty()) {
+      writes.push_back(packet.data()[0]);
+    }
+  }
+  return writes;
+}
+
+TEST(XC7BitStreamTest, EncodePartialOnlyWritesFramesDifferingFromBase) {
+  std::ostringstream base_bitstream;
+  ASSERT_TRUE(
+    BitStreamType::Encode(BaseFrames(), "test", "base", base_bitstream).ok());
+  const LoadedBitstream loaded = ReadConfiguration(base_bitstream.str());
+  ASSERT_TRUE(loaded.configuration.has_value());
+  const ConfigurationType &base = loaded.configuration.value();
+
+  // Identical to the base: nothing to write.
+  {
+    std::ostringstream out;
+    const absl::StatusOr<size_t> written =
+      BitStreamType::EncodePartial(BaseFrames(), base, "test", "same", out);
+    ASSERT_TRUE(written.ok()) << written.status();
+    EXPECT_EQ(*written, 0);
+    EXPECT_TRUE(FrameAddressWrites(out.str()).empty());
+  }
+
+  // One word changed and one word cleared, in frames that are not adjacent.
+  DenseFrames<kArch> frames = BaseFrames();
+  frames.Touch(TestAddresses()[0])[1] = 0x11;
+  frames.Touch(TestAddresses()[3])[50] = 0;
+  std::ostringstream out;
+  const absl::StatusOr<size_t> written =
+    BitStreamType::EncodePartial(frames, base, "test", "changed", out);
+  ASSERT_TRUE(written.ok()) << written.status();
+  EXPECT_EQ(*written, 2);
+  EXPECT_EQ(FrameAddressWrites(out.str()),
+            (std::vector<uint32_t>{static_cast<uint32_t>(TestAddresses()[0]),
+                                   static_cast<uint32_t>(TestAddresses()[3])}));
+}
+
+TEST(XC7BitStreamTest, FramesMissingFromBaseAreTakenAsZero) {
+  std::ostringstream base_bitstream;
+  ASSERT_TRUE(
+    BitStreamType::Encode(BaseFrames(), "test", "base", base_bitstream).ok());
+  const LoadedBitstream loaded = ReadConfiguration(base_bitstream.str());
+  ASSERT_TRUE(loaded.configuration.has_value());
+  const ConfigurationType &base = loaded.configuration.value();
+
+  // Column 0 only has minors 0..2, so the base has no such frame.
+  const FrameAddress missing(xc7::BlockType::kCLBIOCLK, false, 0, 0, 5);
+  ASSERT_FALSE(base.frames().contains(missing));
+  FrameWords words = {};
+  EXPECT_FALSE(BitStreamType::FrameDiffers(base, missing, words));
+  words[7] = 1;
+  EXPECT_TRUE(BitStreamType::FrameDiffers(base, missing, words));
+
+  DenseFrames<kArch> frames = BaseFrames();
+  frames.Touch(missing)[7] = 1;
+  std::ostringstream out;
+  const absl::StatusOr<size_t> written =
+    BitStreamType::EncodePartial(frames, base, "test", "missing", out);
+  ASSERT_TRUE(written.ok()) << written.status();
+  EXPECT_EQ(*written, 1);
+  EXPECT_EQ(FrameAddressWrites(out.str()),
+            std::vector<uint32_t>{static_cast<uint32_t>(missing)});
+}
+}  // namespace
+}  // namespace xilinx
+}  // namespace fpga
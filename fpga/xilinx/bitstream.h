@@ -1,9 +1,12 @@
 #ifndef FPGA_XILINX_BITSTREAM_H
 #define FPGA_XILINX_BITSTREAM_H
 
+#include <algorithm>
+#include <cstddef>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "absl/container/btree_map.h"
 #include "absl/status/status.h"
@@ -13,6 +16,7 @@
 #include "fpga/xilinx/arch-types.h"
 #include "fpga/xilinx/bitstream-writer.h"
 #include "fpga/xilinx/configuration.h"
+#include "fpga/xilinx/dense-frames.h"
 #include "fpga/xilinx/frames.h"
 
 namespace fpga {
@@ -40,7 +44,6 @@ class BitStream {
       converted_frames.emplace(address_words_pair.first,
                                address_words_pair.second);
     }
-    constexpr absl::string_view kGeneratorName = "fpga-assembler";
     FramesType frames(converted_frames);
     absl::StatusOr<Part> xilinx_part_status = Part::FromPart(part);
     if (!xilinx_part_status.ok()) {
@@ -54,12 +57,91 @@ class BitStream {
       ConfigurationType::CreateType2ConfigurationPacketData(frames.GetFrames(),
                                                             xilinx_part));
 
-    // Put together a configuration package
+    return Write(configuration_packet_data, xilinx_part, part_name,
+                 source_name, out);
+  }
+
+  // Same as above, with the frames already in a dense store covering all
+  // frames of the part, so there are no missing frames to add.
+  static absl::Status Encode(const DenseFrames<Arch> &frames,
+                             absl::string_view part_name,
+                             absl::string_view source_name, std::ostream &out) {
+    std::optional<Part> xilinx_part = frames.part();
+    typename ConfigurationType::PacketData configuration_packet_data(
+      ConfigurationType::CreateType2ConfigurationPacketData(
+        [&frames](auto &&fn) { frames.ForEachFrame(fn); },
+        frames.frame_count(), xilinx_part));
+    return Write(configuration_packet_data, xilinx_part, part_name,
+                 source_name, out);
+  }
+
+  // Encode a partial bitstream that only writes the frames for which
+  // "select(address, words)" returns true, as one FAR and FDRI write per
+  // run of consecutive frames. Returns the number of frames written.
+  template <typename Select>
+  static absl::StatusOr<size_t> EncodeSelected(const DenseFrames<Arch> &frames,
+                                               const Select &select,
+                                               absl::string_view part_name,
+                                               absl::string_view source_name,
+                                               std::ostream &out) {
+    size_t selected_frames = 0;
+    const auto for_each_selected_frame = [&](auto &&fn) {
+      frames.ForEachFrame([&](FrameAddress address, const FrameWords &words) {
+        if (select(address, words)) {
+          ++selected_frames;
+          fn(address, words);
+        }
+      });
+    };
+    const std::vector<typename ConfigurationType::FrameRun> runs =
+      ConfigurationType::CreateFrameRuns(for_each_selected_frame,
+                                         frames.part());
+    std::optional<Part> xilinx_part = frames.part();
     ConfigurationPackage configuration_package;
-    ConfigurationType::CreateConfigurationPackage(
-      configuration_package, configuration_packet_data, xilinx_part);
+    ConfigurationType::CreatePartialConfigurationPackage(configuration_package,
+                                                         runs, xilinx_part);
+    const absl::Status status = WritePackage(configuration_package, part_name,
+                                             source_name, out);
+    if (!status.ok()) {
+      return status;
+    }
+    return selected_frames;
+  }
 
-    // Write bitstream
+  // Returns true if "words" of the frame at "address" differ from the frame
+  // in "base"; frames missing in "base" are taken as all zero.
+  static bool FrameDiffers(const ConfigurationType &base, FrameAddress address,
+                           const FrameWords &words) {
+    static constexpr FrameWords kZeroFrame = {};
+    const auto found = base.frames().find(address);
+    if (found == base.frames().end()) {
+      return words != kZeroFrame;
+    }
+    return !std::equal(words.begin(), words.end(), found->second.begin(),
+                       found->second.end());
+  }
+
+  // Encode a partial bitstream to be loaded on a device configured with
+  // "base", writing only the frames that differ from it.
+  static absl::StatusOr<size_t> EncodePartial(const DenseFrames<Arch> &frames,
+                                              const ConfigurationType &base,
+                                              absl::string_view part_name,
+                                              absl::string_view source_name,
+                                              std::ostream &out) {
+    return EncodeSelected(
+      frames,
+      [&base](FrameAddress address, const FrameWords &words) {
+        return FrameDiffers(base, address, words);
+      },
+      part_name, source_name, out);
+  }
+
+ private:
+  static absl::Status WritePackage(
+    const ConfigurationPackage &configuration_package,
+    absl::string_view part_name, absl::string_view source_name,
+    std::ostream &out) {
+    constexpr absl::string_view kGeneratorName = "fpga-assembler";
     auto bitstream_writer = BitstreamWriterType(configuration_package);
     if (bitstream_writer.writeBitstream(
           configuration_package, std::string(part_name),
@@ -68,6 +150,19 @@ class BitStream {
     }
     return absl::OkStatus();
   }
+
+  static absl::Status Write(
+    const typename ConfigurationType::PacketData &configuration_packet_data,
+    std::optional<Part> &xilinx_part, absl::string_view part_name,
+    absl::string_view source_name, std::ostream &out) {
+    // Put together a configuration package
+    ConfigurationPackage configuration_package;
+    ConfigurationType::CreateConfigurationPackage(
+      configuration_package, configuration_packet_data, xilinx_part);
+
+    // Write bitstream
+    return WritePackage(configuration_package, part_name, source_name, out);
+  }
 };
 }  // namespace xilinx
 }  // namespace fpga
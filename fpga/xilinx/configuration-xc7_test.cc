@@ -14,6 +14,7 @@
 #include <memory>
 #include <vector>
 
+#include "absl/container/btree_map.h"
 #include "absl/log/check.h"
 #include "absl/status/statusor.h"
 #include "absl/types/optional.h"
@@ -348,6 +349,70 @@ TEST(XC7ConfigurationTest, CheckForPaddingFrames) {
     EXPECT_EQ(frame.second, frames.GetFrames().at(frame.first));
   }
 }
+
+TEST(XC7ConfigurationTest, CreateFrameRunsSplitsAtGapsAndRows) {
+  const std::vector<FrameAddress> test_part_addresses = {
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 1),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 2),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 3),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 1, 0, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 1, 0, 1)};
+  const Part test_part(0x1234, test_part_addresses);
+
+  // Minor 2 is unchanged; rows 0 and 1 follow each other but need to be
+  // written separately.
+  absl::btree_map<FrameAddress, FrameWords> frames;
+  frames.emplace(test_part_addresses[0], Fill<FrameWords>(0xAA));
+  frames.emplace(test_part_addresses[1], Fill<FrameWords>(0xBB));
+  frames.emplace(test_part_addresses[3], Fill<FrameWords>(0xCC));
+  frames.emplace(test_part_addresses[4], Fill<FrameWords>(0xDD));
+  frames.emplace(test_part_addresses[5], Fill<FrameWords>(0xEE));
+
+  using ConfigurationType = Configuration<Architecture::kXC7>;
+  const std::vector<ConfigurationType::FrameRun> runs =
+    ConfigurationType::CreateFrameRuns(
+      [&frames](auto &&fn) {
+        for (const auto &[address, words] : frames) {
+          fn(address, words);
+        }
+      },
+      test_part);
+  ASSERT_EQ(runs.size(), 3);
+  EXPECT_EQ(runs[0].address, test_part_addresses[0]);
+  EXPECT_EQ(runs[1].address, test_part_addresses[3]);
+  EXPECT_EQ(runs[2].address, test_part_addresses[4]);
+  // Frames of the run plus one pad frame.
+  EXPECT_EQ(runs[0].data.size(), 3 * 101);
+  EXPECT_EQ(runs[1].data.size(), 2 * 101);
+  EXPECT_EQ(runs[2].data.size(), 3 * 101);
+  EXPECT_EQ(runs[0].data[0], 0xAA);
+  EXPECT_EQ(runs[0].data[101], 0xBB);
+  EXPECT_EQ(runs[0].data[2 * 101], 0);
+  EXPECT_EQ(runs[2].data[101], 0xEE);
+
+  // Each run is written to the configuration with its own FAR write.
+  absl::optional<Part> part = test_part;
+  ArchType::ConfigurationPackage package;
+  ConfigurationType::CreatePartialConfigurationPackage(package, runs, part);
+  std::vector<uint32_t> far_writes;
+  size_t fdri_words = 0;
+  for (const auto &packet : package) {
+    if (packet->opcode() != ConfigurationPacket::Opcode::kWrite) {
+      continue;
+    }
+    if (packet->address() == ConfigurationRegister::kFAR) {
+      far_writes.push_back(packet->data()[0]);
+    } else if (packet->address() == ConfigurationRegister::kFDRI) {
+      fdri_words += packet->data().size();
+    }
+  }
+  EXPECT_EQ(far_writes,
+            (std::vector<uint32_t>{static_cast<uint32_t>(runs[0].address),
+                                   static_cast<uint32_t>(runs[1].address),
+                                   static_cast<uint32_t>(runs[2].address)}));
+  EXPECT_EQ(fdri_words, 8 * 101);
+}
 }  // namespace
 }  // namespace xilinx
 }  // namespace fpga
@@ -11,6 +11,7 @@
 #include "fpga/xilinx/configuration.h"
 
 #include <cstdint>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/types/optional.h"
@@ -174,5 +175,66 @@ void Configuration<Architecture::kXC7>::CreateConfigurationPackage(
     out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
   }
 }
+
+template <>
+void Configuration<Architecture::kXC7>::CreatePartialConfigurationPackage(
+  ConfigurationPackage &out_packets, const std::vector<FrameRun> &runs,
+  absl::optional<Part> &part) {
+  // Initialization sequence
+  out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  out_packets.emplace_back(
+    new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kCMD,
+      {static_cast<uint32_t>(xc7::Command::kRCRC)}));
+  out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  CHECK(part.has_value());
+  out_packets.emplace_back(
+    new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kIDCODE,
+      {part->idcode()}));
+
+  // Frame data writes, one per run.
+  for (const FrameRun &run : runs) {
+    out_packets.emplace_back(
+      new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+        ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kFAR,
+        {static_cast<uint32_t>(run.address)}));
+    out_packets.emplace_back(
+      new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+        ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kCMD,
+        {static_cast<uint32_t>(xc7::Command::kWCFG)}));
+    out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+    out_packets.emplace_back(new ConfigurationPacket(
+      static_cast<uint32_t>(ConfigurationPacketType::kTYPE1),
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kFDRI, {}));
+    out_packets.emplace_back(new ConfigurationPacket(
+      static_cast<uint32_t>(ConfigurationPacketType::kTYPE2),
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kFDRI,
+      run.data));
+  }
+
+  // Finalization sequence
+  out_packets.emplace_back(
+    new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kCMD,
+      {static_cast<uint32_t>(xc7::Command::kLFRM)}));
+  for (int ii = 0; ii < 100; ++ii) {
+    out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  }
+  out_packets.emplace_back(
+    new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kCMD,
+      {static_cast<uint32_t>(xc7::Command::kRCRC)}));
+  out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  out_packets.emplace_back(
+    new ConfigurationPacketWithPayload<1, ConfigurationPacket>(
+      ConfigurationPacket::Opcode::kWrite, ConfigurationRegister::kCMD,
+      {static_cast<uint32_t>(xc7::Command::kDESYNC)}));
+  for (int ii = 0; ii < 16; ++ii) {
+    out_packets.emplace_back(new NopPacket<ConfigurationPacket>());
+  }
+}
 }  // namespace xilinx
 }  // namespace fpga
@@ -10,6 +10,7 @@
 #ifndef FPGA_XILINX_CONFIGURATION_H
 #define FPGA_XILINX_CONFIGURATION_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -61,28 +62,91 @@ class Configuration {
   static PacketData CreateType2ConfigurationPacketData(
     const absl::btree_map<FrameAddress, FrameWords> &frames,
     std::optional<Part> &part) {
+    return CreateType2ConfigurationPacketData(
+      [&frames](auto &&fn) {
+        for (auto &frame : frames) {
+          fn(frame.first, frame.second);
+        }
+      },
+      frames.size(), part);
+  }
+
+  // Same as above, but the frames are provided by "for_each_frame" that
+  // calls its argument with the address and words of each of the
+  // "frame_count" frames in increasing address order.
+  template <typename ForEachFrame>
+  static PacketData CreateType2ConfigurationPacketData(
+    const ForEachFrame &for_each_frame, size_t frame_count,
+    std::optional<Part> &part) {
     PacketData packet_data;
     // Certain configuration frames blocks are separated by Zero Frames,
     // i.e. frames with words with all zeroes. For Series-7, US and US+
     // there zero frames separator consists of two frames.
     static const int kZeroFramesSeparatorWords = kWordsPerFrame * 2;
-    for (auto &frame : frames) {
-      std::copy(frame.second.begin(), frame.second.end(),
-                std::back_inserter(packet_data));
+    packet_data.reserve((frame_count + 2) * kWordsPerFrame);
+    for_each_frame([&](const FrameAddress &address, const FrameWords &words) {
+      std::copy(words.begin(), words.end(), std::back_inserter(packet_data));
 
-      auto next_address = part->GetNextFrameAddress(frame.first);
+      auto next_address = part->GetNextFrameAddress(address);
       if (next_address &&
-          (next_address->block_type() != frame.first.block_type() ||
+          (next_address->block_type() != address.block_type() ||
            next_address->is_bottom_half_rows() !=
-             frame.first.is_bottom_half_rows() ||
-           next_address->row() != frame.first.row())) {
+             address.is_bottom_half_rows() ||
+           next_address->row() != address.row())) {
         packet_data.insert(packet_data.end(), kZeroFramesSeparatorWords, 0);
       }
-    }
+    });
     packet_data.insert(packet_data.end(), kZeroFramesSeparatorWords, 0);
     return packet_data;
   }
 
+  // Frames written with a single FAR write followed by an FDRI write.
+  struct FrameRun {
+    FrameAddress address;
+    // Words of the consecutive frames starting at "address", followed by a
+    // pad frame that pushes the last one out of the FDRI pipeline.
+    PacketData data;
+  };
+
+  // Group the frames provided by "for_each_frame" in increasing address
+  // order into runs of frames following each other within a row of "part".
+  // A run never crosses a row, so no separator frames are needed within.
+  template <typename ForEachFrame>
+  static std::vector<FrameRun> CreateFrameRuns(
+    const ForEachFrame &for_each_frame, const Part &part) {
+    std::vector<FrameRun> runs;
+    std::optional<FrameAddress> expected_address;
+    for_each_frame([&](const FrameAddress &address, const FrameWords &words) {
+      if (!expected_address || *expected_address != address) {
+        if (!runs.empty()) {
+          runs.back().data.insert(runs.back().data.end(), kWordsPerFrame, 0);
+        }
+        runs.push_back({address, {}});
+      }
+      std::copy(words.begin(), words.end(),
+                std::back_inserter(runs.back().data));
+      expected_address = part.GetNextFrameAddress(address);
+      if (expected_address &&
+          (expected_address->block_type() != address.block_type() ||
+           expected_address->is_bottom_half_rows() !=
+             address.is_bottom_half_rows() ||
+           expected_address->row() != address.row())) {
+        expected_address.reset();
+      }
+    });
+    if (!runs.empty()) {
+      runs.back().data.insert(runs.back().data.end(), kWordsPerFrame, 0);
+    }
+    return runs;
+  }
+
+  // Creates a package that only writes the frames of "runs" to a configured
+  // device, without the shutdown and startup sequence of a full
+  // configuration, so the device keeps running.
+  static void CreatePartialConfigurationPackage(
+    ConfigurationPackage &out_packets, const std::vector<FrameRun> &runs,
+    std::optional<Part> &part);
+
   Configuration(const Part &part,
                 absl::btree_map<FrameAddress, FrameWords> &frames)
       : part_(part) {
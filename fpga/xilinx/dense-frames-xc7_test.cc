@@ -0,0 +1,119 @@
+#include "fpga/xilinx/dense-frames.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "fpga/xilinx/arch-types.h"
+#include "fpga/xilinx/arch-xc7-frame.h"
+#include "gtest/gtest.h"
+
+namespace fpga {
+namespace xilinx {
+namespace xc7 {
+namespace {
+constexpr fpga::xilinx::Architecture kArch = fpga::xilinx::Architecture::kXC7;
+using ArchType = ArchitectureType<kArch>;
+using FrameAddress = ArchType::FrameAddress;
+using Part = ArchType::Part;
+using FrameWords = ArchType::FrameWords;
+
+Part TestPart() {
+  const std::vector<FrameAddress> addresses = {
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 1),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 2),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 1)};
+  return Part(0x1234, addresses);
+}
+
+TEST(XC7DenseFramesTest, CoversAllFramesOfPart) {
+  const DenseFrames<kArch> frames(TestPart());
+  EXPECT_EQ(frames.size(), 5);
+  EXPECT_EQ(frames.frame_count(), 5);
+
+  std::vector<FrameAddress> visited;
+  frames.ForEachFrame([&](FrameAddress address, const FrameWords &words) {
+    visited.push_back(address);
+    EXPECT_EQ(words, FrameWords{});
+  });
+  const std::vector<FrameAddress> expected = {
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 1),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 2),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 0),
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 1, 1)};
+  EXPECT_EQ(visited, expected);
+}
+
+TEST(XC7DenseFramesTest, TouchMarksAndKeepsWords) {
+  DenseFrames<kArch> frames(TestPart());
+  const FrameAddress address(xc7::BlockType::kCLBIOCLK, false, 0, 1, 0);
+  EXPECT_FALSE(frames.IsTouched(address));
+  frames.Touch(address)[3] |= 0x10;
+  frames.Touch(address)[3] |= 0x01;
+  EXPECT_TRUE(frames.IsTouched(address));
+  EXPECT_FALSE(frames.IsTouched(
+    FrameAddress(xc7::BlockType::kCLBIOCLK, false, 0, 0, 2)));
+
+  frames.ForEachFrame([&](FrameAddress a, const FrameWords &words) {
+    EXPECT_EQ(words[3], a == address ? 0x11 : 0) << a;
+  });
+}
+
+TEST(XC7DenseFramesTest, AddressesOutsidePartAreKeptInOrder) {
+  DenseFrames<kArch> frames(TestPart());
+  // Column 0 only has minors 0..2.
+  const FrameAddress outside(xc7::BlockType::kCLBIOCLK, false, 0, 0, 5);
+  EXPECT_FALSE(frames.IsTouched(outside));
+  frames.Touch(outside)[0] = 42;
+  EXPECT_TRUE(frames.IsTouched(outside));
+  EXPECT_EQ(frames.size(), 5);
+  EXPECT_EQ(frames.frame_count(), 6);
+  ASSERT_EQ(frames.overflow().size(), 1);
+
+  std::vector<uint32_t> visited;
+  frames.ForEachFrame([&](FrameAddress address, const FrameWords &words) {
+    visited.push_back(static_cast<uint32_t>(address));
+    if (address == outside) {
+      EXPECT_EQ(words[0], 42);
+    }
+  });
+  ASSERT_EQ(visited.size(), 6);
+  EXPECT_EQ(visited[3], static_cast<uint32_t>(outside));
+  for (size_t i = 1; i < visited.size(); ++i) {
+    EXPECT_LT(visited[i - 1], visited[i]);
+  }
+}
+
+TEST(XC7DenseFramesTest, MergeShardsOrsWords) {
+  DenseFrames<kArch> frames(TestPart());
+  DenseFrames<kArch> shard = frames.EmptyCopy();
+  const FrameAddress both(xc7::BlockType::kCLBIOCLK, false, 0, 0, 1);
+  const FrameAddress shard_only(xc7::BlockType::kCLBIOCLK, false, 0, 1, 1);
+  const FrameAddress outside(xc7::BlockType::kCLBIOCLK, false, 0, 0, 5);
+  frames.Touch(both)[0] = 0x0F;
+  shard.Touch(both)[0] = 0xF0;
+  shard.Touch(shard_only)[100] = 1;
+  shard.Touch(outside)[1] = 2;
+  EXPECT_FALSE(frames.IsTouched(shard_only));
+
+  frames.MergeFrom(shard);
+  EXPECT_TRUE(frames.IsTouched(shard_only));
+  EXPECT_TRUE(frames.IsTouched(outside));
+  frames.ForEachFrame([&](FrameAddress a, const FrameWords &words) {
+    if (a == both) {
+      EXPECT_EQ(words[0], 0xFF);
+    } else if (a == shard_only) {
+      EXPECT_EQ(words[100], 1);
+    } else if (a == outside) {
+      EXPECT_EQ(words[1], 2);
+    } else {
+      EXPECT_EQ(words, FrameWords{}) << a;
+    }
+  });
+}
+}  // namespace
+}  // namespace xc7
+}  // namespace xilinx
+}  // namespace fpga
@@ -0,0 +1,175 @@
+#ifndef FPGA_XILINX_DENSE_FRAMES_H
+#define FPGA_XILINX_DENSE_FRAMES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "fpga/xilinx/arch-types.h"
+
+namespace fpga {
+namespace xilinx {
+// Frame data of a whole part stored in one contiguous array with a slot for
+// every valid frame address of the part. Addresses are mapped to slots with
+// a table computed once from the part.
+//
+// Frames that are written to are marked as "touched". Addresses that are not
+// part of the device are still accepted and kept on the side, so nothing
+// written gets lost.
+template <Architecture Arch>
+class DenseFrames {
+ public:
+  using ArchType = ArchitectureType<Arch>;
+  using FrameWords = ArchType::FrameWords;
+  using FrameAddress = ArchType::FrameAddress;
+  using Part = ArchType::Part;
+
+  explicit DenseFrames(Part part);
+
+  // Returns a store for the same part with no frames touched. The address
+  // table is shared, so this is cheap apart from the frame words.
+  DenseFrames EmptyCopy() const { return DenseFrames(layout_); }
+
+  // Combine the frames of "other", a store of the same part, into this one
+  // by OR-ing their words. Touched frames stay touched.
+  void MergeFrom(const DenseFrames &other);
+
+  const Part &part() const { return layout_->part; }
+
+  // Number of valid frame addresses of the part.
+  size_t size() const { return layout_->addresses.size(); }
+
+  // Returns the words of the frame at "address" for modification and marks
+  // the frame as touched.
+  FrameWords &Touch(FrameAddress address) {
+    const auto &index = layout_->index;
+    const auto found = index.find(static_cast<uint32_t>(address));
+    if (found == index.end()) {
+      return overflow_[address];
+    }
+    touched_[found->second / 64] |= uint64_t(1) << (found->second % 64);
+    return words_[found->second];
+  }
+
+  // Returns true if the frame at "address" was touched.
+  bool IsTouched(FrameAddress address) const {
+    const auto &index = layout_->index;
+    const auto found = index.find(static_cast<uint32_t>(address));
+    if (found == index.end()) {
+      return overflow_.contains(address);
+    }
+    const uint32_t i = found->second;
+    return touched_[i / 64] & (uint64_t(1) << (i % 64));
+  }
+
+  // Frames with addresses not known to the part, i.e. not in the dense array.
+  const absl::btree_map<FrameAddress, FrameWords> &overflow() const {
+    return overflow_;
+  }
+
+  // Calls fn(FrameAddress, const FrameWords &) for every frame of the part as
+  // well as the touched ones outside of it, in increasing address order.
+  template <typename Fn>
+  void ForEachFrame(Fn &&fn) const;
+
+  // Number of frames visited by ForEachFrame().
+  size_t frame_count() const { return size() + overflow_.size(); }
+
+ private:
+  // Everything derived from the part; immutable once created.
+  struct Layout {
+    Part part;
+    // Valid addresses of the part in increasing order; the index into this
+    // array is the index into "words_".
+    std::vector<FrameAddress> addresses;
+    absl::flat_hash_map<uint32_t, uint32_t> index;
+  };
+
+  explicit DenseFrames(std::shared_ptr<const Layout> layout)
+      : layout_(std::move(layout)),
+        words_(layout_->addresses.size()),
+        touched_((layout_->addresses.size() + 63) / 64) {}
+
+  static std::shared_ptr<const Layout> CreateLayout(Part part);
+
+  std::shared_ptr<const Layout> layout_;
+  std::vector<FrameWords> words_;
+  std::vector<uint64_t> touched_;
+  absl::btree_map<FrameAddress, FrameWords> overflow_;
+};
+
+template <Architecture Arch>
+DenseFrames<Arch>::DenseFrames(Part part)
+    : DenseFrames(CreateLayout(std::move(part))) {}
+
+template <Architecture Arch>
+std::shared_ptr<const typename DenseFrames<Arch>::Layout>
+DenseFrames<Arch>::CreateLayout(Part part) {
+  auto layout = std::make_shared<Layout>();
+  layout->part = std::move(part);
+  std::vector<FrameAddress> &addresses = layout->addresses;
+  std::optional<FrameAddress> address = FrameAddress(0);
+  // Same walk as Frames::AddMissingFrames().
+  do {
+    addresses.push_back(*address);
+    address = layout->part.GetNextFrameAddress(*address);
+  } while (address);
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()),
+                  addresses.end());
+  layout->index.reserve(addresses.size());
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    layout->index.emplace(static_cast<uint32_t>(addresses[i]), i);
+  }
+  return layout;
+}
+
+template <Architecture Arch>
+void DenseFrames<Arch>::MergeFrom(const DenseFrames &other) {
+  CHECK(layout_ == other.layout_) << "merging frames of different layouts";
+  for (size_t block = 0; block < touched_.size(); ++block) {
+    // Only frames that were touched can have bits set.
+    uint64_t touched = other.touched_[block];
+    touched_[block] |= touched;
+    while (touched) {
+      const size_t i = block * 64 + __builtin_ctzll(touched);
+      touched &= touched - 1;
+      for (size_t w = 0; w < words_[i].size(); ++w) {
+        words_[i][w] |= other.words_[i][w];
+      }
+    }
+  }
+  for (const auto &[address, other_words] : other.overflow_) {
+    FrameWords &words = overflow_[address];
+    for (size_t w = 0; w < words.size(); ++w) {
+      words[w] |= other_words[w];
+    }
+  }
+}
+
+template <Architecture Arch>
+template <typename Fn>
+void DenseFrames<Arch>::ForEachFrame(Fn &&fn) const {
+  const std::vector<FrameAddress> &addresses = layout_->addresses;
+  auto overflow_it = overflow_.begin();
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    for (; overflow_it != overflow_.end() && overflow_it->first < addresses[i];
+         ++overflow_it) {
+      fn(overflow_it->first, overflow_it->second);
+    }
+    fn(addresses[i], words_[i]);
+  }
+  for (; overflow_it != overflow_.end(); ++overflow_it) {
+    fn(overflow_it->first, overflow_it->second);
+  }
+}
+}  // namespace xilinx
+}  // namespace fpga
+#endif  // FPGA_XILINX_DENSE_FRAMES_H